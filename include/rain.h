@@ -0,0 +1,114 @@
+#ifndef RAIN_H
+#define RAIN_H
+
+/**
+ * Digital rain engine as a library (librain.a). A handle owns the simulation and
+ * the renderer of one rain screen; frames come out as terminal escape sequences
+ * in a buffer or a callback, the library never writes anywhere on its own.
+ *
+ * Handles share the random generator and the glyph tables, use them from one thread.
+ *
+ * Nothing is printed and nothing exits: a call that runs out of memory returns an error
+ * (-1, RAIN_ERROR or NULL) and the handle is broken after that, it can only be destroyed.
+ */
+
+#include <stddef.h>
+
+typedef struct Rain Rain;
+
+// rain_render ran out of memory
+#define RAIN_ERROR ((size_t)-1)
+
+typedef struct {
+    int columns;
+    int rows;
+    int drops;             // number of drops
+    int column_drops;      // most drops in one column (row for left/right rain), 0 = no limit
+    int millis;            // length of one cycle of the simulation
+    int layers;            // depth layers 1-4, far ones dimmer and slower
+    const char *glyphs;    // "latin", "alpha" or "katakana"
+    const char *colors;    // "16", "256" or "truecolor"
+    const char *renderer;  // "scan", "full" or "diff"
+    const char *direction; // "down", "up", "left" or "right"
+    const char *subcells;  // "off", "half" (1x2 per cell) or "braille" (2x4), drops move on the finer grid
+    int repeat;            // runs of the same glyph as REP, turn off for terminals without it
+    unsigned int seed;     // same seed, same rain
+    long long skip;        // cycles simulated before the first frame, -1 = as many as rows
+} RainConfig;
+
+// What a cell shows, same values the renderer picks colors from
+enum {
+    RAIN_STYLE_EMPTY = 0,
+    RAIN_STYLE_TAIL,
+    RAIN_STYLE_DROP,
+    RAIN_STYLE_TAIL_MID,
+    RAIN_STYLE_DROP_MID,
+    RAIN_STYLE_TAIL_FAR,
+    RAIN_STYLE_DROP_FAR,
+    RAIN_STYLE_REVEAL,   // uncovered by the rain, see rain_reveal_text
+    RAIN_STYLE_OVERLAY   // text over the rain, see rain_overlay_add
+};
+
+typedef struct {
+    int c;               // unicode code point, 0 or space when empty
+    unsigned char style; // RAIN_STYLE_*
+    unsigned char bg;    // RAIN_STYLE_* of the background (lower half block), EMPTY if none
+} RainCell;
+
+// Receives the encoded frame, data points into the handle and is valid only during the call
+typedef void (*RainWriter)(void *user, const char *data, size_t len);
+
+// Defaults of the matrix binary for an 80x24 screen (diff renderer, REP on)
+void rain_config_defaults(RainConfig *config);
+
+// NULL if the config has an unknown name or a size below 1x1, or there is no memory
+Rain* rain_create(const RainConfig *config);
+
+void rain_destroy(Rain *rain);
+
+// Advance the simulation by millis, every pane and layer steps as often as it is due
+int rain_step(Rain *rain, int millis);
+
+// New screen size, the next frame is a full repaint. -1 for a size below 1x1 too, the handle keeps the old one
+int rain_resize(Rain *rain, int columns, int rows);
+
+// Forget what the screen shows (it was cleared or overwritten), the next frame is a full repaint
+void rain_invalidate(Rain *rain);
+
+/**
+ * Encode the current rain as an update of the screen drawn by the previous frames,
+ * starting with a cursor move to the top left corner. Returns the length of the frame;
+ * if that is more than size nothing is written and the same frame is returned by the
+ * next call (with a bigger buffer), like snprintf but without the terminating zero.
+ * RAIN_ERROR (more than any buffer) if there was no memory to encode it.
+ */
+size_t rain_render(Rain *rain, char *buf, size_t size);
+
+// Same as rain_render, but the frame is handed over without copying
+int rain_render_to(Rain *rain, RainWriter write, void *user);
+
+/**
+ * Hide text (5x7 font, lines split at '\n') in the rain: it is scaled to the screen, and
+ * every cell of it a drop head passes over keeps that glyph, highlighted. NULL turns it off.
+ */
+int rain_reveal_text(Rain *rain, const char *text);
+
+// Same with a PBM image (P1 or P4, black is hidden), -1 if data isn't one (the old reveal stays)
+int rain_reveal_pbm(Rain *rain, const void *data, size_t len);
+
+/**
+ * Text box over the rain at column x, row y (negative from the right or bottom edge),
+ * boxes with higher z cover lower ones. Returns its id, -1 if there are too many (16).
+ */
+int rain_overlay_add(Rain *rain, int x, int y, int z, const char *text);
+
+// New text for a box, NULL hides it. Text that didn't change costs nothing in the next frame
+void rain_overlay_set(Rain *rain, int id, const char *text);
+
+/**
+ * Composed cells of the current rain, row after row, for frontends that draw on their own.
+ * Valid until the next call on the handle, NULL if there was no memory for them.
+ */
+const RainCell* rain_cells(Rain *rain, int *columns, int *rows);
+
+#endif
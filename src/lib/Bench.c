@@ -0,0 +1,631 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <stdbool.h>
+
+#include "Bench.h"
+#include "Viewport.h"
+#include "Frame.h"
+#include "Sink.h"
+#include "Renderer.h"
+#include "Memory.h"
+#include "Parallax.h"
+#include "Graphics.h"
+#include "Reveal.h"
+#include "DropIndex.h"
+#include "Overlay.h"
+
+#define BENCH_WARMUP 20
+#define BENCH_FRAMES 200
+#define BENCH_SCAN_FRAMES 10
+#define BENCH_MILLIS 20 // virtual time between frames, used by the throttled link
+#define BENCH_FFWD_DROPS 1000000
+#define BENCH_FFWD_CYCLES 1000
+#define BENCH_REPEATS 5 // timed batches of frames (whole runs of one-shot scenarios), the fastest counts
+#define BENCH_OUTPUT_HEADROOM 2 // output buffers get this many times the biggest warmup frame
+
+typedef struct {
+    int columns;
+    int rows;
+    int numDrops;
+    int colors;
+    int renderer;
+    int frames;
+    int baud; // 0 = unlimited output, otherwise emulated serial/ssh link speed
+    long long fastForward; // > 0 = time one fast-forward of that many cycles instead of frames
+    bool firstFrame; // time from no rain to the first frame encoded, the rain's share of startup
+    int direction; // 'D' for the usual rain
+    int layers; // depth layers, 1 = flat rain
+    int graphics; // GRAPHICS_* pixel output instead of the renderer's text
+    bool reveal; // rain uncovers BENCH_REVEAL_TEXT
+    int subcells; // SUBCELLS_*, simulation on the finer grid
+    bool pointer; // drops kept indexed by lane, one pointer query per frame
+    bool overlay; // header line and a clock over the rain
+} BenchScenario;
+
+typedef struct {
+    char name[64];
+    double nsPerFrame;
+    double bytesPerFrame;
+    double allocsPerFrame;
+    double droppedFrames; // share of frames skipped because the link was busy (not in baseline)
+} BenchResult;
+
+// Allowed relative increase against the baseline before it counts as regression
+typedef struct {
+    double ns;
+    double bytes;
+    double allocs;
+} BenchTolerance;
+
+static const int benchSizes[][2] = { { 80, 24 }, { 200, 60 }, { 400, 120 } };
+static const int benchDrops[] = { 220, 2000 };
+static const int benchColors[] = { COLORS_16, COLORS_256, COLORS_TRUE };
+static const int benchBauds[] = { 9600, 115200 };
+static const int benchDirections[] = { 'U', 'L', 'R' };
+static const int benchLayers[][2] = { { 200, 60 }, { 400, 120 } };
+static const int benchGraphics[] = { GRAPHICS_SIXEL, GRAPHICS_KITTY };
+static const int benchReveal[][2] = { { 200, 60 }, { 400, 120 } };
+static const int benchSubcells[] = { SUBCELLS_HALF, SUBCELLS_BRAILLE };
+static const int benchPointer[][2] = { { 200, 60 }, { 400, 120 } };
+
+#define BENCH_REVEAL_TEXT "Wake up, Neo..."
+#define BENCH_POINTER_RADIUS 8 // columns, half as many rows
+#define BENCH_CLOCK_FRAMES 50   // a clock ticking once a second at 50 fps
+
+#define BENCH_CELL_WIDTH 10 // pixels of a terminal cell for the graphics output
+#define BENCH_CELL_HEIGHT 20
+
+#define COUNT(a) (int)(sizeof(a) / sizeof(a[0]))
+
+// With scenarios NULL it only counts, the arrays are sized from that
+static void addScenario(BenchScenario *scenarios, int *n, BenchScenario sc)
+{
+    if (scenarios != NULL)
+        scenarios[*n] = sc;
+    (*n)++;
+}
+
+static int buildScenarios(BenchScenario *scenarios)
+{
+    int n = 0;
+
+    for (int renderer = 0; renderer < NUM_RENDERERS; renderer++)
+    {
+        for (int s = 0; s < COUNT(benchSizes); s++)
+        {
+            for (int d = 0; d < COUNT(benchDrops); d++)
+            {
+                for (int c = 0; c < COUNT(benchColors); c++)
+                {
+                    BenchScenario sc = { benchSizes[s][0], benchSizes[s][1], benchDrops[d], benchColors[c], renderer, BENCH_FRAMES, 0, 0, false, 'D', 1, GRAPHICS_NONE, false, SUBCELLS_OFF, false, false };
+
+                    // Scanning renderer is far too slow for anything but the smallest screen
+                    if (renderer == RENDERER_SCAN)
+                    {
+                        if (s > 0 || d > 0)
+                            continue;
+                        sc.frames = BENCH_SCAN_FRAMES;
+                    }
+                    addScenario(scenarios, &n, sc);
+                }
+            }
+        }
+    }
+
+    // Slow links, default screen
+    for (int renderer = RENDERER_FULL; renderer < NUM_RENDERERS; renderer++)
+    {
+        for (int b = 0; b < COUNT(benchBauds); b++)
+        {
+            BenchScenario sc = { 80, 24, 220, COLORS_16, renderer, BENCH_FRAMES, benchBauds[b], 0, false, 'D', 1, GRAPHICS_NONE, false, SUBCELLS_OFF, false, false };
+            addScenario(scenarios, &n, sc);
+        }
+    }
+
+    // Other directions have their own kernels
+    for (int d = 0; d < COUNT(benchDirections); d++)
+    {
+        BenchScenario sc = { 200, 60, 2000, COLORS_16, RENDERER_DIFF, BENCH_FRAMES, 0, 0, false, benchDirections[d], 1, GRAPHICS_NONE, false, SUBCELLS_OFF, false, false };
+        addScenario(scenarios, &n, sc);
+    }
+
+    // Depth layers, compositor only touches tiles where some layer changed
+    for (int s = 0; s < COUNT(benchLayers); s++)
+    {
+        BenchScenario sc = { benchLayers[s][0], benchLayers[s][1], 2000, COLORS_256, RENDERER_DIFF, BENCH_FRAMES, 0, 0, false, 'D', 3, GRAPHICS_NONE, false, SUBCELLS_OFF, false, false };
+        addScenario(scenarios, &n, sc);
+    }
+
+    // Pixel output, one thread so the timing doesn't depend on the machine
+    for (int i = 0; i < COUNT(benchGraphics); i++)
+    {
+        BenchScenario sc = { 80, 24, 220, COLORS_16, RENDERER_DIFF, BENCH_FRAMES, 0, 0, false, 'D', 1, benchGraphics[i], false, SUBCELLS_OFF, false, false };
+        addScenario(scenarios, &n, sc);
+    }
+
+    // Reveal mask on top of the rain has to cost about nothing next to the plain scenario
+    for (int s = 0; s < COUNT(benchReveal); s++)
+    {
+        BenchScenario sc = { benchReveal[s][0], benchReveal[s][1], 2000, COLORS_16, RENDERER_DIFF, BENCH_FRAMES, 0, 0, false, 'D', 1, GRAPHICS_NONE, true, SUBCELLS_OFF, false, false };
+        addScenario(scenarios, &n, sc);
+    }
+
+    // Finer rain, same number of terminal cells to diff and send
+    for (int i = 0; i < COUNT(benchSubcells); i++)
+    {
+        BenchScenario sc = { 200, 60, 2000, COLORS_256, RENDERER_DIFF, BENCH_FRAMES, 0, 0, false, 'D', 1, GRAPHICS_NONE, false, benchSubcells[i], false, false };
+        addScenario(scenarios, &n, sc);
+    }
+
+    // Index upkeep in the kernels plus a pointer query every frame, next to the plain scenario
+    for (int s = 0; s < COUNT(benchPointer); s++)
+    {
+        BenchScenario sc = { benchPointer[s][0], benchPointer[s][1], 2000, COLORS_16, RENDERER_DIFF, BENCH_FRAMES, 0, 0, false, 'D', 1, GRAPHICS_NONE, false, SUBCELLS_OFF, true, false };
+        addScenario(scenarios, &n, sc);
+    }
+
+    // Static header and a ticking clock over the rain, bytes have to stay those of the plain scenario
+    BenchScenario overlay = { 200, 60, 2000, COLORS_16, RENDERER_DIFF, BENCH_FRAMES, 0, 0, false, 'D', 1, GRAPHICS_NONE, false, SUBCELLS_OFF, false, true };
+    addScenario(scenarios, &n, overlay);
+
+    // Rain's share of the time to first frame
+    for (int s = 0; s < COUNT(benchSizes); s++)
+    {
+        BenchScenario sc = { benchSizes[s][0], benchSizes[s][1], benchDrops[0], COLORS_16, RENDERER_FULL, 1, 0, 0, true, 'D', 1, GRAPHICS_NONE, false, SUBCELLS_OFF, false, false };
+        addScenario(scenarios, &n, sc);
+    }
+
+    // Warm start has to stay imperceptible even with a huge number of drops
+    BenchScenario ffwd = { 80, 24, BENCH_FFWD_DROPS, COLORS_16, RENDERER_FULL, 1, 0, BENCH_FFWD_CYCLES, false, 'D', 1, GRAPHICS_NONE, false, SUBCELLS_OFF, false, false };
+    addScenario(scenarios, &n, ffwd);
+    return n;
+}
+
+static long long nowNanos()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Everything one scenario needs, set up the same way as the interactive loop
+typedef struct {
+    Viewport vp;
+    Parallax parallax; // only with layers > 1, vp is its nearest layer
+    int layers;
+    GraphicsOutput graphics; // only with graphics set
+    int protocol;
+    Reveal reveal; // only with reveal set
+    bool hasReveal;
+    int subcells;
+    Frame fine;    // composed sub-cells, only with subcells set
+    DropIndex index; // only with pointer set, vp.index points here
+    long long hits;  // drops the pointer queries found, keeps them from being optimized out
+    Overlay overlay;
+    bool hasOverlay;
+    int clockBox;
+    Frame frame;
+    Frame shown;
+    OutBuf out;
+    OutputSink sink;
+    int renderer;
+    long long now; // virtual ms
+} BenchRun;
+
+static void renderBenchFrame(BenchRun *run)
+{
+    run->now += BENCH_MILLIS;
+    if (run->layers > 1)
+        tickParallax(&run->parallax, run->now, false);
+    else
+        updateViewport(&run->vp);
+    if (run->hasReveal)
+        markReveal(&run->reveal, &run->vp);
+    if (run->vp.index != NULL)
+    {
+        // Pointer sweeps the screen diagonally, like a mouse moved across it
+        long long step = run->now / BENCH_MILLIS;
+        run->hits += queryDrops(run->vp.index, &run->vp, (int)(step * 7 % run->vp.columns),
+            (int)(step * 3 % run->vp.rows), BENCH_POINTER_RADIUS, BENCH_POINTER_RADIUS / 2);
+    }
+
+    sinkPump(&run->sink, run->now);
+    if (!sinkReady(&run->sink))
+    {
+        run->sink.framesDropped++;
+        return;
+    }
+
+    Frame *target = run->subcells != SUBCELLS_OFF ? &run->fine : &run->frame;
+    if (run->layers > 1)
+        composeParallax(target, &run->parallax, false);
+    else
+        composePanes(target, &run->vp, 1, run->renderer);
+    if (run->hasReveal)
+        drawReveal(&run->reveal, target);
+    if (run->subcells != SUBCELLS_OFF)
+        packSubcells(&run->frame, &run->fine, run->subcells);
+    if (run->hasOverlay)
+    {
+        char clock[16];
+        long long seconds = run->now / BENCH_MILLIS / BENCH_CLOCK_FRAMES;
+        snprintf(clock, sizeof(clock), " 00:%02lld:%02lld ", seconds / 60 % 60, seconds % 60);
+        setOverlayText(&run->overlay, run->clockBox, clock);
+        drawOverlay(&run->overlay, &run->frame);
+    }
+    encodeHome(&run->out);
+    if (run->protocol != GRAPHICS_NONE)
+        encodeGraphics(&run->graphics, &run->out, &run->frame, &run->shown, 0, run->frame.height);
+    else
+        encodeUpdate(&run->out, &run->frame, &run->shown, run->renderer, 0, false);
+    sinkSubmit(&run->sink, &run->out, run->now);
+}
+
+// Time only the simulation fast-forward, nothing is rendered
+static void runFastForward(const BenchScenario *sc, unsigned int seed, BenchResult *result)
+{
+    Viewport vp;
+
+    snprintf(result->name, sizeof(result->name), "%dx%d-d%d-ffwd%lld",
+        sc->columns, sc->rows, sc->numDrops, sc->fastForward);
+
+    srand(seed);
+    srandom(seed);
+    setupViewport(&vp, 0, 0, sc->columns, sc->rows);
+    vp.numDrops = sc->numDrops;
+    initViewport(&vp);
+
+    long long allocs = allocStats.allocs;
+    long long start = nowNanos();
+
+    fastForwardViewport(&vp, sc->fastForward);
+
+    result->nsPerFrame = (double)(nowNanos() - start);
+    result->bytesPerFrame = 0;
+    result->allocsPerFrame = (double)(allocStats.allocs - allocs);
+    result->droppedFrames = 0;
+
+    freeViewport(&vp);
+}
+
+// Rain's steps of the interactive start: drops, warm start, first frame out. Option parsing,
+// terminal setup and the capability query (up to its timeout) are not in it
+static void runFirstFrame(const BenchScenario *sc, unsigned int seed, BenchResult *result)
+{
+    BenchRun run;
+    memset(&run, 0, sizeof(run));
+    run.renderer = sc->renderer;
+
+    snprintf(result->name, sizeof(result->name), "%dx%d-d%d-first-frame", sc->columns, sc->rows, sc->numDrops);
+
+    srand(seed);
+    srandom(seed);
+    sinkOpen(&run.sink, -1, 0);
+
+    long long allocs = allocStats.allocs;
+    long long start = nowNanos();
+
+    setupViewport(&run.vp, 0, 0, sc->columns, sc->rows);
+    run.vp.numDrops = sc->numDrops;
+    initViewport(&run.vp);
+    fastForwardViewport(&run.vp, sc->rows);
+    resizeFrame(&run.frame, sc->columns, sc->rows);
+    renderBenchFrame(&run);
+    sinkPump(&run.sink, run.now);
+
+    result->nsPerFrame = (double)(nowNanos() - start);
+    result->bytesPerFrame = (double)run.sink.bytesWritten;
+    result->allocsPerFrame = (double)(allocStats.allocs - allocs);
+    result->droppedFrames = 0;
+
+    sinkClose(&run.sink);
+    obFree(&run.out);
+    freeFrame(&run.frame);
+    freeFrame(&run.shown);
+    freeViewport(&run.vp);
+}
+
+// One-shot scenarios run a few times, same seed same work, the fastest run counts
+static void repeatOneShot(const BenchScenario *sc, unsigned int seed, BenchResult *result)
+{
+    double best = -1;
+
+    for (int r = 0; r < BENCH_REPEATS; r++)
+    {
+        if (sc->fastForward > 0)
+            runFastForward(sc, seed, result);
+        else
+            runFirstFrame(sc, seed, result);
+        if (best < 0 || result->nsPerFrame < best)
+            best = result->nsPerFrame;
+    }
+    result->nsPerFrame = best;
+}
+
+static void runScenario(const BenchScenario *sc, unsigned int seed, long long skip, BenchResult *result)
+{
+    if (sc->fastForward > 0 || sc->firstFrame)
+    {
+        repeatOneShot(sc, seed, result);
+        return;
+    }
+
+    BenchRun run;
+    memset(&run, 0, sizeof(run));
+    run.renderer = sc->renderer;
+
+    int len = snprintf(result->name, sizeof(result->name), "%dx%d-d%d-c%s-%s",
+        sc->columns, sc->rows, sc->numDrops, colorDepthName(sc->colors), rendererName(sc->renderer));
+    if (sc->baud > 0)
+        len += snprintf(result->name + len, sizeof(result->name) - len, "-baud%d", sc->baud);
+    if (sc->direction != 'D')
+        len += snprintf(result->name + len, sizeof(result->name) - len, "-%s",
+            sc->direction == 'U' ? "up" : sc->direction == 'L' ? "left" : "right");
+    if (sc->layers > 1)
+        len += snprintf(result->name + len, sizeof(result->name) - len, "-layers%d", sc->layers);
+    if (sc->graphics != GRAPHICS_NONE)
+        len += snprintf(result->name + len, sizeof(result->name) - len, "-%s", graphicsName(sc->graphics));
+    if (sc->reveal)
+        len += snprintf(result->name + len, sizeof(result->name) - len, "-reveal");
+    if (sc->subcells != SUBCELLS_OFF)
+        len += snprintf(result->name + len, sizeof(result->name) - len, "-%s", sc->subcells == SUBCELLS_HALF ? "half" : "braille");
+    if (sc->pointer)
+        len += snprintf(result->name + len, sizeof(result->name) - len, "-pointer");
+    if (sc->overlay)
+        snprintf(result->name + len, sizeof(result->name) - len, "-overlay");
+
+    srand(seed);
+    srandom(seed);
+    setColorDepth(sc->colors);
+
+    // 10 bits on the wire per byte
+    sinkOpen(&run.sink, -1, sc->baud / 10);
+
+    int sx, sy;
+    subcellScale(sc->subcells, &sx, &sy);
+    run.subcells = sc->subcells;
+    resizeFrame(&run.fine, sc->columns * sx, sc->rows * sy);
+
+    setupViewport(&run.vp, 0, 0, sc->columns * sx, sc->rows * sy);
+    run.vp.numDrops = sc->numDrops;
+    setViewportDirection(&run.vp, sc->direction);
+    if (sc->pointer)
+        run.vp.index = &run.index;
+    initViewport(&run.vp);
+    fastForwardViewport(&run.vp, skip);
+    resizeFrame(&run.frame, sc->columns, sc->rows);
+    run.layers = sc->layers;
+    if (run.layers > 1)
+    {
+        // Every frame is a tick of the nearest layer, the ones behind step every 2nd, 3rd.. frame
+        run.vp.millis = BENCH_MILLIS;
+        initParallax(&run.parallax, &run.vp, run.layers, skip);
+        clearFrame(&run.frame);
+        clearFrame(&run.fine);
+    }
+    run.protocol = sc->graphics;
+    if (run.protocol != GRAPHICS_NONE)
+        initGraphics(&run.graphics, run.protocol, BENCH_CELL_WIDTH, BENCH_CELL_HEIGHT, 1);
+    run.hasReveal = sc->reveal;
+    if (run.hasReveal)
+    {
+        Mask text;
+        rasterizeText(&text, BENCH_REVEAL_TEXT);
+        initReveal(&run.reveal, &text);
+        fitReveal(&run.reveal, run.vp.columns, run.vp.rows);
+    }
+    run.hasOverlay = sc->overlay;
+    if (run.hasOverlay)
+    {
+        initOverlay(&run.overlay);
+        setOverlayText(&run.overlay, addOverlayBox(&run.overlay, 0, 0, 0, -1, STYLE_OVERLAY),
+            "Terminal size:: y:60 rows | x:200 columns | refresh rate: 20 | numDrops: 2000 | ");
+        run.clockBox = addOverlayBox(&run.overlay, -10, 0, 1, 0, STYLE_OVERLAY);
+    }
+
+    for (int i = 0; i < BENCH_WARMUP; i++)
+    {
+        renderBenchFrame(&run);
+    }
+    // Buffers grew during warmup, a busier frame later on would otherwise count as allocating
+    size_t peak = run.out.cap > run.sink.pending.cap ? run.out.cap : run.sink.pending.cap;
+    sinkReserve(&run.sink, &run.out, peak * BENCH_OUTPUT_HEADROOM);
+
+    long long bytes = run.sink.bytesWritten;
+    long long dropped = run.sink.framesDropped;
+    long long allocs = allocStats.allocs;
+
+    // Something else running takes a batch or two, not all of them
+    result->nsPerFrame = -1;
+    for (int b = 0; b < BENCH_REPEATS; b++)
+    {
+        int frames = sc->frames * (b + 1) / BENCH_REPEATS - sc->frames * b / BENCH_REPEATS;
+        long long start = nowNanos();
+
+        for (int i = 0; i < frames; i++)
+        {
+            renderBenchFrame(&run);
+        }
+
+        double ns = (double)(nowNanos() - start) / frames;
+        if (frames > 0 && (result->nsPerFrame < 0 || ns < result->nsPerFrame))
+            result->nsPerFrame = ns;
+    }
+    result->bytesPerFrame = (double)(run.sink.bytesWritten - bytes) / sc->frames;
+    result->allocsPerFrame = (double)(allocStats.allocs - allocs) / sc->frames;
+    result->droppedFrames = (double)(run.sink.framesDropped - dropped) / sc->frames;
+
+    sinkClose(&run.sink);
+    obFree(&run.out);
+    freeFrame(&run.fine);
+    freeFrame(&run.frame);
+    freeFrame(&run.shown);
+    if (run.layers > 1)
+        freeParallax(&run.parallax);
+    if (run.protocol != GRAPHICS_NONE)
+        freeGraphics(&run.graphics);
+    if (run.hasReveal)
+        freeReveal(&run.reveal);
+    freeDropIndex(&run.index);
+    freeViewport(&run.vp);
+    setColorDepth(COLORS_16);
+}
+
+static int saveBaseline(const char *path, const BenchResult *results, int n, const BenchTolerance *tol)
+{
+    FILE *f = fopen(path, "w");
+    if (f == NULL)
+    {
+        perror(path);
+        return 1;
+    }
+
+    fprintf(f, "# matrix bench baseline, regenerate with: make perf-baseline\n");
+    fprintf(f, "# tolerance <metric> <allowed relative increase>\n");
+    fprintf(f, "tolerance ns %.2f\n", tol->ns);
+    fprintf(f, "tolerance bytes %.2f\n", tol->bytes);
+    fprintf(f, "tolerance allocs %.2f\n", tol->allocs);
+    fprintf(f, "# scenario ns/frame bytes/frame allocs/frame\n");
+    for (int i = 0; i < n; i++)
+    {
+        fprintf(f, "%s %.0f %.1f %.3f\n",
+            results[i].name, results[i].nsPerFrame, results[i].bytesPerFrame, results[i].allocsPerFrame);
+    }
+    fclose(f);
+    printf("Baseline saved to %s\n", path);
+    return 0;
+}
+
+// Load baseline into a new array, returns number of entries or -1 if the file can't be read
+static int loadBaseline(const char *path, BenchResult **baseline, BenchTolerance *tol)
+{
+    FILE *f = fopen(path, "r");
+    if (f == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+
+    char line[256];
+    int n = 0, room = 0;
+    BenchResult entry;
+    *baseline = NULL;
+    while (fgets(line, sizeof(line), f) != NULL)
+    {
+        char metric[32];
+        double value;
+
+        if (line[0] == '#' || line[0] == '\n')
+            continue;
+
+        if (sscanf(line, "tolerance %31s %lf", metric, &value) == 2)
+        {
+            if (strcmp(metric, "ns") == 0) tol->ns = value;
+            else if (strcmp(metric, "bytes") == 0) tol->bytes = value;
+            else if (strcmp(metric, "allocs") == 0) tol->allocs = value;
+            continue;
+        }
+
+        if (sscanf(line, "%63s %lf %lf %lf", entry.name,
+                &entry.nsPerFrame, &entry.bytesPerFrame, &entry.allocsPerFrame) == 4)
+        {
+            if (n == room)
+            {
+                room = room ? room * 2 : 64;
+                *baseline = (BenchResult *)memRealloc(*baseline, room * sizeof(BenchResult));
+            }
+            (*baseline)[n++] = entry;
+        }
+    }
+    fclose(f);
+    return n;
+}
+
+static bool exceeds(double value, double base, double tolerance)
+{
+    // Small absolute slack so zero baselines don't fail on rounding
+    return value > base * (1.0 + tolerance) + 0.001;
+}
+
+static int checkBaseline(const char *path, const BenchResult *results, int n, BenchTolerance *tol)
+{
+    BenchResult *baseline;
+    int m = loadBaseline(path, &baseline, tol);
+    if (m < 0)
+        return 1;
+
+    int regressions = 0;
+    for (int i = 0; i < n; i++)
+    {
+        const BenchResult *base = NULL;
+        for (int j = 0; j < m; j++)
+        {
+            if (strcmp(baseline[j].name, results[i].name) == 0)
+                base = &baseline[j];
+        }
+
+        if (base == NULL)
+        {
+            printf("%-36s not in baseline\n", results[i].name);
+            continue;
+        }
+
+        const char *what = NULL;
+        if (exceeds(results[i].allocsPerFrame, base->allocsPerFrame, tol->allocs))
+            what = "allocs/frame";
+        else if (exceeds(results[i].bytesPerFrame, base->bytesPerFrame, tol->bytes))
+            what = "bytes/frame";
+        else if (exceeds(results[i].nsPerFrame, base->nsPerFrame, tol->ns))
+            what = "ns/frame";
+
+        if (what != NULL)
+        {
+            printf("%-36s REGRESSION in %s (ns %.0f vs %.0f, bytes %.1f vs %.1f, allocs %.3f vs %.3f)\n",
+                results[i].name, what,
+                results[i].nsPerFrame, base->nsPerFrame,
+                results[i].bytesPerFrame, base->bytesPerFrame,
+                results[i].allocsPerFrame, base->allocsPerFrame);
+            regressions++;
+        }
+    }
+
+    memFree(baseline);
+    if (regressions > 0)
+    {
+        printf("perf-check: %d scenario(s) regressed\n", regressions);
+        return 1;
+    }
+    printf("perf-check: all %d scenarios within tolerance\n", n);
+    return 0;
+}
+
+int runBench(unsigned int seed, long long skip, const char *savePath, const char *checkPath)
+{
+    BenchTolerance tol = { 0.35, 0.02, 0.0 };
+    int n = buildScenarios(NULL);
+    BenchScenario *scenarios = (BenchScenario *)memAlloc(n * sizeof(BenchScenario));
+    BenchResult *results = (BenchResult *)memAlloc(n * sizeof(BenchResult));
+
+    buildScenarios(scenarios);
+
+    printf("%-36s %12s %12s %12s %8s\n", "scenario", "ns/frame", "bytes/frame", "allocs/frame", "dropped");
+    for (int i = 0; i < n; i++)
+    {
+        runScenario(&scenarios[i], seed, skip, &results[i]);
+        printf("%-36s %12.0f %12.1f %12.3f %7.1f%%\n",
+            results[i].name, results[i].nsPerFrame, results[i].bytesPerFrame, results[i].allocsPerFrame,
+            results[i].droppedFrames * 100);
+        fflush(stdout);
+    }
+
+    int rc = 0;
+    if (checkPath != NULL)
+        rc = checkBaseline(checkPath, results, n, &tol);
+    if (savePath != NULL && rc == 0)
+        rc = saveBaseline(savePath, results, n, &tol);
+    memFree(scenarios);
+    memFree(results);
+    return rc;
+}
@@ -0,0 +1,15 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+/**
+ * Headless benchmark over a fixed matrix of scenarios (terminal size, drop count,
+ * color depth, renderer), every scenario is seeded with the same seed so
+ * bytes and allocations are exactly reproducible.
+ * Every scenario is fast-forwarded by skip cycles before the warmup.
+ * If savePath is given results are written there as the new baseline,
+ * if checkPath is given results are compared with that baseline.
+ * Returns exit code, non zero if any scenario regressed.
+ */
+int runBench(unsigned int seed, long long skip, const char *savePath, const char *checkPath);
+
+#endif
@@ -0,0 +1,182 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "Control.h"
+
+int controlOpen(ControlServer *cs, const char *path)
+{
+    memset(cs, 0, sizeof(*cs));
+    cs->fd = -1;
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path))
+    {
+        fprintf(stderr, "Control socket path too long '%s'\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    // Socket of a previous run that was killed, anything else we don't touch
+    struct stat st;
+    if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+        unlink(path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, CONTROL_MAX_CLIENTS) < 0)
+    {
+        perror(path);
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+
+    cs->fd = fd;
+    cs->path = path;
+    return 0;
+}
+
+static void dropClient(ControlServer *cs, int i)
+{
+    close(cs->clients[i].fd);
+    obFree(&cs->clients[i].out);
+    cs->clients[i] = cs->clients[--cs->numClients];
+}
+
+void controlClose(ControlServer *cs)
+{
+    if (cs->fd < 0)
+        return;
+
+    while (cs->numClients > 0)
+    {
+        dropClient(cs, 0);
+    }
+    close(cs->fd);
+    unlink(cs->path);
+    cs->fd = -1;
+}
+
+int controlPollFds(const ControlServer *cs, struct pollfd *fds, int max)
+{
+    int n = 0;
+    if (cs->fd < 0 || max < 1)
+        return 0;
+
+    fds[n++] = (struct pollfd){ cs->fd, POLLIN, 0 };
+    for (int i = 0; i < cs->numClients && n < max; i++)
+    {
+        const ControlClient *client = &cs->clients[i];
+        short events = (client->eof ? 0 : POLLIN) | (client->sent < client->out.len ? POLLOUT : 0);
+        fds[n++] = (struct pollfd){ client->fd, events, 0 };
+    }
+    return n;
+}
+
+static void acceptClients(ControlServer *cs)
+{
+    while (1)
+    {
+        int fd = accept(cs->fd, NULL, NULL);
+        if (fd < 0)
+            return;
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+        if (cs->numClients >= CONTROL_MAX_CLIENTS)
+        {
+            const char *busy = "error too many clients\n";
+            if (write(fd, busy, strlen(busy)) < 0) {} // nothing to do if it fails
+            close(fd);
+            continue;
+        }
+        cs->clients[cs->numClients++] = (ControlClient){ fd, 0, "", { 0 }, 0, false };
+    }
+}
+
+// Returns false if the connection broke
+static bool readClient(ControlClient *client, ControlHandler handler)
+{
+    if (client->eof)
+        return true;
+
+    char buf[512];
+    ssize_t n = read(client->fd, buf, sizeof(buf));
+    if (n == 0)
+    {
+        client->eof = true;
+        return true;
+    }
+    if (n < 0)
+        return errno == EAGAIN || errno == EINTR;
+
+    for (ssize_t i = 0; i < n; i++)
+    {
+        char c = buf[i];
+        if (c == '\r')
+            continue;
+
+        if (c != '\n')
+        {
+            // Overlong line is cut, the command will fail to parse and say so
+            if (client->len < CONTROL_LINE_MAX - 1)
+                client->line[client->len++] = c;
+            continue;
+        }
+
+        client->line[client->len] = '\0';
+        client->len = 0;
+        if (client->line[0] == '\0')
+            continue;
+
+        handler(client->line, &client->out);
+    }
+    return true;
+}
+
+// Send as much of the answers as the socket takes, the rest waits for POLLOUT.
+// Returns false if the client is gone or stopped reading
+static bool writeClient(ControlClient *client)
+{
+    while (client->sent < client->out.len)
+    {
+        // No SIGPIPE when the client hung up before reading its answer
+        ssize_t n = send(client->fd, client->out.data + client->sent, client->out.len - client->sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        if (n <= 0)
+            return false;
+        client->sent += (size_t)n;
+    }
+
+    if (client->sent >= client->out.len)
+    {
+        obReset(&client->out);
+        client->sent = 0;
+    }
+    return client->out.len - client->sent <= CONTROL_PENDING_MAX;
+}
+
+void controlProcess(ControlServer *cs, ControlHandler handler)
+{
+    if (cs->fd < 0)
+        return;
+
+    acceptClients(cs);
+
+    for (int i = cs->numClients - 1; i >= 0; i--)
+    {
+        ControlClient *client = &cs->clients[i];
+        if (!readClient(client, handler) || !writeClient(client) || (client->eof && client->out.len == 0))
+            dropClient(cs, i);
+    }
+}
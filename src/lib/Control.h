@@ -0,0 +1,47 @@
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include <poll.h>
+
+#include "Output.h"
+
+#define CONTROL_MAX_CLIENTS 8
+#define CONTROL_LINE_MAX 256
+#define CONTROL_PENDING_MAX (64 * 1024) // unsent answers a client may have, one that doesn't read is dropped
+
+typedef struct {
+    int fd;
+    int len;
+    char line[CONTROL_LINE_MAX];
+    OutBuf out;  // answers the socket didn't take yet
+    size_t sent; // how much of out is already written
+    bool eof;    // client sent all it had, it goes once its answers are out
+} ControlClient;
+
+/**
+ * Local control channel, a unix domain stream socket with one command per line.
+ * Everything is non-blocking, it is polled from the main loop together with the keyboard.
+ */
+typedef struct {
+    int fd;             // listening socket, -1 if closed
+    const char *path;
+    int numClients;
+    ControlClient clients[CONTROL_MAX_CLIENTS];
+} ControlServer;
+
+// Handler gets one line without the newline and appends its answer to reply
+typedef void (*ControlHandler)(const char *line, OutBuf *reply);
+
+// Listen on path, a stale socket left there is replaced. Returns -1 with a message on error
+int controlOpen(ControlServer *cs, const char *path);
+
+// Close all connections and remove the socket file
+void controlClose(ControlServer *cs);
+
+// Add descriptors to wait for (clients with unsent answers also for writing), returns how many were added
+int controlPollFds(const ControlServer *cs, struct pollfd *fds, int max);
+
+// Accept new clients, read what arrived, answer every complete line and send what is still pending
+void controlProcess(ControlServer *cs, ControlHandler handler);
+
+#endif
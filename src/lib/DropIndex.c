@@ -0,0 +1,138 @@
+#include <string.h>
+
+#include "DropIndex.h"
+#include "Memory.h"
+
+static inline bool isVertical(const Viewport *vp)
+{
+    return vp->direction == 'D' || vp->direction == 'U';
+}
+
+static inline int laneCount(const Viewport *vp, bool vertical)
+{
+    return (vertical ? vp->columns : vp->rows) + 1;
+}
+
+static inline int clampLane(const DropIndex *index, int lane)
+{
+    if (lane < 0)
+        return 0;
+    return lane < index->lanes ? lane : index->lanes - 1;
+}
+
+static inline void unlinkDrop(DropIndex *index, int i)
+{
+    int prev = index->prev[i];
+    int next = index->next[i];
+
+    if (prev >= 0)
+        index->next[prev] = next;
+    else
+        index->head[index->lane[i]] = next;
+    if (next >= 0)
+        index->prev[next] = prev;
+}
+
+static inline void linkDrop(DropIndex *index, int i, int lane)
+{
+    int first = index->head[lane];
+
+    index->lane[i] = lane;
+    index->prev[i] = -1;
+    index->next[i] = first;
+    if (first >= 0)
+        index->prev[first] = i;
+    index->head[lane] = i;
+}
+
+void freeDropIndex(DropIndex *index)
+{
+    memFree(index->head);
+    memFree(index->next);
+    memFree(index->prev);
+    memFree(index->lane);
+    memFree(index->hits);
+    memset(index, 0, sizeof(*index));
+}
+
+void rebuildDropIndex(DropIndex *index, const Viewport *vp)
+{
+    bool vertical = isVertical(vp);
+    int lanes = laneCount(vp, vertical);
+    int n = vp->drops != NULL ? vp->numDrops : 0;
+
+    if (lanes != index->lanes || index->head == NULL)
+    {
+        index->head = memRealloc(index->head, lanes * sizeof(int));
+        index->lanes = lanes;
+    }
+    if (n > index->capacity || index->lane == NULL)
+    {
+        int room = n > 0 ? n : 1;
+        index->next = memRealloc(index->next, room * sizeof(int));
+        index->prev = memRealloc(index->prev, room * sizeof(int));
+        index->lane = memRealloc(index->lane, room * sizeof(int));
+        index->hits = memRealloc(index->hits, room * sizeof(int));
+        index->capacity = room;
+    }
+    index->numDrops = n;
+    index->vertical = vertical;
+
+    for (int l = 0; l < lanes; l++)
+    {
+        index->head[l] = -1;
+    }
+    // Backwards, so every lane lists its drops in order
+    for (int i = n - 1; i >= 0; i--)
+    {
+        const Position *drop = &vp->drops[i];
+        linkDrop(index, i, clampLane(index, vertical ? drop->x : drop->y));
+    }
+}
+
+void moveDropLane(DropIndex *index, int i, int lane)
+{
+    // Not built yet for these drops, the next rebuild puts it right
+    if (i >= index->numDrops)
+        return;
+
+    lane = clampLane(index, lane);
+    if (lane == index->lane[i])
+        return;
+    unlinkDrop(index, i);
+    linkDrop(index, i, lane);
+}
+
+int queryDrops(DropIndex *index, const Viewport *vp, int x, int y, int rx, int ry)
+{
+    bool vertical = isVertical(vp);
+    int n = vp->drops != NULL ? vp->numDrops : 0;
+
+    if (index->lanes != laneCount(vp, vertical) || index->numDrops != n || index->vertical != vertical)
+        rebuildDropIndex(index, vp);
+    if (rx < 1 || ry < 1)
+        return 0;
+
+    int lane = vertical ? x : y;
+    int along = vertical ? y : x;
+    long long rl = vertical ? rx : ry;
+    long long ra = vertical ? ry : rx;
+    long long limit = rl * rl * ra * ra;
+    int last = clampLane(index, lane + (int)rl);
+    int count = 0;
+
+    // Drops past the edge sit in the last lane, the distance below uses where they really are
+    for (int l = clampLane(index, lane - (int)rl); l <= last; l++)
+    {
+        for (int i = index->head[l]; i >= 0; i = index->next[i])
+        {
+            const Position *drop = &vp->drops[i];
+            long long dl = (vertical ? drop->x : drop->y) - lane;
+            long long da = (vertical ? drop->y : drop->x) - along;
+
+            if (dl * dl * ra * ra + da * da * rl * rl <= limit)
+                index->hits[count++] = i;
+        }
+    }
+    return count;
+}
@@ -0,0 +1,41 @@
+#ifndef DROP_INDEX_H
+#define DROP_INDEX_H
+
+#include <stdbool.h>
+
+#include "types/Viewport.h"
+
+/**
+ * Drops of a pane bucketed by lane: the column they fall in, or the row for horizontal rain.
+ * A drop changes lane only when it wraps, so the kernels move it to its new bucket right there
+ * and an area query looks only at the lanes it covers instead of every drop.
+ * Lanes are doubly linked lists through per drop arrays, nothing is allocated between rebuilds.
+ */
+typedef struct DropIndex {
+    int lanes;     // columns + 1 (or rows + 1), a head can sit on the far edge
+    int numDrops;
+    bool vertical; // lane is x for down and up, y for left and right
+    int capacity;  // drops the arrays have room for
+    int *head;     // first drop of every lane, -1 if none
+    int *next;     // per drop, -1 ends the lane
+    int *prev;
+    int *lane;
+    int *hits;     // drops found by the last query
+} DropIndex;
+
+void freeDropIndex(DropIndex *index);
+
+// Bucket every drop of the pane again, after drops were placed, added or turned
+void rebuildDropIndex(DropIndex *index, const Viewport *vp);
+
+// Drop i wrapped into another lane (lanes past the edge go to the last one)
+void moveDropLane(DropIndex *index, int i, int lane);
+
+/**
+ * Drops whose head is inside the ellipse with radii rx, ry (at least 1) around x, y,
+ * in pane coordinates. Returns how many, they are in index->hits. Costs the drops of the
+ * covered lanes, the index is rebuilt first if the pane changed size or drops under it.
+ */
+int queryDrops(DropIndex *index, const Viewport *vp, int x, int y, int rx, int ry);
+
+#endif
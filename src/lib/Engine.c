@@ -0,0 +1,262 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "Engine.h"
+#include "Viewport.h"
+#include "Renderer.h"
+#include "Occupancy.h"
+
+int parseDirection(const char *name)
+{
+    if (strcmp(name, "down") == 0) return 'D';
+    if (strcmp(name, "up") == 0) return 'U';
+    if (strcmp(name, "left") == 0) return 'L';
+    if (strcmp(name, "right") == 0) return 'R';
+    return 0;
+}
+
+void initEngine(Engine *e)
+{
+    memset(e, 0, sizeof(*e));
+    e->numLayers = 1;
+    e->renderer = RENDERER_DIFF;
+    e->features = ENCODE_ERASE | ENCODE_REPEAT;
+    e->colors = COLORS_16;
+    e->direction = 'D';
+}
+
+void startEngine(Engine *e, long long skip)
+{
+    for (int i = 0; i < e->numPanes; i++)
+    {
+        Viewport *vp = &e->panes[i];
+        long long cycles = skip < 0 ? vp->rows : skip;
+
+        // Near layer only, that's where the pointer is
+        vp->index = e->pointer ? &e->indexes[i] : NULL;
+        initViewport(vp);
+        if (e->minLength > 0)
+            setDropLengths(vp, e->minLength, e->maxLength);
+        // Start with a full screen of rain instead of an empty one
+        fastForwardViewport(vp, cycles);
+        if (e->numLayers > 1)
+            initParallax(&e->parallax[i], vp, e->numLayers, cycles);
+    }
+    // Uncovering starts over with the rain, the fast-forward doesn't count
+    if (e->reveal != NULL)
+        resetReveal(e->reveal);
+}
+
+void stopEngine(Engine *e)
+{
+    for (int i = 0; i < e->numPanes; i++)
+    {
+        if (e->numLayers > 1)
+            freeParallax(&e->parallax[i]);
+        freeViewport(&e->panes[i]);
+        freeDropIndex(&e->indexes[i]);
+        e->panes[i].index = NULL;
+    }
+    e->numPanes = 0;
+}
+
+void freeEngine(Engine *e)
+{
+    stopEngine(e);
+    freeFrame(&e->fine);
+    freeFrame(&e->frame);
+    freeFrame(&e->shown);
+}
+
+void setEngineDirection(Engine *e, int direction)
+{
+    e->direction = direction;
+    for (int i = 0; i < e->numPanes; i++)
+    {
+        setViewportDirection(&e->panes[i], direction);
+    }
+    syncEngineLayers(e);
+}
+
+void syncEngineLayers(Engine *e)
+{
+    if (e->numLayers < 2)
+        return;
+    for (int i = 0; i < e->numPanes; i++)
+    {
+        syncParallax(&e->parallax[i]);
+    }
+}
+
+long long tickEngine(Engine *e, long long now, bool paused)
+{
+    long long next = -1;
+
+    for (int i = 0; i < e->numPanes; i++)
+    {
+        Viewport *vp = &e->panes[i];
+        long long due;
+
+        if (e->numLayers > 1)
+            due = tickParallax(&e->parallax[i], now, paused);
+        else
+        {
+            if (now >= vp->nextTick)
+            {
+                if (!paused)
+                    updateViewport(vp);
+                vp->nextTick = now + vp->millis;
+            }
+            due = vp->nextTick;
+        }
+        if (e->reveal != NULL && !paused)
+            markReveal(e->reveal, vp);
+        if (next < 0 || due < next)
+            next = due;
+    }
+    return next;
+}
+
+// Put drop i of pane p elsewhere, lane and along are its coordinates across and along the rain
+static void moveDrop(Engine *e, int p, int i, int lane, int along)
+{
+    Viewport *vp = &e->panes[p];
+    Position *drop = &vp->drops[i];
+    bool vertical = vp->direction == 'D' || vp->direction == 'U';
+
+    // Layers repaint only what they were told changed
+    if (e->numLayers > 1)
+        markLayerCell(&e->parallax[p], 0, drop->x, drop->y);
+    moveLane(vp, vertical ? drop->x : drop->y, lane);
+    drop->x = vertical ? lane : along;
+    drop->y = vertical ? along : lane;
+    moveDropLane(vp->index, i, lane);
+    if (e->numLayers > 1)
+        markLayerCell(&e->parallax[p], 0, drop->x, drop->y);
+}
+
+static int clampInt(int v, int lo, int hi)
+{
+    return v < lo ? lo : v > hi ? hi : v;
+}
+
+void pointerEngine(Engine *e, int x, int y, int radius, bool press)
+{
+    int sx, sy;
+    if (radius < 1)
+        return;
+    subcellScale(e->subcells, &sx, &sy);
+
+    // A cell is about twice as high as wide, half as many rows keeps the area round on screen
+    int rx = radius * sx;
+    int ry = radius * sy / 2 > 0 ? radius * sy / 2 : 1;
+
+    for (int p = 0; p < e->numPanes; p++)
+    {
+        Viewport *vp = &e->panes[p];
+        if (vp->index == NULL || vp->drops == NULL)
+            continue;
+
+        // Middle of the cell, in the pane's own (sub-)cells
+        int px = x * sx + sx / 2 - vp->paddingLeft;
+        int py = y * sy + sy / 2 - vp->paddingTop;
+        if (px < 0 || py < 0 || px >= vp->columns || py >= vp->rows)
+            continue;
+
+        bool vertical = vp->direction == 'D' || vp->direction == 'U';
+        int rl = vertical ? rx : ry;
+        int ra = vertical ? ry : rx;
+        int maxLane = vertical ? vp->columns - vp->paddingRight - 1 : vp->rows - vp->paddingBottom - 1;
+        int maxAlong = vertical ? vp->rows : vp->columns;
+        int back = vp->direction == 'D' || vp->direction == 'R' ? -1 : 1; // where drops come from
+
+        int n = queryDrops(vp->index, vp, px, py, rx, ry);
+        for (int k = 0; k < n; k++)
+        {
+            int i = vp->index->hits[k];
+            int lane = vertical ? vp->drops[i].x : vp->drops[i].y;
+            int along = vertical ? vp->drops[i].y : vp->drops[i].x;
+
+            if (press)
+            {
+                lane += rand() % (2 * rl + 1) - rl;
+                along += back * (1 + rand() % (2 * ra));
+            }
+            else
+            {
+                // Leaps over the area, it goes on falling below the pointer
+                along = (vertical ? py : px) - back * (ra + 1);
+            }
+            moveDrop(e, p, i, clampInt(lane, 0, maxLane), clampInt(along, 0, maxAlong));
+        }
+    }
+}
+
+void composeEngine(Engine *e, int width, int height)
+{
+    int sx, sy;
+    subcellScale(e->subcells, &sx, &sy);
+
+    // With sub-cells the panes are composed at the finer size, then packed into cells.
+    // Layers keep their picture between frames, boxes drawn over it would stay behind, so
+    // with an overlay they get a frame of their own too
+    bool layered = e->numLayers > 1 && e->overlay != NULL;
+    Frame *target = e->subcells != SUBCELLS_OFF || layered ? &e->fine : &e->frame;
+    width *= sx;
+    height *= sy;
+
+    if (e->numLayers > 1)
+    {
+        // Layers only repaint what changed, frame is kept between frames unless its size changed
+        bool full = target->cells == NULL || target->width != width || target->height != height;
+        resizeFrame(target, width, height);
+        if (full)
+            clearFrame(target);
+        for (int i = 0; i < e->numPanes; i++)
+        {
+            composeParallax(target, &e->parallax[i], full);
+        }
+    }
+    else
+    {
+        resizeFrame(target, width, height);
+        composePanes(target, e->panes, e->numPanes, e->renderer);
+    }
+
+    if (e->reveal != NULL)
+    {
+        fitReveal(e->reveal, width, height);
+        drawReveal(e->reveal, target);
+    }
+
+    if (e->subcells != SUBCELLS_OFF)
+    {
+        resizeFrame(&e->frame, width / sx, height / sy);
+        packSubcells(&e->frame, &e->fine, e->subcells);
+    }
+    else if (layered)
+        copyFrame(&e->frame, &e->fine);
+
+    if (e->overlay != NULL)
+        drawOverlay(e->overlay, &e->frame);
+}
+
+void encodeEngine(Engine *e, OutBuf *ob, int originRow, bool debugMode)
+{
+    // Palette and encoder features are shared, several engines in one process take turns
+    if (currentColorDepth() != e->colors)
+        setColorDepth(e->colors);
+    setEncoderFeatures(e->features);
+
+    encodeUpdate(ob, &e->frame, &e->shown, e->renderer, originRow, debugMode);
+}
+
+int countDrops(const Engine *e)
+{
+    int total = 0;
+    for (int i = 0; i < e->numPanes; i++)
+    {
+        total += e->panes[i].numDrops;
+    }
+    return total;
+}
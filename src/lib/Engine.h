@@ -0,0 +1,85 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <stdbool.h>
+
+#include "Frame.h"
+#include "Output.h"
+#include "Parallax.h"
+#include "Reveal.h"
+#include "DropIndex.h"
+#include "Overlay.h"
+
+#define MAX_PANES 16
+
+/**
+ * Simulation and renderer of one rain screen: the panes with their depth layers,
+ * the composed frame and what the output already shows. The engine never touches
+ * a terminal, where panes are placed and where the bytes go is up to the frontend.
+ */
+typedef struct {
+    Viewport panes[MAX_PANES];
+    Parallax parallax[MAX_PANES]; // used when numLayers > 1
+    int numPanes;
+    int numLayers;  // depth layers per pane, 1 = flat rain
+    int renderer;   // RENDERER_*
+    int features;   // ENCODE_* the terminal has
+    int colors;     // COLORS_*
+    int direction;  // 'D', 'U', 'L' or 'R'
+    int minLength;  // drop lengths, 0 = lengths follow the pane height
+    int maxLength;
+    int subcells;   // SUBCELLS_*, panes are then laid out in sub-cells
+    Frame fine;     // sub-cells composed before they are packed into frame, or layers under an overlay
+    Frame frame;
+    Frame shown;    // what the output currently shows, empty if unknown
+    Reveal *reveal; // image the rain uncovers, NULL if none
+    Overlay *overlay; // text boxes over the rain, NULL if none
+    bool pointer;   // panes keep their drops indexed by lane, for pointerEngine
+    DropIndex indexes[MAX_PANES];
+} Engine;
+
+// Direction name to 'D', 'U', 'L' or 'R', 0 if unknown
+int parseDirection(const char *name);
+
+// Engine without panes, the caller sets them up (setupViewport) and starts it
+void initEngine(Engine *e);
+
+/**
+ * Allocate drops of every pane and simulate skip cycles before the first frame
+ * (-1 = as many as the pane is high), layers behind are created here too.
+ */
+void startEngine(Engine *e, long long skip);
+
+// Free the panes and their layers, frame and shown stay
+void stopEngine(Engine *e);
+
+void freeEngine(Engine *e);
+
+// Turn the rain of every pane, drops go on from where they are
+void setEngineDirection(Engine *e, int direction);
+
+// Layers behind follow changed settings of their pane
+void syncEngineLayers(Engine *e);
+
+// Step every pane (and layer) that is due at now, return the time the next one is due
+long long tickEngine(Engine *e, long long now, bool paused);
+
+/**
+ * Pointer over the cell x, y of the frame: drops within radius cells leap over it, so the
+ * rain parts around the pointer, with press they splash back up the way they came.
+ * One query per pane, needs pointer set before startEngine.
+ */
+void pointerEngine(Engine *e, int x, int y, int radius, bool press);
+
+// Compose all panes into a frame of the given size (terminal cells, also with sub-cells), overlay on top
+void composeEngine(Engine *e, int width, int height);
+
+/**
+ * Encode the composed frame with the engine's renderer and colors, shown is updated.
+ * For a full repaint the cursor must already be at the start of originRow.
+ */
+void encodeEngine(Engine *e, OutBuf *ob, int originRow, bool debugMode);
+
+int countDrops(const Engine *e);
+
+#endif
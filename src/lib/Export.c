@@ -0,0 +1,179 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "Export.h"
+#include "Frame.h"
+#include "Font.h"
+#include "Memory.h"
+#include "Trace.h"
+
+/**
+ * Frames are simulated in batches (that part is sequential and deterministic),
+ * then the pool rasterizes the whole batch in parallel and frames are written in order.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t done;
+    int next;        // next frame of the batch to take
+    int count;       // frames in the batch
+    int finished;
+    bool quit;
+    const GlyphAtlas *atlas;
+    Frame *frames;
+    unsigned char **images;
+} ExportPool;
+
+static void* exportWorker(void *arg)
+{
+    ExportPool *pool = (ExportPool *)arg;
+    traceThread("rasterizer");
+
+    pthread_mutex_lock(&pool->lock);
+    while (1)
+    {
+        while (!pool->quit && pool->next >= pool->count)
+            pthread_cond_wait(&pool->work, &pool->lock);
+        if (pool->quit)
+            break;
+
+        int i = pool->next++;
+        pthread_mutex_unlock(&pool->lock);
+
+        TRACE_BEGIN("rasterize");
+        rasterizeFrame(pool->atlas, &pool->frames[i], pool->images[i]);
+        TRACE_END("rasterize");
+
+        pthread_mutex_lock(&pool->lock);
+        if (++pool->finished == pool->count)
+            pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+static void rasterizeBatch(ExportPool *pool, int count)
+{
+    pthread_mutex_lock(&pool->lock);
+    pool->count = count;
+    pool->next = 0;
+    pool->finished = 0;
+    pthread_cond_broadcast(&pool->work);
+    while (pool->finished < pool->count)
+        pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+static int writeImage(const ExportOptions *opts, int index, const unsigned char *rgb, int width, int height)
+{
+    size_t size = (size_t)width * height * 3;
+
+    if (opts->format == EXPORT_RAW)
+        return fwrite(rgb, 1, size, stdout) == size ? 0 : -1;
+
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/frame_%06d.ppm", opts->dir, index);
+
+    FILE *f = fopen(path, "wb");
+    if (f == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+    fprintf(f, "P6\n%d %d\n255\n", width, height);
+    size_t written = fwrite(rgb, 1, size, f);
+    fclose(f);
+    return written == size ? 0 : -1;
+}
+
+int runExport(Engine *e, const ExportOptions *opts)
+{
+    int threads = opts->threads > 0 ? opts->threads : 1;
+    int batch = threads * 2;
+    long long clock = 0; // simulation time, jumps from one due step to the next like in stream
+    long long due = 0;
+
+    GlyphAtlas atlas;
+    buildAtlas(&atlas, opts->scale);
+
+    int width = opts->columns * atlas.tileWidth;
+    int height = opts->rows * atlas.tileHeight;
+
+    ExportPool pool;
+    memset(&pool, 0, sizeof(pool));
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.work, NULL);
+    pthread_cond_init(&pool.done, NULL);
+    pool.atlas = &atlas;
+    pool.frames = (Frame *)memCalloc(batch, sizeof(Frame));
+    pool.images = (unsigned char **)memCalloc(batch, sizeof(unsigned char *));
+    for (int i = 0; i < batch; i++)
+    {
+        resizeFrame(&pool.frames[i], opts->columns, opts->rows);
+        pool.images[i] = (unsigned char *)memAlloc((size_t)width * height * 3);
+    }
+
+    pthread_t *workers = (pthread_t *)memCalloc(threads, sizeof(pthread_t));
+    for (int i = 0; i < threads; i++)
+        pthread_create(&workers[i], NULL, exportWorker, &pool);
+
+    fprintf(stderr, "export: %d frames of %dx%d px, rgb24, %d threads\n", opts->frames, width, height, threads);
+    if (opts->format == EXPORT_RAW)
+        fprintf(stderr, "export: e.g. | ffmpeg -f rawvideo -pix_fmt rgb24 -s %dx%d -r 50 -i - rain.mp4\n", width, height);
+
+    int rc = 0;
+    for (int done = 0; done < opts->frames && rc == 0; )
+    {
+        int count = opts->frames - done < batch ? opts->frames - done : batch;
+
+        // Panes, layers, reveal and boxes, composed the same way as for the terminal
+        for (int i = 0; i < count; i++)
+        {
+            if (opts->update != NULL)
+                opts->update();
+            clock = due;
+            due = tickEngine(e, clock, false);
+            composeEngine(e, opts->columns, opts->rows);
+            copyFrame(&pool.frames[i], &e->frame);
+        }
+
+        rasterizeBatch(&pool, count);
+
+        for (int i = 0; i < count && rc == 0; i++)
+        {
+            TRACE_BEGIN("write");
+            if (writeImage(opts, done + i, pool.images[i], width, height) != 0)
+            {
+                fprintf(stderr, "export: writing frame %d failed\n", done + i);
+                rc = 1;
+            }
+            TRACE_END("write");
+        }
+        done += count;
+    }
+    fflush(stdout);
+
+    pthread_mutex_lock(&pool.lock);
+    pool.quit = true;
+    pthread_cond_broadcast(&pool.work);
+    pthread_mutex_unlock(&pool.lock);
+    for (int i = 0; i < threads; i++)
+        pthread_join(workers[i], NULL);
+
+    for (int i = 0; i < batch; i++)
+    {
+        freeFrame(&pool.frames[i]);
+        memFree(pool.images[i]);
+    }
+    memFree(pool.frames);
+    memFree(pool.images);
+    memFree(workers);
+    pthread_mutex_destroy(&pool.lock);
+    pthread_cond_destroy(&pool.work);
+    pthread_cond_destroy(&pool.done);
+    freeAtlas(&atlas);
+    return rc;
+}
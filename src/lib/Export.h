@@ -0,0 +1,30 @@
+#ifndef EXPORT_H
+#define EXPORT_H
+
+#include "Engine.h"
+
+enum {
+    EXPORT_PPM = 0, // one ppm file per frame
+    EXPORT_RAW      // raw rgb24 frames on stdout, for piping into an encoder
+};
+
+typedef struct {
+    int format;
+    const char *dir;  // where ppm files go
+    int columns;      // simulation size in cells
+    int rows;
+    int frames;
+    int threads;      // rasterizer workers
+    int scale;        // pixels per font pixel
+    void (*update)(void); // called before every frame (header, clock), NULL if nothing changes
+} ExportOptions;
+
+/**
+ * Run the engine at a fixed timestep (one frame per step, no clock involved) and write
+ * every frame as an RGB image. The caller sets up and starts the panes for the size,
+ * like for runStream. Sub-cells come out blank, the font has no block or braille glyphs.
+ * Returns exit code.
+ */
+int runExport(Engine *e, const ExportOptions *opts);
+
+#endif
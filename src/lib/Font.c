@@ -0,0 +1,315 @@
+#include <string.h>
+
+#include "Font.h"
+#include "Memory.h"
+#include "types/Colors.h"
+
+typedef struct {
+    int c;
+    const char *rows[FONT_HEIGHT];
+} FontGlyph;
+
+static const FontGlyph fontGlyphs[] = {
+    { '!',    { "..#..", "..#..", "..#..", "..#..", "..#..", ".....", "..#.." } },
+    { '"',    { ".#.#.", ".#.#.", ".#.#.", ".....", ".....", ".....", "....." } },
+    { '#',    { ".#.#.", ".#.#.", "#####", ".#.#.", "#####", ".#.#.", ".#.#." } },
+    { '$',    { "..#..", ".####", "#.#..", ".###.", "..#.#", "####.", "..#.." } },
+    { '%',    { "##...", "##..#", "...#.", "..#..", ".#...", "#..##", "...##" } },
+    { '&',    { ".##..", "#..#.", "#.#..", ".#...", "#.#.#", "#..#.", ".##.#" } },
+    { '\'',   { "..#..", "..#..", ".#...", ".....", ".....", ".....", "....." } },
+    { '(',    { "...#.", "..#..", ".#...", ".#...", ".#...", "..#..", "...#." } },
+    { ')',    { ".#...", "..#..", "...#.", "...#.", "...#.", "..#..", ".#..." } },
+    { '*',    { ".....", "..#..", "#.#.#", ".###.", "#.#.#", "..#..", "....." } },
+    { '+',    { ".....", "..#..", "..#..", "#####", "..#..", "..#..", "....." } },
+    { ',',    { ".....", ".....", ".....", ".....", ".##..", "..#..", ".#..." } },
+    { '-',    { ".....", ".....", ".....", "#####", ".....", ".....", "....." } },
+    { '.',    { ".....", ".....", ".....", ".....", ".....", ".##..", ".##.." } },
+    { '/',    { ".....", "....#", "...#.", "..#..", ".#...", "#....", "....." } },
+    { '0',    { ".###.", "#...#", "#..##", "#.#.#", "##..#", "#...#", ".###." } },
+    { '1',    { "..#..", ".##..", "..#..", "..#..", "..#..", "..#..", ".###." } },
+    { '2',    { ".###.", "#...#", "....#", "...#.", "..#..", ".#...", "#####" } },
+    { '3',    { "#####", "...#.", "..#..", "...#.", "....#", "#...#", ".###." } },
+    { '4',    { "...#.", "..##.", ".#.#.", "#..#.", "#####", "...#.", "...#." } },
+    { '5',    { "#####", "#....", "####.", "....#", "....#", "#...#", ".###." } },
+    { '6',    { "..##.", ".#...", "#....", "####.", "#...#", "#...#", ".###." } },
+    { '7',    { "#####", "....#", "...#.", "..#..", ".#...", ".#...", ".#..." } },
+    { '8',    { ".###.", "#...#", "#...#", ".###.", "#...#", "#...#", ".###." } },
+    { '9',    { ".###.", "#...#", "#...#", ".####", "....#", "...#.", ".##.." } },
+    { ':',    { ".....", ".##..", ".##..", ".....", ".##..", ".##..", "....." } },
+    { ';',    { ".....", ".##..", ".##..", ".....", ".##..", "..#..", ".#..." } },
+    { '<',    { "...#.", "..#..", ".#...", "#....", ".#...", "..#..", "...#." } },
+    { '=',    { ".....", ".....", "#####", ".....", "#####", ".....", "....." } },
+    { '>',    { ".#...", "..#..", "...#.", "....#", "...#.", "..#..", ".#..." } },
+    { '?',    { ".###.", "#...#", "....#", "...#.", "..#..", ".....", "..#.." } },
+    { '@',    { ".###.", "#...#", "....#", ".##.#", "#.#.#", "#.#.#", ".###." } },
+    { 'A',    { ".###.", "#...#", "#...#", "#####", "#...#", "#...#", "#...#" } },
+    { 'B',    { "####.", "#...#", "#...#", "####.", "#...#", "#...#", "####." } },
+    { 'C',    { ".###.", "#...#", "#....", "#....", "#....", "#...#", ".###." } },
+    { 'D',    { "###..", "#..#.", "#...#", "#...#", "#...#", "#..#.", "###.." } },
+    { 'E',    { "#####", "#....", "#....", "####.", "#....", "#....", "#####" } },
+    { 'F',    { "#####", "#....", "#....", "####.", "#....", "#....", "#...." } },
+    { 'G',    { ".###.", "#...#", "#....", "#.###", "#...#", "#...#", ".####" } },
+    { 'H',    { "#...#", "#...#", "#...#", "#####", "#...#", "#...#", "#...#" } },
+    { 'I',    { ".###.", "..#..", "..#..", "..#..", "..#..", "..#..", ".###." } },
+    { 'J',    { "..###", "...#.", "...#.", "...#.", "...#.", "#..#.", ".##.." } },
+    { 'K',    { "#...#", "#..#.", "#.#..", "##...", "#.#..", "#..#.", "#...#" } },
+    { 'L',    { "#....", "#....", "#....", "#....", "#....", "#....", "#####" } },
+    { 'M',    { "#...#", "##.##", "#.#.#", "#.#.#", "#...#", "#...#", "#...#" } },
+    { 'N',    { "#...#", "#...#", "##..#", "#.#.#", "#..##", "#...#", "#...#" } },
+    { 'O',    { ".###.", "#...#", "#...#", "#...#", "#...#", "#...#", ".###." } },
+    { 'P',    { "####.", "#...#", "#...#", "####.", "#....", "#....", "#...." } },
+    { 'Q',    { ".###.", "#...#", "#...#", "#...#", "#.#.#", "#..#.", ".##.#" } },
+    { 'R',    { "####.", "#...#", "#...#", "####.", "#.#..", "#..#.", "#...#" } },
+    { 'S',    { ".####", "#....", "#....", ".###.", "....#", "....#", "####." } },
+    { 'T',    { "#####", "..#..", "..#..", "..#..", "..#..", "..#..", "..#.." } },
+    { 'U',    { "#...#", "#...#", "#...#", "#...#", "#...#", "#...#", ".###." } },
+    { 'V',    { "#...#", "#...#", "#...#", "#...#", "#...#", ".#.#.", "..#.." } },
+    { 'W',    { "#...#", "#...#", "#...#", "#.#.#", "#.#.#", "#.#.#", ".#.#." } },
+    { 'X',    { "#...#", "#...#", ".#.#.", "..#..", ".#.#.", "#...#", "#...#" } },
+    { 'Y',    { "#...#", "#...#", "#...#", ".#.#.", "..#..", "..#..", "..#.." } },
+    { 'Z',    { "#####", "....#", "...#.", "..#..", ".#...", "#....", "#####" } },
+    { '[',    { ".###.", ".#...", ".#...", ".#...", ".#...", ".#...", ".###." } },
+    { '\\',   { ".....", "#....", ".#...", "..#..", "...#.", "....#", "....." } },
+    { ']',    { ".###.", "...#.", "...#.", "...#.", "...#.", "...#.", ".###." } },
+    { '^',    { "..#..", ".#.#.", "#...#", ".....", ".....", ".....", "....." } },
+    { '_',    { ".....", ".....", ".....", ".....", ".....", ".....", "#####" } },
+    { '`',    { ".#...", "..#..", "...#.", ".....", ".....", ".....", "....." } },
+    { 'a',    { ".....", ".....", ".###.", "....#", ".####", "#...#", ".####" } },
+    { 'b',    { "#....", "#....", "#.##.", "##..#", "#...#", "#...#", "####." } },
+    { 'c',    { ".....", ".....", ".###.", "#....", "#....", "#...#", ".###." } },
+    { 'd',    { "....#", "....#", ".##.#", "#..##", "#...#", "#...#", ".####" } },
+    { 'e',    { ".....", ".....", ".###.", "#...#", "#####", "#....", ".###." } },
+    { 'f',    { "..##.", ".#..#", ".#...", "###..", ".#...", ".#...", ".#..." } },
+    { 'g',    { ".....", ".####", "#...#", "#...#", ".####", "....#", ".###." } },
+    { 'h',    { "#....", "#....", "#.##.", "##..#", "#...#", "#...#", "#...#" } },
+    { 'i',    { "..#..", ".....", ".##..", "..#..", "..#..", "..#..", ".###." } },
+    { 'j',    { "...#.", ".....", "..##.", "...#.", "...#.", "#..#.", ".##.." } },
+    { 'k',    { "#....", "#....", "#..#.", "#.#..", "##...", "#.#..", "#..#." } },
+    { 'l',    { ".##..", "..#..", "..#..", "..#..", "..#..", "..#..", ".###." } },
+    { 'm',    { ".....", ".....", "##.#.", "#.#.#", "#.#.#", "#...#", "#...#" } },
+    { 'n',    { ".....", ".....", "#.##.", "##..#", "#...#", "#...#", "#...#" } },
+    { 'o',    { ".....", ".....", ".###.", "#...#", "#...#", "#...#", ".###." } },
+    { 'p',    { ".....", ".....", "####.", "#...#", "####.", "#....", "#...." } },
+    { 'q',    { ".....", ".....", ".##.#", "#..##", ".####", "....#", "....#" } },
+    { 'r',    { ".....", ".....", "#.##.", "##..#", "#....", "#....", "#...." } },
+    { 's',    { ".....", ".....", ".###.", "#....", ".###.", "....#", "####." } },
+    { 't',    { ".#...", ".#...", "###..", ".#...", ".#...", ".#..#", "..##." } },
+    { 'u',    { ".....", ".....", "#...#", "#...#", "#...#", "#..##", ".##.#" } },
+    { 'v',    { ".....", ".....", "#...#", "#...#", "#...#", ".#.#.", "..#.." } },
+    { 'w',    { ".....", ".....", "#...#", "#...#", "#.#.#", "#.#.#", ".#.#." } },
+    { 'x',    { ".....", ".....", "#...#", ".#.#.", "..#..", ".#.#.", "#...#" } },
+    { 'y',    { ".....", ".....", "#...#", "#...#", ".####", "....#", ".###." } },
+    { 'z',    { ".....", ".....", "#####", "...#.", "..#..", ".#...", "#####" } },
+    { '{',    { "...#.", "..#..", "..#..", ".#...", "..#..", "..#..", "...#." } },
+    { '|',    { "..#..", "..#..", "..#..", "..#..", "..#..", "..#..", "..#.." } },
+    { '}',    { ".#...", "..#..", "..#..", "...#.", "..#..", "..#..", ".#..." } },
+    { '~',    { ".....", ".....", ".#...", "#.#.#", "...#.", ".....", "....." } },
+    { 0xFF66, { "#####", "....#", "#####", "....#", "...#.", "..#..", ".#..." } }, // ｦ
+    { 0xFF67, { ".....", "#####", "....#", "..##.", "..#..", ".#...", "....." } }, // ｧ
+    { 0xFF68, { ".....", "....#", "...#.", "..##.", ".#.#.", "...#.", "....." } }, // ｨ
+    { 0xFF69, { ".....", "..#..", "#####", "#...#", "....#", "..##.", "....." } }, // ｩ
+    { 0xFF6A, { ".....", ".....", ".###.", "..#..", "..#..", "#####", "....." } }, // ｪ
+    { 0xFF6B, { ".....", "...#.", "#####", "..##.", ".#.#.", "#..#.", "....." } }, // ｫ
+    { 0xFF6C, { ".....", ".#...", "#####", ".#..#", ".#.#.", ".#...", "....." } }, // ｬ
+    { 0xFF6D, { ".....", ".....", ".###.", "...#.", "...#.", "#####", "....." } }, // ｭ
+    { 0xFF6E, { ".....", "####.", "...#.", "####.", "...#.", "####.", "....." } }, // ｮ
+    { 0xFF6F, { ".....", ".....", "#.#.#", "#.#.#", "....#", "..##.", "....." } }, // ｯ
+    { 0xFF70, { ".....", ".....", ".....", "#####", ".....", ".....", "....." } }, // ｰ
+    { 0xFF71, { "#####", "....#", "..#.#", "..##.", "..#..", ".#...", "#...." } }, // ｱ
+    { 0xFF72, { "....#", "...#.", "..#..", ".##..", "#.#..", "..#..", "..#.." } }, // ｲ
+    { 0xFF73, { "..#..", "#####", "#...#", "#...#", "....#", "...#.", "..#.." } }, // ｳ
+    { 0xFF74, { ".....", "#####", "..#..", "..#..", "..#..", "#####", "....." } }, // ｴ
+    { 0xFF75, { "...#.", "#####", "...#.", "..##.", ".#.#.", "#..#.", "...#." } }, // ｵ
+    { 0xFF76, { ".#...", "#####", ".#..#", ".#..#", ".#..#", ".#..#", "#..#." } }, // ｶ
+    { 0xFF77, { "..#..", "#####", "..#..", "#####", "..#..", "..#..", "..#.." } }, // ｷ
+    { 0xFF78, { ".####", ".#..#", "#...#", "....#", "...#.", "..#..", "##..." } }, // ｸ
+    { 0xFF79, { ".#...", ".####", "#..#.", "...#.", "...#.", "...#.", "..#.." } }, // ｹ
+    { 0xFF7A, { ".....", "#####", "....#", "....#", "....#", "#####", "....." } }, // ｺ
+    { 0xFF7B, { ".#.#.", "#####", ".#.#.", ".#.#.", "...#.", "..#..", ".#..." } }, // ｻ
+    { 0xFF7C, { ".....", "##...", "....#", "##..#", "....#", "...#.", "###.." } }, // ｼ
+    { 0xFF7D, { ".....", "#####", "....#", "...#.", "..#..", ".#.#.", "#...#" } }, // ｽ
+    { 0xFF7E, { ".#...", "#####", ".#..#", ".#.#.", ".#...", ".#...", "..###" } }, // ｾ
+    { 0xFF7F, { ".....", "#...#", "#...#", ".#..#", "....#", "...#.", "..#.." } }, // ｿ
+    { 0xFF80, { ".####", ".#..#", "#.#.#", "...#.", "..#.#", ".#...", "#...." } }, // ﾀ
+    { 0xFF81, { "...#.", "###..", "..#..", "#####", "..#..", "..#..", ".#..." } }, // ﾁ
+    { 0xFF82, { ".....", "#.#.#", "#.#.#", "#.#.#", "....#", "...#.", "..#.." } }, // ﾂ
+    { 0xFF83, { ".###.", ".....", "#####", "..#..", "..#..", "..#..", ".#..." } }, // ﾃ
+    { 0xFF84, { ".#...", ".#...", ".#...", ".##..", ".#.#.", ".#...", ".#..." } }, // ﾄ
+    { 0xFF85, { "..#..", "..#..", "#####", "..#..", "..#..", ".#...", "#...." } }, // ﾅ
+    { 0xFF86, { ".....", ".###.", ".....", ".....", ".....", "#####", "....." } }, // ﾆ
+    { 0xFF87, { ".....", "#####", "....#", ".#.#.", "..#..", ".#.#.", "#...." } }, // ﾇ
+    { 0xFF88, { "..#..", "#####", "...#.", "..#..", ".###.", "#.#.#", "..#.." } }, // ﾈ
+    { 0xFF89, { "...#.", "...#.", "...#.", "...#.", "..#..", ".#...", "#...." } }, // ﾉ
+    { 0xFF8A, { ".....", "..#..", "...#.", "#...#", "#...#", "#...#", "#...#" } }, // ﾊ
+    { 0xFF8B, { "#....", "#....", "#####", "#....", "#....", "#....", ".####" } }, // ﾋ
+    { 0xFF8C, { ".....", "#####", "....#", "....#", "...#.", "..#..", ".#..." } }, // ﾌ
+    { 0xFF8D, { ".....", ".#...", "#.#..", "...#.", "....#", "....#", "....." } }, // ﾍ
+    { 0xFF8E, { "..#..", "#####", "..#..", "#.#.#", "#.#.#", "..#..", "..#.." } }, // ﾎ
+    { 0xFF8F, { ".....", "#####", "....#", "....#", ".#.#.", "..#..", "...#." } }, // ﾏ
+    { 0xFF90, { ".###.", ".....", ".###.", ".....", ".###.", "....#", "....." } }, // ﾐ
+    { 0xFF91, { ".....", "..#..", ".#...", "#....", "#...#", "#####", "....#" } }, // ﾑ
+    { 0xFF92, { ".....", "....#", "....#", ".#.#.", "..#..", ".#.#.", "#...." } }, // ﾒ
+    { 0xFF93, { ".....", "#####", ".#...", "#####", ".#...", ".#...", "..###" } }, // ﾓ
+    { 0xFF94, { ".#...", ".#...", "#####", ".#..#", ".#.#.", ".#...", ".#..." } }, // ﾔ
+    { 0xFF95, { ".....", ".###.", "...#.", "...#.", "...#.", "#####", "....." } }, // ﾕ
+    { 0xFF96, { ".....", "#####", "....#", "#####", "....#", "#####", "....." } }, // ﾖ
+    { 0xFF97, { ".###.", ".....", "#####", "....#", "....#", "...#.", "..#.." } }, // ﾗ
+    { 0xFF98, { "#..#.", "#..#.", "#..#.", "#..#.", "...#.", "..#..", ".#..." } }, // ﾘ
+    { 0xFF99, { ".....", "..#..", "#.#..", "#.#..", "#.#.#", "#.#.#", "#.##." } }, // ﾙ
+    { 0xFF9A, { ".....", "#....", "#....", "#...#", "#..#.", "#.#..", "##..." } }, // ﾚ
+    { 0xFF9B, { ".....", "#####", "#...#", "#...#", "#...#", "#####", "....." } }, // ﾛ
+    { 0xFF9C, { ".....", "#####", "#...#", "....#", "...#.", "..#..", ".#..." } }, // ﾜ
+    { 0xFF9D, { ".....", "##...", "....#", "....#", "...#.", "..#..", "##..." } }, // ﾝ
+};
+
+#define NUM_FONT_GLYPHS (int)(sizeof(fontGlyphs) / sizeof(fontGlyphs[0]))
+
+
+static const int styleColors[NUM_STYLES] = {
+    RGB_COLOR_BLUE,      // STYLE_EMPTY, only used for the debug dot
+    RGB_COLOR_MAIN_FONT, // STYLE_TAIL
+    RGB_COLOR_DROP,      // STYLE_DROP
+    RGB_COLOR_MID_FONT,  // STYLE_TAIL_MID
+    RGB_COLOR_MID_DROP,  // STYLE_DROP_MID
+    RGB_COLOR_FAR_FONT,  // STYLE_TAIL_FAR
+    RGB_COLOR_FAR_DROP,  // STYLE_DROP_FAR
+    RGB_COLOR_REVEAL,    // STYLE_REVEAL
+    RGB_COLOR_OVERLAY    // STYLE_OVERLAY
+};
+
+static int tileIndex(const GlyphAtlas *atlas, int c)
+{
+    if (c >= 0 && c < 128)
+        return atlas->asciiTiles[c];
+    if (c >= FONT_KANA_FIRST && c < FONT_KANA_FIRST + FONT_KANA_COUNT)
+        return atlas->kanaTiles[c - FONT_KANA_FIRST];
+    return 0;
+}
+
+static unsigned char* tileAt(const GlyphAtlas *atlas, int tile, int style)
+{
+    size_t tileBytes = (size_t)atlas->tileWidth * atlas->tileHeight * 3;
+    return atlas->tiles + ((size_t)tile * NUM_STYLES + style) * tileBytes;
+}
+
+static void fillTile(const GlyphAtlas *atlas, unsigned char *tile, const FontGlyph *glyph, int color)
+{
+    unsigned char r = (color >> 16) & 0xFF;
+    unsigned char g = (color >> 8) & 0xFF;
+    unsigned char b = color & 0xFF;
+    int s = atlas->scale;
+
+    // Background first, then glyph pixels, one row above the glyph is the gap
+    memset(tile, 0, (size_t)atlas->tileWidth * atlas->tileHeight * 3);
+    if (glyph == NULL)
+        return;
+
+    for (int y = atlas->offsetY; y < atlas->tileHeight; y++)
+    {
+        int gy = (y - atlas->offsetY) / s - 1;
+        if (gy < 0 || gy >= FONT_HEIGHT)
+            continue;
+
+        for (int x = atlas->offsetX; x < atlas->tileWidth; x++)
+        {
+            int gx = (x - atlas->offsetX) / s;
+            if (gx >= FONT_WIDTH || glyph->rows[gy][gx] != '#')
+                continue;
+
+            unsigned char *p = tile + ((size_t)y * atlas->tileWidth + x) * 3;
+            p[0] = r;
+            p[1] = g;
+            p[2] = b;
+        }
+    }
+}
+
+const char* const* fontRows(int c)
+{
+    for (int i = 0; i < NUM_FONT_GLYPHS; i++)
+    {
+        if (fontGlyphs[i].c == c)
+            return fontGlyphs[i].rows;
+    }
+    return NULL;
+}
+
+void buildAtlas(GlyphAtlas *atlas, int scale)
+{
+    if (scale < 1) scale = 1;
+    buildAtlasSized(atlas, FONT_CELL_WIDTH * scale, FONT_CELL_HEIGHT * scale);
+}
+
+void buildAtlasSized(GlyphAtlas *atlas, int tileWidth, int tileHeight)
+{
+    int scale = tileWidth / FONT_CELL_WIDTH < tileHeight / FONT_CELL_HEIGHT
+        ? tileWidth / FONT_CELL_WIDTH : tileHeight / FONT_CELL_HEIGHT;
+    if (scale < 1) scale = 1;
+    if (tileWidth < FONT_CELL_WIDTH * scale) tileWidth = FONT_CELL_WIDTH * scale;
+    if (tileHeight < FONT_CELL_HEIGHT * scale) tileHeight = FONT_CELL_HEIGHT * scale;
+
+    atlas->scale = scale;
+    atlas->tileWidth = tileWidth;
+    atlas->tileHeight = tileHeight;
+    atlas->offsetX = (tileWidth - FONT_CELL_WIDTH * scale) / 2;
+    atlas->offsetY = (tileHeight - FONT_CELL_HEIGHT * scale) / 2;
+    atlas->numGlyphs = NUM_FONT_GLYPHS + 1;
+
+    size_t tileBytes = (size_t)atlas->tileWidth * atlas->tileHeight * 3;
+    atlas->tiles = (unsigned char *)memAlloc(tileBytes * atlas->numGlyphs * NUM_STYLES);
+
+    memset(atlas->asciiTiles, 0, sizeof(atlas->asciiTiles));
+    memset(atlas->kanaTiles, 0, sizeof(atlas->kanaTiles));
+
+    for (int style = 0; style < NUM_STYLES; style++)
+        fillTile(atlas, tileAt(atlas, 0, style), NULL, 0);
+
+    for (int i = 0; i < NUM_FONT_GLYPHS; i++)
+    {
+        int c = fontGlyphs[i].c;
+        if (c < 128)
+            atlas->asciiTiles[c] = i + 1;
+        else if (c >= FONT_KANA_FIRST && c < FONT_KANA_FIRST + FONT_KANA_COUNT)
+            atlas->kanaTiles[c - FONT_KANA_FIRST] = i + 1;
+
+        for (int style = 0; style < NUM_STYLES; style++)
+            fillTile(atlas, tileAt(atlas, i + 1, style), &fontGlyphs[i], styleColors[style]);
+    }
+}
+
+void freeAtlas(GlyphAtlas *atlas)
+{
+    memFree(atlas->tiles);
+    atlas->tiles = NULL;
+}
+
+const unsigned char* atlasTile(const GlyphAtlas *atlas, int c, int style)
+{
+    if (style < 0 || style >= NUM_STYLES)
+        style = STYLE_EMPTY;
+    return tileAt(atlas, tileIndex(atlas, c), style);
+}
+
+void rasterizeFrame(const GlyphAtlas *atlas, const Frame *frame, unsigned char *rgb)
+{
+    size_t tileRow = (size_t)atlas->tileWidth * 3;
+    size_t imageRow = tileRow * frame->width;
+
+    for (int y = 0; y < frame->height; y++)
+    {
+        unsigned char *line = rgb + (size_t)y * atlas->tileHeight * imageRow;
+
+        for (int x = 0; x < frame->width; x++)
+        {
+            const Cell *cell = frameCell(frame, x, y);
+            const unsigned char *tile = atlasTile(atlas, cell->c, cell->style);
+            unsigned char *dst = line + x * tileRow;
+
+            // Whole tile rows at once, memcpy does the wide copies for us
+            for (int ty = 0; ty < atlas->tileHeight; ty++)
+            {
+                memcpy(dst + ty * imageRow, tile + ty * tileRow, tileRow);
+            }
+        }
+    }
+}
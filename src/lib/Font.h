@@ -0,0 +1,51 @@
+#ifndef FONT_H
+#define FONT_H
+
+#include "Frame.h"
+
+// Embedded 5x7 bitmap font, latin and halfwidth katakana
+#define FONT_WIDTH 5
+#define FONT_HEIGHT 7
+
+// Glyph with one column gap on the right and a line above and below
+#define FONT_CELL_WIDTH 6
+#define FONT_CELL_HEIGHT 9
+
+// Only ascii and the halfwidth forms block are in the font
+#define FONT_KANA_FIRST 0xFF60
+#define FONT_KANA_COUNT 0x40
+
+/**
+ * Every glyph of the font pre-rendered as RGB tile in every cell style,
+ * so drawing a cell is only copying rows of a tile.
+ * Tile 0 is blank, used for spaces and glyphs the font doesn't have.
+ */
+typedef struct {
+    int scale;
+    int tileWidth;  // pixels
+    int tileHeight;
+    int offsetX;    // where the scaled font cell sits inside the tile
+    int offsetY;
+    int numGlyphs;
+    unsigned char *tiles;
+    // Code point to tile, every atlas has its own so building one never disturbs another in use
+    int asciiTiles[128];
+    int kanaTiles[FONT_KANA_COUNT];
+} GlyphAtlas;
+
+// Rows of the glyph, '#' is a pixel, NULL if the font doesn't have it
+const char* const* fontRows(int c);
+
+void buildAtlas(GlyphAtlas *atlas, int scale);
+
+// Tiles of exactly the given size (e.g. terminal cell in pixels), font scaled to fit and centered
+void buildAtlasSized(GlyphAtlas *atlas, int tileWidth, int tileHeight);
+
+void freeAtlas(GlyphAtlas *atlas);
+
+const unsigned char* atlasTile(const GlyphAtlas *atlas, int c, int style);
+
+// Draw frame into rgb, which must hold width*tileWidth x height*tileHeight pixels
+void rasterizeFrame(const GlyphAtlas *atlas, const Frame *frame, unsigned char *rgb);
+
+#endif
@@ -0,0 +1,270 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "Frame.h"
+#include "Memory.h"
+#include "Viewport.h"
+
+void resizeFrame(Frame *frame, int width, int height)
+{
+    if (width < 0) width = 0;
+    if (height < 0) height = 0;
+
+    if (frame->cells != NULL && frame->width == width && frame->height == height)
+        return;
+
+    memFree(frame->cells);
+    frame->cells = NULL;
+    frame->width = width;
+    frame->height = height;
+    frame->cells = (Cell *)memCalloc((size_t)width * height + 1, sizeof(Cell));
+}
+
+void clearFrame(Frame *frame)
+{
+    int n = frame->width * frame->height;
+    for (int i = 0; i < n; i++)
+    {
+        frame->cells[i].c = ' ';
+        frame->cells[i].style = STYLE_EMPTY;
+        frame->cells[i].bg = STYLE_EMPTY;
+    }
+}
+
+void freeFrame(Frame *frame)
+{
+    memFree(frame->cells);
+    frame->cells = NULL;
+    frame->width = 0;
+    frame->height = 0;
+}
+
+void copyFrame(Frame *dst, const Frame *src)
+{
+    resizeFrame(dst, src->width, src->height);
+    memcpy(dst->cells, src->cells, (size_t)src->width * src->height * sizeof(Cell));
+}
+
+// Visible part of the pane, clipped to the frame
+static void paneBounds(const Frame *frame, const Viewport *vp, int *width, int *depth)
+{
+    *width = vp->columns;
+    *depth = vp->rows - vp->paddingBottom;
+
+    if (vp->paddingLeft + *width > frame->width)
+        *width = frame->width - vp->paddingLeft;
+    if (vp->paddingTop + *depth > frame->height)
+        *depth = frame->height - vp->paddingTop;
+}
+
+void composeViewport(Frame *frame, const Viewport *vp)
+{
+    int width, depth;
+    paneBounds(frame, vp, &width, &depth);
+    if (width <= 0 || depth <= 0)
+        return;
+
+    // Where tails overlap the first drop (and its first segment) wins,
+    // so go backwards and let the earlier ones overwrite the later ones
+    for (int i = vp->numDrops - 1; i >= 0; i--)
+    {
+        const TailSegment *tail = &vp->tailSegments[i];
+
+        for (int j = vp->drops[i].length - 1; j >= 0; j--)
+        {
+            int x = tail->x[j];
+            int y = tail->y[j];
+            if (x < 0 || y < 0 || x >= width || y >= depth)
+                continue;
+
+            Cell *cell = frameCell(frame, vp->paddingLeft + x, vp->paddingTop + y);
+            cell->c = tail->c[j];
+            cell->style = STYLE_TAIL;
+        }
+    }
+
+    // Heads are always on top
+    for (int i = vp->numDrops - 1; i >= 0; i--)
+    {
+        int x = vp->drops[i].x;
+        int y = vp->drops[i].y;
+        if (x < 0 || y < 0 || x >= width || y >= depth)
+            continue;
+
+        Cell *cell = frameCell(frame, vp->paddingLeft + x, vp->paddingTop + y);
+        cell->c = vp->drops[i].c;
+        cell->style = STYLE_DROP;
+    }
+}
+
+// Return index of the first drop with the head at given x,y position, otherwise -1
+static int findDrop(const Viewport *vp, int x, int y)
+{
+    for (int i = 0; i < vp->numDrops; i++)
+    {
+        if (x == vp->drops[i].x && y == vp->drops[i].y)
+            return i;
+    }
+    return -1;
+}
+
+void composeViewportScan(Frame *frame, const Viewport *vp)
+{
+    int width, depth;
+    paneBounds(frame, vp, &width, &depth);
+
+    for (int y = 0; y < depth; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            Cell *cell = frameCell(frame, vp->paddingLeft + x, vp->paddingTop + y);
+
+            // 1. Check if the screen cell contains drop or tail
+            int drop = findDrop(vp, x, y);
+            int tailChar = checkTail(vp, x, y);
+
+            // 2. Put appropriate element
+            if (drop >= 0)
+            {
+                cell->c = vp->drops[drop].c;
+                cell->style = STYLE_DROP;
+            }
+            else if (tailChar >= 0)
+            {
+                cell->c = tailChar;
+                cell->style = STYLE_TAIL;
+            }
+        }
+    }
+}
+
+int parseSubcells(const char *name)
+{
+    if (strcmp(name, "off") == 0) return SUBCELLS_OFF;
+    if (strcmp(name, "half") == 0) return SUBCELLS_HALF;
+    if (strcmp(name, "braille") == 0) return SUBCELLS_BRAILLE;
+    return -1;
+}
+
+void subcellScale(int mode, int *sx, int *sy)
+{
+    *sx = mode == SUBCELLS_BRAILLE ? 2 : 1;
+    *sy = mode == SUBCELLS_BRAILLE ? 4 : mode == SUBCELLS_HALF ? 2 : 1;
+}
+
+#define HALF_UPPER 0x2580 // ▀
+#define HALF_LOWER 0x2584 // ▄
+#define HALF_FULL  0x2588 // █
+#define BRAILLE_BLANK 0x2800
+
+// Which style wins when several sub-cells share one braille cell, heads before tails, near before far
+static const unsigned char stylePriority[NUM_STYLES] = {
+    [STYLE_EMPTY] = 0,
+    [STYLE_TAIL_FAR] = 1,
+    [STYLE_DROP_FAR] = 2,
+    [STYLE_TAIL_MID] = 3,
+    [STYLE_DROP_MID] = 4,
+    [STYLE_TAIL] = 5,
+    [STYLE_DROP] = 6,
+    [STYLE_REVEAL] = 7,
+    [STYLE_OVERLAY] = 8,
+};
+
+// Braille dot of sub-cell x,y, dots 1-3 and 4-6 go down the columns, 7 and 8 are the bottom row
+static const unsigned char brailleDot[4][2] = {
+    { 0x01, 0x08 },
+    { 0x02, 0x10 },
+    { 0x04, 0x20 },
+    { 0x40, 0x80 },
+};
+
+// Every pair of upper and lower style as one cell, built on first use
+static Cell halfCells[NUM_STYLES][NUM_STYLES];
+static bool halfCellsReady = false;
+
+static void buildHalfCells()
+{
+    for (int top = 0; top < NUM_STYLES; top++)
+    {
+        for (int bottom = 0; bottom < NUM_STYLES; bottom++)
+        {
+            Cell *cell = &halfCells[top][bottom];
+
+            if (top == STYLE_EMPTY && bottom == STYLE_EMPTY)
+                *cell = (Cell){ ' ', STYLE_EMPTY, STYLE_EMPTY };
+            else if (bottom == STYLE_EMPTY)
+                *cell = (Cell){ HALF_UPPER, top, STYLE_EMPTY };
+            else if (top == STYLE_EMPTY)
+                *cell = (Cell){ HALF_LOWER, bottom, STYLE_EMPTY };
+            else if (top == bottom)
+                *cell = (Cell){ HALF_FULL, top, STYLE_EMPTY };
+            else
+                *cell = (Cell){ HALF_UPPER, top, bottom };
+        }
+    }
+    halfCellsReady = true;
+}
+
+static unsigned char validStyle(unsigned char style)
+{
+    return style < NUM_STYLES ? style : STYLE_EMPTY;
+}
+
+static void packHalf(Frame *frame, const Frame *fine)
+{
+    if (!halfCellsReady)
+        buildHalfCells();
+
+    for (int y = 0; y < frame->height; y++)
+    {
+        const Cell *upper = frameCell(fine, 0, 2 * y);
+        const Cell *lower = frameCell(fine, 0, 2 * y + 1);
+        Cell *out = frameCell(frame, 0, y);
+
+        for (int x = 0; x < frame->width; x++)
+        {
+            out[x] = halfCells[validStyle(upper[x].style)][validStyle(lower[x].style)];
+        }
+    }
+}
+
+static void packBraille(Frame *frame, const Frame *fine)
+{
+    for (int y = 0; y < frame->height; y++)
+    {
+        Cell *out = frameCell(frame, 0, y);
+
+        // Dots are collected in the cells themselves, going along the fine rows in memory order
+        for (int x = 0; x < frame->width; x++)
+            out[x] = (Cell){ 0, STYLE_EMPTY, STYLE_EMPTY };
+
+        for (int dy = 0; dy < 4; dy++)
+        {
+            const Cell *sub = frameCell(fine, 0, 4 * y + dy);
+            for (int fx = 0; fx < 2 * frame->width; fx++)
+            {
+                unsigned char s = validStyle(sub[fx].style);
+                if (s == STYLE_EMPTY)
+                    continue;
+
+                Cell *cell = &out[fx >> 1];
+                cell->c |= brailleDot[dy][fx & 1];
+                if (stylePriority[s] > stylePriority[cell->style])
+                    cell->style = s;
+            }
+        }
+
+        for (int x = 0; x < frame->width; x++)
+            out[x].c = out[x].c ? BRAILLE_BLANK + out[x].c : ' ';
+    }
+}
+
+void packSubcells(Frame *frame, const Frame *fine, int mode)
+{
+    if (mode == SUBCELLS_HALF)
+        packHalf(frame, fine);
+    else if (mode == SUBCELLS_BRAILLE)
+        packBraille(frame, fine);
+    else
+        copyFrame(frame, fine);
+}
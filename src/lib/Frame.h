@@ -0,0 +1,53 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include "types/Cell.h"
+#include "types/Viewport.h"
+
+// Cell grid of the whole terminal, all panes are composed into it
+typedef struct {
+    int width;
+    int height;
+    Cell *cells;
+} Frame;
+
+// Resize the grid if needed, content is undefined afterwards
+void resizeFrame(Frame *frame, int width, int height);
+
+void clearFrame(Frame *frame);
+
+void freeFrame(Frame *frame);
+
+// Make dst the same size and content as src
+void copyFrame(Frame *dst, const Frame *src);
+
+// Draw pane's drops and tails into the frame at the pane's padding offset
+void composeViewport(Frame *frame, const Viewport *vp);
+
+// Same result as composeViewport, but every cell scans all drops (how printContent used to work).
+// Very slow, kept as reference
+void composeViewportScan(Frame *frame, const Viewport *vp);
+
+// Simulation finer than the terminal: every cell shows several sub-cells of a finer frame
+enum {
+    SUBCELLS_OFF = 0,
+    SUBCELLS_HALF,    // 1x2, upper half block with the lower sub-cell as background
+    SUBCELLS_BRAILLE, // 2x4, braille dots in the color of the brightest one
+    NUM_SUBCELLS
+};
+
+// SUBCELLS_* by name ("off", "half", "braille"), -1 if unknown
+int parseSubcells(const char *name);
+
+// Sub-cells per terminal cell across and down
+void subcellScale(int mode, int *sx, int *sy);
+
+// Pack fine (sub-cells) into frame, which has to be fine's size divided by the scale
+void packSubcells(Frame *frame, const Frame *fine, int mode);
+
+static inline Cell* frameCell(const Frame *frame, int x, int y)
+{
+    return &frame->cells[y * frame->width + x];
+}
+
+#endif
@@ -0,0 +1,62 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "Glyphs.h"
+
+// Full latin alfabet is going from 33(!) to 126
+#define LATIN_FIRST 33
+#define LATIN_LAST 126
+
+#define ALPHA_FIRST 'A'
+#define ALPHA_LAST 'Z'
+
+// Halfwidth katakana, these are the ones that look like the movie
+#define KATAKANA_FIRST 0xFF66
+#define KATAKANA_LAST 0xFF9D
+
+static int latin[LATIN_LAST - LATIN_FIRST + 1];
+static int alpha[ALPHA_LAST - ALPHA_FIRST + 1];
+static int katakana[KATAKANA_LAST - KATAKANA_FIRST + 1];
+
+static GlyphSet glyphSets[] = {
+    { "latin", latin, LATIN_LAST - LATIN_FIRST + 1 },
+    { "alpha", alpha, ALPHA_LAST - ALPHA_FIRST + 1 },
+    { "katakana", katakana, KATAKANA_LAST - KATAKANA_FIRST + 1 },
+};
+
+#define NUM_GLYPH_SETS (int)(sizeof(glyphSets) / sizeof(glyphSets[0]))
+
+static void fillRange(int *table, int first, int last)
+{
+    for (int c = first; c <= last; c++)
+    {
+        table[c - first] = c;
+    }
+}
+
+void initGlyphSets()
+{
+    fillRange(latin, LATIN_FIRST, LATIN_LAST);
+    fillRange(alpha, ALPHA_FIRST, ALPHA_LAST);
+    fillRange(katakana, KATAKANA_FIRST, KATAKANA_LAST);
+}
+
+const GlyphSet* findGlyphSet(const char *name)
+{
+    for (int i = 0; i < NUM_GLYPH_SETS; i++)
+    {
+        if (strcmp(glyphSets[i].name, name) == 0)
+            return &glyphSets[i];
+    }
+    return NULL;
+}
+
+const GlyphSet* defaultGlyphSet()
+{
+    return &glyphSets[0];
+}
+
+int getRandomGlyph(const GlyphSet *glyphs)
+{
+    return glyphs->glyphs[random() % glyphs->count];
+}
@@ -0,0 +1,16 @@
+#ifndef GLYPHS_H
+#define GLYPHS_H
+
+#include "types/GlyphSet.h"
+
+// Build the shared glyph tables, must be called once before any pane is created
+void initGlyphSets();
+
+// Find glyph set by name ("latin", "alpha", "katakana"), NULL if unknown
+const GlyphSet* findGlyphSet(const char *name);
+
+const GlyphSet* defaultGlyphSet();
+
+int getRandomGlyph(const GlyphSet *glyphs);
+
+#endif
@@ -0,0 +1,434 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Graphics.h"
+#include "Memory.h"
+#include "Sink.h"
+#include "Trace.h"
+#include "types/Escapes.h"
+
+#define KITTY_CHUNK 3072 // raw bytes per chunk, 4096 in base64 is the protocol limit
+
+static const char base64Chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+int parseGraphics(const char *name)
+{
+    if (strcmp(name, "sixel") == 0)
+        return GRAPHICS_SIXEL;
+    if (strcmp(name, "kitty") == 0)
+        return GRAPHICS_KITTY;
+    if (strcmp(name, "off") == 0 || strcmp(name, "none") == 0)
+        return GRAPHICS_NONE;
+    return -1;
+}
+
+const char* graphicsName(int protocol)
+{
+    switch (protocol)
+    {
+        case GRAPHICS_SIXEL: return "sixel";
+        case GRAPHICS_KITTY: return "kitty";
+        default: return "off";
+    }
+}
+
+static inline int pixelColor(const unsigned char *p)
+{
+    return p[0] << 16 | p[1] << 8 | p[2];
+}
+
+// Every color of the atlas gets a sixel register, black (the background) is 0
+static void collectPalette(GraphicsOutput *g)
+{
+    const GlyphAtlas *a = &g->atlas;
+    size_t pixels = (size_t)a->tileWidth * a->tileHeight * a->numGlyphs * NUM_STYLES;
+
+    g->colors[0] = 0;
+    g->numColors = 1;
+    for (size_t i = 0; i < pixels; i++)
+    {
+        int color = pixelColor(a->tiles + i * 3);
+        int k = 0;
+        while (k < g->numColors && g->colors[k] != color)
+            k++;
+        if (k == g->numColors && g->numColors < GRAPHICS_MAX_COLORS)
+            g->colors[g->numColors++] = color;
+    }
+}
+
+static int paletteIndex(const GraphicsOutput *g, int color)
+{
+    for (int k = 0; k < g->numColors; k++)
+    {
+        if (g->colors[k] == color)
+            return k;
+    }
+    return 0;
+}
+
+// Draw the block's cells from the atlas
+static void rasterizeBlock(const GraphicsOutput *g, const Frame *frame, const GraphicsJob *job, unsigned char *rgb)
+{
+    const GlyphAtlas *a = &g->atlas;
+    size_t tileRow = (size_t)a->tileWidth * 3;
+    size_t imageRow = tileRow * job->width;
+
+    for (int cy = 0; cy < job->height; cy++)
+    {
+        for (int cx = 0; cx < job->width; cx++)
+        {
+            const Cell *cell = frameCell(frame, job->x + cx, job->y + cy);
+            const unsigned char *tile = atlasTile(a, cell->c, cell->style);
+            unsigned char *dst = rgb + (size_t)cy * a->tileHeight * imageRow + cx * tileRow;
+
+            for (int ty = 0; ty < a->tileHeight; ty++)
+            {
+                memcpy(dst + ty * imageRow, tile + ty * tileRow, tileRow);
+            }
+        }
+    }
+}
+
+static void putBase64(OutBuf *ob, const unsigned char *p, size_t n)
+{
+    obReserve(ob, (n + 2) / 3 * 4);
+    char *out = ob->data + ob->len;
+
+    size_t i = 0;
+    for (; i + 2 < n; i += 3)
+    {
+        unsigned int v = p[i] << 16 | p[i + 1] << 8 | p[i + 2];
+        *out++ = base64Chars[v >> 18];
+        *out++ = base64Chars[(v >> 12) & 63];
+        *out++ = base64Chars[(v >> 6) & 63];
+        *out++ = base64Chars[v & 63];
+    }
+    if (i < n)
+    {
+        unsigned int v = p[i] << 16 | (i + 1 < n ? p[i + 1] << 8 : 0);
+        *out++ = base64Chars[v >> 18];
+        *out++ = base64Chars[(v >> 12) & 63];
+        *out++ = i + 1 < n ? base64Chars[(v >> 6) & 63] : '=';
+        *out++ = '=';
+    }
+    ob->len = out - ob->data;
+}
+
+// Same image id and placement id replace what the block showed before, cursor stays (C=1)
+static void encodeKitty(GraphicsJob *job, const unsigned char *rgb, int width, int height)
+{
+    size_t size = (size_t)width * height * 3;
+
+    for (size_t off = 0; off < size; off += KITTY_CHUNK)
+    {
+        size_t len = size - off < KITTY_CHUNK ? size - off : KITTY_CHUNK;
+        int more = off + len < size;
+
+        if (off == 0)
+            obPrintf(&job->data, ESC_KITTY_BEGIN "a=T,f=24,s=%d,v=%d,i=%d,p=1,C=1,q=2,m=%d;",
+                width, height, job->id, more);
+        else
+            obPrintf(&job->data, ESC_KITTY_BEGIN "m=%d;", more);
+        putBase64(&job->data, rgb + off, len);
+        obPuts(&job->data, ESC_STRING_END);
+    }
+}
+
+static void putSixelRun(OutBuf *ob, char c, int n)
+{
+    if (n > 3)
+        obPrintf(ob, "!%d%c", n, c);
+    else
+        while (n-- > 0) obPutc(ob, c);
+}
+
+static void encodeSixel(const GraphicsOutput *g, GraphicsJob *job, const unsigned char *rgb, unsigned char *index,
+    int width, int height)
+{
+    OutBuf *ob = &job->data;
+    unsigned int used = 0;
+
+    // Pixels to registers, neighbours mostly have the same color
+    int lastColor = -1, lastIndex = 0;
+    for (int i = 0; i < width * height; i++)
+    {
+        int color = pixelColor(rgb + (size_t)i * 3);
+        if (color != lastColor)
+        {
+            lastColor = color;
+            lastIndex = paletteIndex(g, color);
+        }
+        index[i] = (unsigned char)lastIndex;
+        used |= 1u << lastIndex;
+    }
+
+    obPuts(ob, ESC_SIXEL_BEGIN);
+    obPrintf(ob, "\"1;1;%d;%d", width, height);
+    for (int k = 0; k < g->numColors; k++)
+    {
+        if (!(used & (1u << k)))
+            continue;
+        int c = g->colors[k];
+        obPrintf(ob, "#%d;2;%d;%d;%d", k,
+            (((c >> 16) & 0xFF) * 100 + 127) / 255, (((c >> 8) & 0xFF) * 100 + 127) / 255, ((c & 0xFF) * 100 + 127) / 255);
+    }
+
+    // Six pixel rows per band, one pass per color in the band
+    for (int y0 = 0; y0 < height; y0 += 6)
+    {
+        int rows = height - y0 < 6 ? height - y0 : 6;
+        unsigned int bandUsed = 0;
+        for (int i = y0 * width; i < (y0 + rows) * width; i++)
+        {
+            bandUsed |= 1u << index[i];
+        }
+
+        bool first = true;
+        for (int k = 0; k < g->numColors; k++)
+        {
+            if (!(bandUsed & (1u << k)))
+                continue;
+            if (!first)
+                obPutc(ob, '$');
+            first = false;
+            obPrintf(ob, "#%d", k);
+
+            char run = 0;
+            int count = 0;
+            for (int x = 0; x < width; x++)
+            {
+                int bits = 0;
+                for (int r = 0; r < rows; r++)
+                {
+                    if (index[(y0 + r) * width + x] == k)
+                        bits |= 1 << r;
+                }
+                char c = (char)(63 + bits);
+                if (c == run)
+                {
+                    count++;
+                    continue;
+                }
+                putSixelRun(ob, run, count);
+                run = c;
+                count = 1;
+            }
+            // Trailing empty columns don't have to be sent
+            if (run != 63)
+                putSixelRun(ob, run, count);
+        }
+        if (y0 + 6 < height)
+            obPutc(ob, '-');
+    }
+    obPuts(ob, ESC_STRING_END);
+}
+
+static void runJob(GraphicsOutput *g, const Frame *frame, GraphicsJob *job, unsigned char *scratch)
+{
+    int width = job->width * g->atlas.tileWidth;
+    int height = job->height * g->atlas.tileHeight;
+    unsigned char *rgb = scratch;
+
+    TRACE_BEGIN("rasterize");
+    rasterizeBlock(g, frame, job, rgb);
+    obReset(&job->data);
+    if (g->protocol == GRAPHICS_KITTY)
+        encodeKitty(job, rgb, width, height);
+    else
+        encodeSixel(g, job, rgb, rgb + (size_t)width * height * 3, width, height);
+    TRACE_END("rasterize");
+}
+
+// Frame being encoded, workers only read it
+static const Frame *workFrame;
+
+static void* graphicsWorker(void *arg)
+{
+    GraphicsOutput *g = (GraphicsOutput *)arg;
+
+    pthread_mutex_lock(&g->lock);
+    int worker = g->finished++; // slot of this worker's scratch buffer
+    pthread_cond_signal(&g->done);
+    pthread_mutex_unlock(&g->lock);
+    traceThread("graphics");
+
+    pthread_mutex_lock(&g->lock);
+    while (1)
+    {
+        while (!g->quit && g->next >= g->count)
+            pthread_cond_wait(&g->work, &g->lock);
+        if (g->quit)
+            break;
+
+        int i = g->next++;
+        pthread_mutex_unlock(&g->lock);
+
+        runJob(g, workFrame, &g->jobs[i], g->scratch[worker]);
+
+        pthread_mutex_lock(&g->lock);
+        if (++g->finished == g->count)
+            pthread_cond_signal(&g->done);
+    }
+    pthread_mutex_unlock(&g->lock);
+    return NULL;
+}
+
+void initGraphics(GraphicsOutput *g, int protocol, int cellWidth, int cellHeight, int threads)
+{
+    memset(g, 0, sizeof(*g));
+    g->protocol = protocol;
+    g->threads = threads > 1 ? threads : 1;
+
+    buildAtlasSized(&g->atlas, cellWidth, cellHeight);
+    collectPalette(g);
+
+    // Block pixels in rgb plus one byte per pixel for sixel registers
+    size_t scratchSize = (size_t)GRAPHICS_BLOCK_WIDTH * g->atlas.tileWidth
+        * GRAPHICS_BLOCK_HEIGHT * g->atlas.tileHeight * 4;
+    g->scratch = (unsigned char **)memCalloc(g->threads, sizeof(unsigned char *));
+    for (int i = 0; i < g->threads; i++)
+    {
+        g->scratch[i] = (unsigned char *)memAlloc(scratchSize);
+    }
+
+    if (g->threads < 2)
+        return;
+
+    pthread_mutex_init(&g->lock, NULL);
+    pthread_cond_init(&g->work, NULL);
+    pthread_cond_init(&g->done, NULL);
+    g->workers = (pthread_t *)memCalloc(g->threads, sizeof(pthread_t));
+
+    // Wait until every worker took its scratch slot, then the counter is free for jobs
+    pthread_mutex_lock(&g->lock);
+    for (int i = 0; i < g->threads; i++)
+    {
+        pthread_create(&g->workers[i], NULL, graphicsWorker, g);
+    }
+    while (g->finished < g->threads)
+        pthread_cond_wait(&g->done, &g->lock);
+    g->finished = 0;
+    pthread_mutex_unlock(&g->lock);
+}
+
+void freeGraphics(GraphicsOutput *g)
+{
+    if (g->workers != NULL)
+    {
+        pthread_mutex_lock(&g->lock);
+        g->quit = true;
+        pthread_cond_broadcast(&g->work);
+        pthread_mutex_unlock(&g->lock);
+        for (int i = 0; i < g->threads; i++)
+        {
+            pthread_join(g->workers[i], NULL);
+        }
+        memFree(g->workers);
+        pthread_mutex_destroy(&g->lock);
+        pthread_cond_destroy(&g->work);
+        pthread_cond_destroy(&g->done);
+    }
+
+    for (int i = 0; i < g->threads; i++)
+    {
+        memFree(g->scratch[i]);
+    }
+    memFree(g->scratch);
+    for (int i = 0; i < g->capJobs; i++)
+    {
+        obFree(&g->jobs[i].data);
+    }
+    memFree(g->jobs);
+    freeAtlas(&g->atlas);
+    memset(g, 0, sizeof(*g));
+}
+
+static bool blockChanged(const Frame *frame, const Frame *shown, int x0, int y0, int width, int height)
+{
+    for (int y = y0; y < y0 + height; y++)
+    {
+        const Cell *a = frameCell(frame, x0, y);
+        const Cell *b = frameCell(shown, x0, y);
+        for (int x = 0; x < width; x++)
+        {
+            if (a[x].c != b[x].c || a[x].style != b[x].style)
+                return true;
+        }
+    }
+    return false;
+}
+
+static void addJob(GraphicsOutput *g, int x, int y, int width, int height, int id)
+{
+    if (g->numJobs == g->capJobs)
+    {
+        int cap = g->capJobs ? g->capJobs * 2 : 64;
+        g->jobs = (GraphicsJob *)memRealloc(g->jobs, (size_t)cap * sizeof(GraphicsJob));
+        memset(g->jobs + g->capJobs, 0, (size_t)(cap - g->capJobs) * sizeof(GraphicsJob));
+        g->capJobs = cap;
+    }
+    GraphicsJob *job = &g->jobs[g->numJobs++];
+    job->x = x;
+    job->y = y;
+    job->width = width;
+    job->height = height;
+    job->id = id;
+}
+
+void encodeGraphics(GraphicsOutput *g, OutBuf *ob, const Frame *frame, Frame *shown, int originRow, int screenRows)
+{
+    bool known = shown->cells != NULL && shown->width == frame->width && shown->height == frame->height;
+    int blocksX = (frame->width + GRAPHICS_BLOCK_WIDTH - 1) / GRAPHICS_BLOCK_WIDTH;
+
+    TRACE_BEGIN("encode");
+
+    // Sixel image ending on the last line would scroll the screen
+    int height = frame->height;
+    if (g->protocol == GRAPHICS_SIXEL && originRow + height > screenRows - 1)
+        height = screenRows - 1 - originRow;
+
+    g->numJobs = 0;
+    for (int y = 0; y < height; y += GRAPHICS_BLOCK_HEIGHT)
+    {
+        int h = height - y < GRAPHICS_BLOCK_HEIGHT ? height - y : GRAPHICS_BLOCK_HEIGHT;
+        for (int x = 0; x < frame->width; x += GRAPHICS_BLOCK_WIDTH)
+        {
+            int w = frame->width - x < GRAPHICS_BLOCK_WIDTH ? frame->width - x : GRAPHICS_BLOCK_WIDTH;
+            if (!known || blockChanged(frame, shown, x, y, w, h))
+                addJob(g, x, y, w, h, (y / GRAPHICS_BLOCK_HEIGHT) * blocksX + x / GRAPHICS_BLOCK_WIDTH + 1);
+        }
+    }
+
+    if (g->workers != NULL && g->numJobs > 1)
+    {
+        pthread_mutex_lock(&g->lock);
+        workFrame = frame;
+        g->next = 0;
+        g->finished = 0;
+        g->count = g->numJobs;
+        pthread_cond_broadcast(&g->work);
+        while (g->finished < g->count)
+            pthread_cond_wait(&g->done, &g->lock);
+        g->count = 0;
+        pthread_mutex_unlock(&g->lock);
+    }
+    else
+    {
+        for (int i = 0; i < g->numJobs; i++)
+        {
+            runJob(g, frame, &g->jobs[i], g->scratch[0]);
+        }
+    }
+
+    // Blocks go out in order, each one at its own cell
+    for (int i = 0; i < g->numJobs; i++)
+    {
+        GraphicsJob *job = &g->jobs[i];
+        obPrintf(ob, ESC_CURSOR_MOVE, originRow + job->y + 1, job->x + 1);
+        obAppend(ob, job->data.data, job->data.len);
+    }
+
+    copyFrame(shown, frame);
+    TRACE_END("encode");
+}
@@ -0,0 +1,78 @@
+#ifndef GRAPHICS_H
+#define GRAPHICS_H
+
+#include <pthread.h>
+#include <stdbool.h>
+
+#include "Frame.h"
+#include "Font.h"
+#include "Output.h"
+
+enum {
+    GRAPHICS_NONE = 0, // plain text cells
+    GRAPHICS_SIXEL,
+    GRAPHICS_KITTY
+};
+
+// Unit of upload, in cells
+#define GRAPHICS_BLOCK_WIDTH 8
+#define GRAPHICS_BLOCK_HEIGHT 4
+
+#define GRAPHICS_MAX_COLORS 16
+
+// One dirty block of the frame, rasterized and encoded by a worker
+typedef struct {
+    int x;        // cells
+    int y;
+    int width;
+    int height;
+    int id;       // kitty image id, stable per block
+    OutBuf data;  // encoded image, kept between frames to reuse the memory
+} GraphicsJob;
+
+/**
+ * Pixel output. Frame cells are drawn through a glyph atlas (one tile per glyph and style,
+ * style carries the intensity), only blocks with changed cells are uploaded again:
+ * as sixel images or as kitty graphics that replace the block's previous image.
+ * Blocks are rasterized and encoded in parallel.
+ */
+typedef struct {
+    int protocol;
+    GlyphAtlas atlas;
+    int colors[GRAPHICS_MAX_COLORS]; // sixel palette, every color the atlas uses
+    int numColors;
+
+    GraphicsJob *jobs;
+    int numJobs;
+    int capJobs;
+
+    // Worker pool, same scheme as the export rasterizer
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t done;
+    int next;
+    int count;    // jobs handed to the workers, 0 while idle
+    int finished;
+    bool quit;
+    int threads;
+    pthread_t *workers;
+    unsigned char **scratch; // per worker: block pixels
+} GraphicsOutput;
+
+// "sixel" or "kitty", -1 if unknown
+int parseGraphics(const char *name);
+
+const char* graphicsName(int protocol);
+
+void initGraphics(GraphicsOutput *g, int protocol, int cellWidth, int cellHeight, int threads);
+
+void freeGraphics(GraphicsOutput *g);
+
+/**
+ * Upload blocks of frame that differ from shown (everything if shown doesn't match),
+ * frame row 0 is terminal row originRow. shown becomes frame.
+ * Sixel leaves out the last terminal row, an image touching it scrolls the screen.
+ */
+void encodeGraphics(GraphicsOutput *g, OutBuf *ob, const Frame *frame, Frame *shown, int originRow, int screenRows);
+
+#endif
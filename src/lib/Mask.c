@@ -0,0 +1,191 @@
+#include <string.h>
+
+#include "Mask.h"
+#include "Font.h"
+#include "Memory.h"
+
+// Larger images are not worth it, the mask ends up the size of the terminal anyway
+#define MASK_MAX_SIZE 16384
+
+void initMask(Mask *m, int width, int height)
+{
+    if (width < 0) width = 0;
+    if (height < 0) height = 0;
+
+    m->width = width;
+    m->height = height;
+    m->words = (width + 63) / 64;
+    m->bits = memCalloc((size_t)m->words * height + 1, sizeof(uint64_t));
+}
+
+void freeMask(Mask *m)
+{
+    memFree(m->bits);
+    memset(m, 0, sizeof(*m));
+}
+
+void clearMask(Mask *m)
+{
+    memset(m->bits, 0, (size_t)m->words * m->height * sizeof(uint64_t));
+}
+
+// Skip whitespace and # comments of the header
+static size_t skipSpace(const char *data, size_t len, size_t pos)
+{
+    while (pos < len)
+    {
+        if (data[pos] == '#')
+        {
+            while (pos < len && data[pos] != '\n')
+                pos++;
+        }
+        else if (data[pos] == ' ' || data[pos] == '\t' || data[pos] == '\r' || data[pos] == '\n')
+            pos++;
+        else
+            break;
+    }
+    return pos;
+}
+
+static size_t readNumber(const char *data, size_t len, size_t pos, int *value)
+{
+    *value = -1;
+    pos = skipSpace(data, len, pos);
+    if (pos >= len || data[pos] < '0' || data[pos] > '9')
+        return pos;
+
+    *value = 0;
+    while (pos < len && data[pos] >= '0' && data[pos] <= '9')
+    {
+        if (*value <= MASK_MAX_SIZE)
+            *value = *value * 10 + (data[pos] - '0');
+        pos++;
+    }
+    return pos;
+}
+
+bool parsePbm(Mask *m, const char *data, size_t len)
+{
+    int width, height;
+
+    if (len < 2 || data[0] != 'P' || (data[1] != '1' && data[1] != '4'))
+        return false;
+
+    bool raw = data[1] == '4';
+    size_t pos = readNumber(data, len, 2, &width);
+    pos = readNumber(data, len, pos, &height);
+    if (width < 1 || height < 1 || width > MASK_MAX_SIZE || height > MASK_MAX_SIZE)
+        return false;
+
+    if (raw)
+    {
+        // Exactly one whitespace after the height, then rows padded to whole bytes
+        size_t rowBytes = (size_t)(width + 7) / 8;
+        pos++;
+        if (pos > len || len - pos < rowBytes * height)
+            return false;
+
+        initMask(m, width, height);
+        for (int y = 0; y < height; y++)
+        {
+            const unsigned char *row = (const unsigned char *)data + pos + rowBytes * y;
+            for (int x = 0; x < width; x++)
+            {
+                if (row[x >> 3] & (0x80 >> (x & 7)))
+                    setMaskBit(m, x, y);
+            }
+        }
+        return true;
+    }
+
+    // Plain: one 0 or 1 per pixel, whitespace in between is optional
+    initMask(m, width, height);
+    for (int i = 0; i < width * height; i++)
+    {
+        pos = skipSpace(data, len, pos);
+        if (pos >= len || (data[pos] != '0' && data[pos] != '1'))
+        {
+            freeMask(m);
+            return false;
+        }
+        if (data[pos++] == '1')
+            setMaskBit(m, i % width, i / width);
+    }
+    return true;
+}
+
+void rasterizeText(Mask *m, const char *text)
+{
+    int lines = 1, longest = 0, length = 0;
+
+    for (const char *p = text; *p; p++)
+    {
+        if (*p == '\n')
+        {
+            lines++;
+            length = 0;
+            continue;
+        }
+        if (++length > longest)
+            longest = length;
+    }
+
+    // Gap after the last glyph and below the last line is left out
+    initMask(m, longest > 0 ? longest * FONT_CELL_WIDTH - 1 : 0,
+        lines * (FONT_HEIGHT + 2) - 2);
+
+    int column = 0, line = 0;
+    for (const char *p = text; *p; p++)
+    {
+        if (*p == '\n')
+        {
+            line++;
+            column = 0;
+            continue;
+        }
+
+        const char *const *rows = fontRows((unsigned char)*p);
+        if (rows != NULL)
+        {
+            for (int gy = 0; gy < FONT_HEIGHT; gy++)
+            {
+                for (int gx = 0; gx < FONT_WIDTH; gx++)
+                {
+                    if (rows[gy][gx] == '#')
+                        setMaskBit(m, column * FONT_CELL_WIDTH + gx, line * (FONT_HEIGHT + 2) + gy);
+                }
+            }
+        }
+        column++;
+    }
+}
+
+void scaleMask(Mask *dst, const Mask *src, int width, int height)
+{
+    initMask(dst, width, height);
+    if (src->width < 1 || src->height < 1 || width < 1 || height < 1)
+        return;
+
+    // Cells per source pixel across, a cell is two pixels high
+    double sx = (double)width / src->width;
+    double sy = 2.0 * height / src->height;
+    double s = sx < sy ? sx : sy;
+    double left = (width - src->width * s) / 2;
+    double top = (height - src->height * s / 2) / 2;
+
+    for (int y = 0; y < height; y++)
+    {
+        int py = (int)((y + 0.5 - top) * 2 / s);
+        if (y + 0.5 < top || py >= src->height)
+            continue;
+
+        for (int x = 0; x < width; x++)
+        {
+            int px = (int)((x + 0.5 - left) / s);
+            if (x + 0.5 < left || px >= src->width)
+                continue;
+            if (maskBit(src, px, py))
+                setMaskBit(dst, x, y);
+        }
+    }
+}
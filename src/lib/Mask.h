@@ -0,0 +1,53 @@
+#ifndef MASK_H
+#define MASK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * One bit per cell, packed row by row. Every row starts on its own 64 bit word
+ * and the bits past the width are always 0, so rows can be combined word by word.
+ */
+typedef struct {
+    int width;
+    int height;
+    int words;      // 64 bit words per row
+    uint64_t *bits;
+} Mask;
+
+// All bits clear, an old mask has to be freed first
+void initMask(Mask *m, int width, int height);
+
+void freeMask(Mask *m);
+
+void clearMask(Mask *m);
+
+static inline uint64_t* maskRow(const Mask *m, int y)
+{
+    return m->bits + (size_t)y * m->words;
+}
+
+static inline bool maskBit(const Mask *m, int x, int y)
+{
+    return (maskRow(m, y)[x >> 6] >> (x & 63)) & 1;
+}
+
+static inline void setMaskBit(Mask *m, int x, int y)
+{
+    maskRow(m, y)[x >> 6] |= (uint64_t)1 << (x & 63);
+}
+
+// PBM image, plain (P1) or raw (P4), black pixels are set. False if it isn't one
+bool parsePbm(Mask *m, const char *data, size_t len);
+
+// Text in the built in 5x7 font, lines split at '\n', pixels of the glyphs are set
+void rasterizeText(Mask *m, const char *text);
+
+/**
+ * Fit src into a width x height mask of terminal cells (about twice as high as wide),
+ * keeping the proportions and centered, nearest neighbour.
+ */
+void scaleMask(Mask *dst, const Mask *src, int width, int height);
+
+#endif
@@ -0,0 +1,53 @@
+#include <stdlib.h>
+
+#include "Memory.h"
+
+AllocStats allocStats = { 0, 0, 0 };
+
+static MemoryFailure onFailure = NULL;
+
+MemoryFailure setMemoryFailure(MemoryFailure handler)
+{
+    MemoryFailure previous = onFailure;
+    onFailure = handler;
+    return previous;
+}
+
+static void* checked(void *ptr, size_t size)
+{
+    // malloc(0) may give NULL too, that is not a failure
+    if (ptr == NULL && size > 0 && onFailure != NULL)
+        onFailure(size);
+    return ptr;
+}
+
+void* memAlloc(size_t size)
+{
+    allocStats.allocs++;
+    allocStats.bytes += size;
+    return checked(malloc(size), size);
+}
+
+void* memCalloc(size_t count, size_t size)
+{
+    allocStats.allocs++;
+    allocStats.bytes += count * size;
+    return checked(calloc(count, size), count * size);
+}
+
+void* memRealloc(void *ptr, size_t size)
+{
+    allocStats.allocs++;
+    allocStats.bytes += size;
+    if (ptr != NULL)
+        allocStats.frees++;
+    return checked(realloc(ptr, size), size);
+}
+
+void memFree(void *ptr)
+{
+    if (ptr == NULL)
+        return;
+    allocStats.frees++;
+    free(ptr);
+}
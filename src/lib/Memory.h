@@ -0,0 +1,30 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <stddef.h>
+
+// Counters of every allocation made through mem* functions, bench reads them
+typedef struct {
+    long long allocs;
+    long long frees;
+    long long bytes;
+} AllocStats;
+
+extern AllocStats allocStats;
+
+/**
+ * Called with the size asked for when there is no memory left, it must not return: the
+ * app prints and exits, Rain.c jumps back out of the API call. Without one mem* return NULL.
+ */
+typedef void (*MemoryFailure)(size_t size);
+
+// Returns the handler that was set before
+MemoryFailure setMemoryFailure(MemoryFailure handler);
+
+void* memAlloc(size_t size);
+void* memCalloc(size_t count, size_t size);
+void* memRealloc(void *ptr, size_t size);
+
+void memFree(void *ptr);
+
+#endif
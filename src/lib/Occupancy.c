@@ -0,0 +1,152 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "Occupancy.h"
+#include "Memory.h"
+
+static inline bool isVertical(const Viewport *vp)
+{
+    return vp->direction == 'D' || vp->direction == 'U';
+}
+
+// Same range the kernels wrap drops into, at least one lane even for an empty pane
+static inline int laneCount(const Viewport *vp, bool vertical)
+{
+    int lanes = vertical ? vp->columns - vp->paddingRight : vp->rows - vp->paddingBottom;
+    return lanes > 0 ? lanes : 1;
+}
+
+// xorshift32
+static inline unsigned int nextRandom(Occupancy *o)
+{
+    unsigned int x = o->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    o->rng = x;
+    return x;
+}
+
+// One more drop in lane, a full lane leaves the free set (swapped with the last one)
+static inline void takeLane(Occupancy *o, int lane)
+{
+    if (++o->count[lane] >= o->limit && o->slot[lane] >= 0)
+    {
+        int last = o->free[--o->numFree];
+        o->free[o->slot[lane]] = last;
+        o->slot[last] = o->slot[lane];
+        o->slot[lane] = -1;
+    }
+}
+
+static inline void giveLane(Occupancy *o, int lane)
+{
+    if (lane < 0 || lane >= o->lanes || o->count[lane] <= 0)
+        return;
+    if (--o->count[lane] < o->limit && o->slot[lane] < 0)
+    {
+        o->slot[lane] = o->numFree;
+        o->free[o->numFree++] = lane;
+    }
+}
+
+void freeOccupancy(Occupancy *o)
+{
+    memFree(o->count);
+    memFree(o->slot);
+    memFree(o->free);
+    memset(o, 0, sizeof(*o));
+}
+
+void resetOccupancy(Viewport *vp, int placed)
+{
+    Occupancy *o = &vp->occupancy;
+    bool vertical = isVertical(vp);
+    int lanes = laneCount(vp, vertical);
+    int drops = vp->numDrops > 0 ? vp->numDrops : 1;
+
+    if (lanes > o->capacity)
+    {
+        o->count = memRealloc(o->count, lanes * sizeof(int));
+        o->slot = memRealloc(o->slot, lanes * sizeof(int));
+        o->free = memRealloc(o->free, lanes * sizeof(int));
+        o->capacity = lanes;
+    }
+    // Seeded from the rain's generator, same seed same rain
+    if (o->rng == 0)
+        o->rng = (unsigned int)rand() | 1;
+
+    o->lanes = lanes;
+    o->vertical = vertical;
+    // One over the even share, with an exact multiple every lane would be full and a wrapping
+    // drop could only come back in the lane it left
+    o->limit = drops / lanes + 1;
+    memset(o->count, 0, lanes * sizeof(int));
+
+    // Drops past the edge (the pane shrank) don't count, they get a lane when they wrap
+    for (int i = 0; i < placed; i++)
+    {
+        int lane = vertical ? vp->drops[i].x : vp->drops[i].y;
+        if (lane >= 0 && lane < lanes)
+            o->count[lane]++;
+    }
+
+    o->numFree = 0;
+    for (int lane = 0; lane < lanes; lane++)
+    {
+        if (o->count[lane] < o->limit)
+        {
+            o->slot[lane] = o->numFree;
+            o->free[o->numFree++] = lane;
+        }
+        else
+            o->slot[lane] = -1;
+    }
+}
+
+// Pane was resized or the rain turned since the lanes were counted
+static inline void checkOccupancy(Viewport *vp)
+{
+    bool vertical = isVertical(vp);
+    if (vp->occupancy.lanes != laneCount(vp, vertical) || vp->occupancy.vertical != vertical)
+        resetOccupancy(vp, vp->drops != NULL ? vp->numDrops : 0);
+}
+
+int laneCapacity(const Viewport *vp, int numDrops)
+{
+    if (vp->maxPerLane <= 0)
+        return numDrops;
+
+    // One slot less than all lanes full, the free one wanders and drops keep changing lanes
+    int lanes = laneCount(vp, isVertical(vp));
+    long long room = (long long)lanes * vp->maxPerLane - (lanes > 1 ? 1 : 0);
+    return numDrops < room ? numDrops : (int)room;
+}
+
+int spawnLane(Viewport *vp)
+{
+    checkOccupancy(vp);
+    Occupancy *o = &vp->occupancy;
+
+    // Only after the pane shrank under its drops can every lane be full, then any will do
+    int lane = o->numFree > 0 ? o->free[nextRandom(o) % o->numFree] : (int)(nextRandom(o) % o->lanes);
+    takeLane(o, lane);
+    return lane;
+}
+
+int respawnLane(Viewport *vp, int lane)
+{
+    checkOccupancy(vp);
+    giveLane(&vp->occupancy, lane);
+    return spawnLane(vp);
+}
+
+void moveLane(Viewport *vp, int from, int to)
+{
+    checkOccupancy(vp);
+    Occupancy *o = &vp->occupancy;
+
+    giveLane(o, from);
+    if (to >= 0 && to < o->lanes)
+        takeLane(o, to);
+}
@@ -0,0 +1,29 @@
+#ifndef OCCUPANCY_API_H
+#define OCCUPANCY_API_H
+
+#include "types/Viewport.h"
+
+void freeOccupancy(Occupancy *o);
+
+/**
+ * Count the first placed drops of the pane again and share the lanes out for all of its
+ * numDrops: no lane gets more than numDrops / lanes + 1, so the lanes are never all full and
+ * wrapping drops keep moving between them. After drops were added, removed or the pane was
+ * set up; a resize or a turn of the rain is noticed on its own.
+ */
+void resetOccupancy(Viewport *vp, int placed);
+
+// Most drops the pane can have with at most maxPerLane per lane (0 = no limit), one short of
+// every lane full so drops still move between lanes
+int laneCapacity(const Viewport *vp, int numDrops);
+
+// Lane with room for a new drop, picked at random among them
+int spawnLane(Viewport *vp);
+
+// Drop wrapped and leaves lane, returns the lane it comes back in
+int respawnLane(Viewport *vp, int lane);
+
+// Drop was put in another lane from outside (pointer), even if that one is full
+void moveLane(Viewport *vp, int from, int to);
+
+#endif
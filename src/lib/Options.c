@@ -0,0 +1,77 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "Options.h"
+
+static const Option *findOption(const Option *options, int count, const char *name, size_t len)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (strlen(options[i].name) == len && strncmp(options[i].name, name, len) == 0)
+            return &options[i];
+    }
+    return NULL;
+}
+
+bool parseOptions(int argc, char **argv, const Option *options, int count)
+{
+    bool ok = true;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        bool dashed = strncmp(arg, "--", 2) == 0;
+        if (dashed)
+            arg += 2;
+
+        const char *eq = strchr(arg, '=');
+        size_t len = eq != NULL ? (size_t)(eq - arg) : strlen(arg);
+        const char *value = eq != NULL ? eq + 1 : NULL;
+
+        const Option *opt = findOption(options, count, arg, len);
+        if (opt == NULL)
+        {
+            fprintf(stderr, "Unknown option '%s'\n", argv[i]);
+            ok = false;
+            continue;
+        }
+
+        if (opt->value == NULL)
+        {
+            if (value != NULL)
+            {
+                fprintf(stderr, "Option '%s' takes no value\n", opt->name);
+                ok = false;
+                continue;
+            }
+        }
+        else if (value == NULL)
+        {
+            // --name value
+            if (!dashed || i + 1 >= argc)
+            {
+                fprintf(stderr, "Option '%s' needs a value (%s=%s)\n", opt->name, opt->name, opt->value);
+                ok = false;
+                continue;
+            }
+            value = argv[++i];
+        }
+
+        if (!opt->apply(value))
+            ok = false;
+    }
+    return ok;
+}
+
+void printOptions(FILE *f, const Option *options, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        char usage[64];
+        if (options[i].value != NULL)
+            snprintf(usage, sizeof(usage), "%s=%s", options[i].name, options[i].value);
+        else
+            snprintf(usage, sizeof(usage), "%s", options[i].name);
+        fprintf(f, "  %-40s %s\n", usage, options[i].help);
+    }
+}
@@ -0,0 +1,27 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+/**
+ * One command line option. Every option can be written as `name`, `name=value`,
+ * `--name`, `--name=value` or `--name value` (the last one only if it takes a value).
+ */
+typedef struct {
+    const char *name;
+    const char *value;              // Placeholder shown in usage, NULL for flags
+    bool (*apply)(const char *value); // Gets NULL for flags, false if the value is bad (it says why)
+    const char *help;
+} Option;
+
+/**
+ * Apply all arguments in order. Unknown options, missing values and values
+ * given to flags are reported on stderr, bad values by the option itself.
+ * Returns false if anything was wrong.
+ */
+bool parseOptions(int argc, char **argv, const Option *options, int count);
+
+void printOptions(FILE *f, const Option *options, int count);
+
+#endif
@@ -0,0 +1,98 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "Output.h"
+#include "Memory.h"
+
+void obReserve(OutBuf *ob, size_t extra)
+{
+    if (ob->len + extra <= ob->cap)
+        return;
+
+    size_t cap = ob->cap ? ob->cap : 4096;
+    while (cap < ob->len + extra)
+        cap *= 2;
+
+    ob->data = (char *)memRealloc(ob->data, cap);
+    ob->cap = cap;
+}
+
+void obAppend(OutBuf *ob, const char *s, size_t n)
+{
+    obReserve(ob, n);
+    memcpy(ob->data + ob->len, s, n);
+    ob->len += n;
+}
+
+void obPuts(OutBuf *ob, const char *s)
+{
+    obAppend(ob, s, strlen(s));
+}
+
+void obPutc(OutBuf *ob, char c)
+{
+    obReserve(ob, 1);
+    ob->data[ob->len++] = c;
+}
+
+void obPutNumber(OutBuf *ob, int n)
+{
+    char digits[12];
+    int len = 0;
+
+    do
+    {
+        digits[len++] = (char)('0' + n % 10);
+        n /= 10;
+    } while (n > 0);
+
+    obReserve(ob, (size_t)len);
+    while (len > 0)
+        ob->data[ob->len++] = digits[--len];
+}
+
+void obPutGlyph(OutBuf *ob, int c)
+{
+    obReserve(ob, 4);
+    char *p = ob->data + ob->len;
+
+    if (c < 0x80)
+    {
+        p[0] = (char)c;
+        ob->len += 1;
+    }
+    else if (c < 0x800)
+    {
+        p[0] = (char)(0xC0 | (c >> 6));
+        p[1] = (char)(0x80 | (c & 0x3F));
+        ob->len += 2;
+    }
+    else if (c < 0x10000)
+    {
+        p[0] = (char)(0xE0 | (c >> 12));
+        p[1] = (char)(0x80 | ((c >> 6) & 0x3F));
+        p[2] = (char)(0x80 | (c & 0x3F));
+        ob->len += 3;
+    }
+    else
+    {
+        p[0] = (char)(0xF0 | (c >> 18));
+        p[1] = (char)(0x80 | ((c >> 12) & 0x3F));
+        p[2] = (char)(0x80 | ((c >> 6) & 0x3F));
+        p[3] = (char)(0x80 | (c & 0x3F));
+        ob->len += 4;
+    }
+}
+
+void obReset(OutBuf *ob)
+{
+    ob->len = 0;
+}
+
+void obFree(OutBuf *ob)
+{
+    memFree(ob->data);
+    ob->data = NULL;
+    ob->len = 0;
+    ob->cap = 0;
+}
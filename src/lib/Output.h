@@ -0,0 +1,32 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// Growable byte buffer, the whole frame is built here and written at once
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} OutBuf;
+
+void obReserve(OutBuf *ob, size_t extra);
+
+void obAppend(OutBuf *ob, const char *s, size_t n);
+
+void obPuts(OutBuf *ob, const char *s);
+
+void obPutc(OutBuf *ob, char c);
+
+// Append a non negative decimal number, the encoders build their sequences with it
+void obPutNumber(OutBuf *ob, int n);
+
+// Append unicode code point encoded as UTF-8
+void obPutGlyph(OutBuf *ob, int c);
+
+void obReset(OutBuf *ob);
+
+void obFree(OutBuf *ob);
+
+#endif
@@ -0,0 +1,136 @@
+#include <string.h>
+
+#include "Overlay.h"
+
+void initOverlay(Overlay *o)
+{
+    memset(o, 0, sizeof(*o));
+}
+
+int addOverlayBox(Overlay *o, int x, int y, int z, int width, int style)
+{
+    if (o->numBoxes >= MAX_OVERLAY_BOXES)
+        return -1;
+
+    int id = o->numBoxes++;
+    OverlayBox *box = &o->boxes[id];
+    memset(box, 0, sizeof(*box));
+    box->x = x;
+    box->y = y;
+    box->z = z;
+    box->width = width;
+    box->style = (unsigned char)style;
+
+    // Insert after every box with the same or lower z, so equal z keeps the order added
+    int at = id;
+    while (at > 0 && o->boxes[o->order[at - 1]].z > z)
+    {
+        o->order[at] = o->order[at - 1];
+        at--;
+    }
+    o->order[at] = id;
+    return id;
+}
+
+// Next code point of UTF-8 text, '?' for a broken sequence
+static int decodeUtf8(const unsigned char **p)
+{
+    const unsigned char *s = *p;
+    int c, more;
+
+    if (s[0] < 0x80) { c = s[0]; more = 0; }
+    else if ((s[0] & 0xE0) == 0xC0) { c = s[0] & 0x1F; more = 1; }
+    else if ((s[0] & 0xF0) == 0xE0) { c = s[0] & 0x0F; more = 2; }
+    else if ((s[0] & 0xF8) == 0xF0) { c = s[0] & 0x07; more = 3; }
+    else
+    {
+        *p = s + 1;
+        return '?';
+    }
+
+    for (int i = 1; i <= more; i++)
+    {
+        if ((s[i] & 0xC0) != 0x80)
+        {
+            *p = s + i;
+            return '?';
+        }
+        c = c << 6 | (s[i] & 0x3F);
+    }
+    *p = s + 1 + more;
+    return c;
+}
+
+bool setOverlayText(Overlay *o, int id, const char *text)
+{
+    if (id < 0 || id >= o->numBoxes)
+        return false;
+
+    OverlayBox *box = &o->boxes[id];
+    if (text == NULL)
+    {
+        bool was = box->visible;
+        box->visible = false;
+        return was;
+    }
+    if (box->visible && strncmp(box->text, text, OVERLAY_TEXT_SIZE - 1) == 0)
+        return false;
+
+    box->visible = true;
+    strncpy(box->text, text, OVERLAY_TEXT_SIZE - 1);
+    box->text[OVERLAY_TEXT_SIZE - 1] = 0;
+
+    // Decoded once here, not every frame
+    const unsigned char *p = (const unsigned char *)box->text;
+    box->length = 0;
+    while (*p)
+    {
+        box->glyphs[box->length++] = decodeUtf8(&p);
+    }
+    return true;
+}
+
+static inline void putCell(Frame *frame, int x, int y, int c, unsigned char style)
+{
+    if (x < 0 || y < 0 || x >= frame->width || y >= frame->height)
+        return;
+    *frameCell(frame, x, y) = (Cell){ c, style, STYLE_EMPTY };
+}
+
+static void drawBox(const OverlayBox *box, Frame *frame)
+{
+    int left = box->x < 0 ? frame->width + box->x : box->x;
+    int top = box->y < 0 ? frame->height + box->y : box->y;
+    int right = box->width < 0 ? frame->width : left + box->width;
+    int x = left;
+    int y = top;
+
+    // One more round for the end of the last line
+    for (int i = 0; i <= box->length; i++)
+    {
+        int c = i < box->length ? box->glyphs[i] : '\n';
+        if (c != '\n')
+        {
+            putCell(frame, x++, y, c, box->style);
+            continue;
+        }
+
+        // Rest of the line is the box's too, the rain doesn't show through
+        for (; x < right; x++)
+        {
+            putCell(frame, x, y, ' ', box->style);
+        }
+        x = left;
+        y++;
+    }
+}
+
+void drawOverlay(const Overlay *o, Frame *frame)
+{
+    for (int i = 0; i < o->numBoxes; i++)
+    {
+        const OverlayBox *box = &o->boxes[o->order[i]];
+        if (box->visible)
+            drawBox(box, frame);
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef OVERLAY_H
+#define OVERLAY_H
+
+#include <stdbool.h>
+
+#include "Frame.h"
+
+#define MAX_OVERLAY_BOXES 16
+#define OVERLAY_TEXT_SIZE 256 // bytes of UTF-8 per box
+
+// Text box over the rain, glyphs one cell wide
+typedef struct {
+    int x;       // top left cell, negative counts from the right or bottom edge (-1 = last)
+    int y;
+    int z;       // boxes with higher z are drawn over lower ones
+    int width;   // cells covered on every line even past the text, -1 = up to the right edge, 0 = just the text
+    unsigned char style;
+    bool visible;
+    int length;  // decoded glyphs
+    int glyphs[OVERLAY_TEXT_SIZE];
+    char text[OVERLAY_TEXT_SIZE]; // as last set, to tell if it changed
+} OverlayBox;
+
+/**
+ * Text boxes drawn into the frame after the rain is composed, so the diff renderer
+ * sends them like any other cells: nothing while they stay the same, only the glyphs
+ * that differ when the text changes.
+ */
+typedef struct {
+    OverlayBox boxes[MAX_OVERLAY_BOXES];
+    int numBoxes;
+    int order[MAX_OVERLAY_BOXES]; // ids from the lowest z to the highest, in the order added
+} Overlay;
+
+void initOverlay(Overlay *o);
+
+// Hidden box until it gets text, returns its id or -1 if there is no room
+int addOverlayBox(Overlay *o, int x, int y, int z, int width, int style);
+
+// '\n' starts a new line, NULL hides the box. Returns false if nothing changed
+bool setOverlayText(Overlay *o, int id, const char *text);
+
+// Boxes over the frame, lowest z first, cut at the frame edges
+void drawOverlay(const Overlay *o, Frame *frame);
+
+#endif
@@ -0,0 +1,333 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "Parallax.h"
+#include "Viewport.h"
+#include "Memory.h"
+#include "Trace.h"
+
+static int shadeOf(int layer, int numLayers)
+{
+    if (numLayers < 2)
+        return 0;
+    // Spread the layers over the shades, the last one is always far
+    return (layer * (NUM_SHADES - 1) + (numLayers - 1) / 2) / (numLayers - 1);
+}
+
+// Shorter tails the further back, but never shorter than 2
+static void backLengths(const Viewport *near, int layer, int *minLength, int *maxLength)
+{
+    *minLength = near->minLength / (layer + 1);
+    if (*minLength < 2) *minLength = 2;
+    *maxLength = near->maxLength / (layer + 1);
+    if (*maxLength < *minLength) *maxLength = *minLength;
+}
+
+static void copyGeometry(Viewport *dst, const Viewport *src)
+{
+    dst->rows = src->rows;
+    dst->columns = src->columns;
+    dst->paddingLeft = src->paddingLeft;
+    dst->paddingTop = src->paddingTop;
+    dst->paddingRight = src->paddingRight;
+    dst->paddingBottom = src->paddingBottom;
+}
+
+// Pane may be moved or resized by the layout at any time, layers behind go with it
+static void followGeometry(Parallax *p)
+{
+    for (int k = 1; k < p->numLayers; k++)
+    {
+        copyGeometry(p->layers[k].vp, p->layers[0].vp);
+    }
+}
+
+static void markAll(Parallax *p)
+{
+    for (int k = 0; k < p->numLayers; k++)
+    {
+        memset(p->layers[k].dirty, 1, (size_t)p->tilesX * p->tilesY);
+    }
+}
+
+// Make pictures and tile grids fit the pane, returns true if they had to change
+static bool layoutLayers(Parallax *p)
+{
+    const Viewport *near = p->layers[0].vp;
+    int width = near->columns;
+    int height = near->rows - near->paddingBottom;
+    if (width < 1) width = 1;
+    if (height < 1) height = 1;
+
+    Layer *l = &p->layers[0];
+    if (l->cells.cells != NULL && l->cells.width == width && l->cells.height == height)
+        return false;
+
+    p->tilesX = (width + LAYER_TILE_WIDTH - 1) / LAYER_TILE_WIDTH;
+    p->tilesY = (height + LAYER_TILE_HEIGHT - 1) / LAYER_TILE_HEIGHT;
+
+    for (int k = 0; k < p->numLayers; k++)
+    {
+        l = &p->layers[k];
+        resizeFrame(&l->cells, width, height);
+        clearFrame(&l->cells);
+        // Not left dangling if the new one can't be had
+        memFree(l->dirty);
+        l->dirty = NULL;
+        l->dirty = (unsigned char *)memCalloc((size_t)p->tilesX * p->tilesY, 1);
+    }
+    markAll(p);
+    return true;
+}
+
+void initParallax(Parallax *p, Viewport *near, int numLayers, long long skip)
+{
+    memset(p, 0, sizeof(*p));
+    if (numLayers < 1) numLayers = 1;
+    if (numLayers > MAX_LAYERS) numLayers = MAX_LAYERS;
+
+    p->numLayers = numLayers;
+    p->nearMinLength = near->minLength;
+    p->nearMaxLength = near->maxLength;
+    p->layers[0].vp = near;
+
+    for (int k = 1; k < numLayers; k++)
+    {
+        Viewport *vp = &p->back[k - 1];
+        int minLength, maxLength;
+
+        setupViewport(vp, near->paddingLeft, near->paddingTop, near->columns, near->rows);
+        copyGeometry(vp, near);
+        vp->numDrops = near->numDrops;
+        vp->maxPerLane = near->maxPerLane;
+        vp->millis = near->millis * (k + 1);
+        vp->glyphs = near->glyphs;
+        setViewportDirection(vp, near->direction);
+        // Linked before it allocates, so a half built layer is freed too
+        p->layers[k].vp = vp;
+        initViewport(vp);
+
+        backLengths(near, k, &minLength, &maxLength);
+        setDropLengths(vp, minLength, maxLength);
+        fastForwardViewport(vp, skip);
+    }
+
+    for (int k = 0; k < numLayers; k++)
+    {
+        p->layers[k].shade = shadeOf(k, numLayers);
+    }
+    layoutLayers(p);
+}
+
+void freeParallax(Parallax *p)
+{
+    for (int k = 0; k < p->numLayers; k++)
+    {
+        if (k > 0 && p->layers[k].vp != NULL)
+            freeViewport(p->layers[k].vp);
+        freeFrame(&p->layers[k].cells);
+        memFree(p->layers[k].dirty);
+        p->layers[k].dirty = NULL;
+    }
+    p->numLayers = 0;
+}
+
+void syncParallax(Parallax *p)
+{
+    const Viewport *near = p->layers[0].vp;
+    bool lengths = near->minLength != p->nearMinLength || near->maxLength != p->nearMaxLength;
+
+    for (int k = 1; k < p->numLayers; k++)
+    {
+        Viewport *vp = p->layers[k].vp;
+
+        copyGeometry(vp, near);
+        vp->maxPerLane = near->maxPerLane;
+        vp->millis = near->millis * (k + 1);
+        vp->glyphs = near->glyphs;
+        if (vp->direction != near->direction)
+            setViewportDirection(vp, near->direction);
+        if (vp->numDrops != near->numDrops)
+            resizeDrops(vp, near->numDrops);
+        if (lengths)
+        {
+            int minLength, maxLength;
+            backLengths(near, k, &minLength, &maxLength);
+            setDropLengths(vp, minLength, maxLength);
+        }
+    }
+
+    p->nearMinLength = near->minLength;
+    p->nearMaxLength = near->maxLength;
+    if (!layoutLayers(p))
+        markAll(p);
+}
+
+static inline void markCell(const Parallax *p, Layer *l, int x, int y)
+{
+    if (x < 0 || y < 0 || x >= l->cells.width || y >= l->cells.height)
+        return;
+    l->dirty[(y / LAYER_TILE_HEIGHT) * p->tilesX + x / LAYER_TILE_WIDTH] = 1;
+}
+
+void markLayerCell(Parallax *p, int layer, int x, int y)
+{
+    markCell(p, &p->layers[layer], x, y);
+}
+
+void stepLayer(Parallax *p, int layer)
+{
+    Layer *l = &p->layers[layer];
+    Viewport *vp = l->vp;
+
+    // Tail glyphs stand still, so a step only changes three cells per drop:
+    // where the head was (now first tail segment), where it goes and the end of the tail it leaves
+    for (int i = 0; i < vp->numDrops; i++)
+    {
+        int end = vp->drops[i].length - 1;
+        markCell(p, l, vp->drops[i].x, vp->drops[i].y);
+        markCell(p, l, vp->tailSegments[i].x[end], vp->tailSegments[i].y[end]);
+    }
+
+    updateViewport(vp);
+
+    for (int i = 0; i < vp->numDrops; i++)
+    {
+        markCell(p, l, vp->drops[i].x, vp->drops[i].y);
+    }
+}
+
+long long tickParallax(Parallax *p, long long now, bool paused)
+{
+    long long next = -1;
+
+    followGeometry(p);
+    for (int k = 0; k < p->numLayers; k++)
+    {
+        Viewport *vp = p->layers[k].vp;
+        if (now >= vp->nextTick)
+        {
+            if (!paused)
+                stepLayer(p, k);
+            vp->nextTick = now + vp->millis;
+        }
+        if (next < 0 || vp->nextTick < next)
+            next = vp->nextTick;
+    }
+    return next;
+}
+
+static inline bool tileDirty(const Parallax *p, const Layer *l, int x, int y)
+{
+    return l->dirty[(y / LAYER_TILE_HEIGHT) * p->tilesX + x / LAYER_TILE_WIDTH];
+}
+
+// Repaint the layer's own picture, only inside its dirty tiles
+static void redrawLayer(const Parallax *p, Layer *l)
+{
+    const Viewport *vp = l->vp;
+    Frame *cells = &l->cells;
+
+    for (int ty = 0; ty < p->tilesY; ty++)
+    {
+        for (int tx = 0; tx < p->tilesX; tx++)
+        {
+            if (!l->dirty[ty * p->tilesX + tx])
+                continue;
+
+            int x1 = (tx + 1) * LAYER_TILE_WIDTH < cells->width ? (tx + 1) * LAYER_TILE_WIDTH : cells->width;
+            int y1 = (ty + 1) * LAYER_TILE_HEIGHT < cells->height ? (ty + 1) * LAYER_TILE_HEIGHT : cells->height;
+            for (int y = ty * LAYER_TILE_HEIGHT; y < y1; y++)
+            {
+                for (int x = tx * LAYER_TILE_WIDTH; x < x1; x++)
+                {
+                    *frameCell(cells, x, y) = (Cell){ ' ', STYLE_EMPTY };
+                }
+            }
+        }
+    }
+
+    // Same order as composeViewport, inside a layer the first drop wins
+    for (int i = vp->numDrops - 1; i >= 0; i--)
+    {
+        const TailSegment *tail = &vp->tailSegments[i];
+
+        for (int j = vp->drops[i].length - 1; j >= 0; j--)
+        {
+            int x = tail->x[j];
+            int y = tail->y[j];
+            if (x < 0 || y < 0 || x >= cells->width || y >= cells->height || !tileDirty(p, l, x, y))
+                continue;
+
+            *frameCell(cells, x, y) = (Cell){ tail->c[j], STYLE_TAIL };
+        }
+    }
+
+    for (int i = vp->numDrops - 1; i >= 0; i--)
+    {
+        int x = vp->drops[i].x;
+        int y = vp->drops[i].y;
+        if (x < 0 || y < 0 || x >= cells->width || y >= cells->height || !tileDirty(p, l, x, y))
+            continue;
+
+        *frameCell(cells, x, y) = (Cell){ vp->drops[i].c, STYLE_DROP };
+    }
+}
+
+void composeParallax(Frame *frame, Parallax *p, bool full)
+{
+    TRACE_BEGIN("compose");
+
+    followGeometry(p);
+    if (layoutLayers(p) || full)
+        markAll(p);
+
+    for (int k = 0; k < p->numLayers; k++)
+    {
+        redrawLayer(p, &p->layers[k]);
+    }
+
+    const Viewport *near = p->layers[0].vp;
+    int width = p->layers[0].cells.width;
+    int height = p->layers[0].cells.height;
+    if (near->paddingLeft + width > frame->width)
+        width = frame->width - near->paddingLeft;
+    if (near->paddingTop + height > frame->height)
+        height = frame->height - near->paddingTop;
+
+    for (int ty = 0; ty < p->tilesY; ty++)
+    {
+        for (int tx = 0; tx < p->tilesX; tx++)
+        {
+            int tile = ty * p->tilesX + tx;
+            bool dirty = false;
+            for (int k = 0; k < p->numLayers; k++)
+            {
+                dirty |= p->layers[k].dirty[tile];
+                p->layers[k].dirty[tile] = 0;
+            }
+            if (!dirty)
+                continue;
+
+            int x1 = (tx + 1) * LAYER_TILE_WIDTH < width ? (tx + 1) * LAYER_TILE_WIDTH : width;
+            int y1 = (ty + 1) * LAYER_TILE_HEIGHT < height ? (ty + 1) * LAYER_TILE_HEIGHT : height;
+            for (int y = ty * LAYER_TILE_HEIGHT; y < y1; y++)
+            {
+                for (int x = tx * LAYER_TILE_WIDTH; x < x1; x++)
+                {
+                    // Back to front, nearer layers cover the ones behind
+                    Cell out = { ' ', STYLE_EMPTY };
+                    for (int k = p->numLayers - 1; k >= 0; k--)
+                    {
+                        const Cell *c = frameCell(&p->layers[k].cells, x, y);
+                        if (c->style != STYLE_EMPTY)
+                            out = (Cell){ c->c, shadeStyle(c->style, p->layers[k].shade) };
+                    }
+                    *frameCell(frame, near->paddingLeft + x, near->paddingTop + y) = out;
+                }
+            }
+        }
+    }
+
+    TRACE_END("compose");
+}
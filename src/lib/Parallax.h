@@ -0,0 +1,64 @@
+#ifndef PARALLAX_H
+#define PARALLAX_H
+
+#include <stdbool.h>
+
+#include "Frame.h"
+
+#define MAX_LAYERS 4
+
+// Dirty rectangles are tracked on this grid of cells
+#define LAYER_TILE_WIDTH 8
+#define LAYER_TILE_HEIGHT 4
+
+// One depth layer, its own simulation and its own picture
+typedef struct {
+    Viewport *vp;
+    Frame cells;          // pane sized, base styles (STYLE_TAIL/STYLE_DROP)
+    unsigned char *dirty; // one flag per tile, set where the layer changed since last composite
+    int shade;            // 0 near .. NUM_SHADES - 1 far
+} Layer;
+
+/**
+ * Pane with depth layers of rain. Nearest layer is the pane itself, the ones behind
+ * are slower, dimmer and have shorter tails. Every layer marks the tiles it changes
+ * when it steps and only repaints those in its own picture, the compositor then
+ * touches only tiles where some layer changed, so a layer that didn't step costs nothing.
+ */
+typedef struct {
+    int numLayers;
+    Layer layers[MAX_LAYERS];     // 0 is the nearest
+    Viewport back[MAX_LAYERS - 1]; // simulations of layers 1..
+    int tilesX;
+    int tilesY;
+    int nearMinLength; // what far layer lengths were derived from
+    int nearMaxLength;
+} Parallax;
+
+/**
+ * Put numLayers - 1 layers behind near. Near pane must be initialized already,
+ * layers behind are created from its settings and fast-forwarded by skip cycles.
+ */
+void initParallax(Parallax *p, Viewport *near, int numLayers, long long skip);
+
+void freeParallax(Parallax *p);
+
+// Layers behind take over changed settings of the near one (drops, glyphs, direction, speed, lengths)
+void syncParallax(Parallax *p);
+
+// Step every layer that is due, return the time the next one is due
+long long tickParallax(Parallax *p, long long now, bool paused);
+
+// Step one layer by a cycle and mark what changed
+void stepLayer(Parallax *p, int layer);
+
+// Cell of a layer changed outside of a step (a drop was moved), repaint its tile
+void markLayerCell(Parallax *p, int layer, int x, int y);
+
+/**
+ * Composite layers back to front into the frame, only in tiles that changed.
+ * With full, everything is repainted (frame was resized or cleared).
+ */
+void composeParallax(Frame *frame, Parallax *p, bool full);
+
+#endif
@@ -0,0 +1,391 @@
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <pthread.h>
+#include <setjmp.h>
+
+#include "rain.h"
+#include "Engine.h"
+#include "Reveal.h"
+#include "Overlay.h"
+#include "Viewport.h"
+#include "Renderer.h"
+#include "Glyphs.h"
+#include "Memory.h"
+
+// Cells are handed out as they are, without conversion
+_Static_assert(sizeof(RainCell) == sizeof(Cell), "RainCell must match Cell");
+_Static_assert(offsetof(RainCell, style) == offsetof(Cell, style), "RainCell must match Cell");
+_Static_assert(offsetof(RainCell, bg) == offsetof(Cell, bg), "RainCell must match Cell");
+_Static_assert((int)RAIN_STYLE_REVEAL == (int)STYLE_REVEAL, "RAIN_STYLE_* must match STYLE_*");
+_Static_assert((int)RAIN_STYLE_OVERLAY == (int)STYLE_OVERLAY, "RAIN_STYLE_* must match STYLE_*");
+
+struct Rain {
+    Engine engine;
+    int columns;
+    int rows;
+    OutBuf out;      // encoded frame, reused so steady frames don't allocate
+    bool encoded;    // out holds the current frame, not taken yet
+    long long clock; // simulation time, only rain_step moves it
+    long long due;   // when the next pane or layer steps
+    Reveal reveal;   // engine.reveal points here when set
+    Overlay overlay; // engine.overlay points here once there is a box
+    bool broken;     // a call ran out of memory, only rain_destroy is left
+};
+
+static pthread_once_t glyphsOnce = PTHREAD_ONCE_INIT;
+
+// Calls that allocate run inside a guard, running out of memory jumps back to its setjmp
+// and the call returns an error instead of the app's handler exiting
+typedef struct Guard {
+    jmp_buf failed;
+    struct Guard *outer;
+    MemoryFailure previous;
+} Guard;
+
+static Guard *guard = NULL;
+
+static void failGuard(size_t size)
+{
+    (void)size;
+    longjmp(guard->failed, 1);
+}
+
+static void enterGuard(Guard *g)
+{
+    g->outer = guard;
+    g->previous = setMemoryFailure(failGuard);
+    guard = g;
+}
+
+static void leaveGuard(Guard *g)
+{
+    guard = g->outer;
+    setMemoryFailure(g->previous);
+}
+
+// Half done changes can't be undone, the handle is only good for freeing now
+static void breakRain(Rain *rain, Guard *g)
+{
+    leaveGuard(g);
+    rain->broken = true;
+}
+
+// One pane over the whole screen, in sub-cells when they are on
+static void layoutRain(Rain *rain)
+{
+    Viewport *vp = &rain->engine.panes[0];
+    int sx, sy;
+
+    subcellScale(rain->engine.subcells, &sx, &sy);
+    vp->columns = rain->columns * sx;
+    vp->rows = rain->rows * sy;
+    if (rain->engine.reveal != NULL)
+        fitReveal(rain->engine.reveal, vp->columns, vp->rows);
+}
+
+void rain_config_defaults(RainConfig *config)
+{
+    config->columns = 80;
+    config->rows = 24;
+    config->drops = 220;
+    config->column_drops = 0;
+    config->millis = 20;
+    config->layers = 1;
+    config->glyphs = "latin";
+    config->colors = "16";
+    config->renderer = "diff";
+    config->direction = "down";
+    config->subcells = "off";
+    config->repeat = 1;
+    config->seed = 1234;
+    config->skip = -1;
+}
+
+Rain* rain_create(const RainConfig *config)
+{
+    const GlyphSet *glyphs;
+    int colors = parseColorDepth(config->colors);
+    int renderer = findRenderer(config->renderer);
+    int direction = parseDirection(config->direction);
+    int subcells = parseSubcells(config->subcells);
+
+    Rain *volatile rain = NULL;
+    Guard g;
+
+    pthread_once(&glyphsOnce, initGlyphSets);
+    glyphs = findGlyphSet(config->glyphs);
+
+    if (config->columns < 1 || config->rows < 1 || config->drops < 0 || config->column_drops < 0 || config->millis < 1
+        || config->layers < 1 || config->layers > MAX_LAYERS
+        || glyphs == NULL || colors < 0 || renderer < 0 || direction == 0 || subcells < 0)
+        return NULL;
+
+    enterGuard(&g);
+    if (setjmp(g.failed))
+    {
+        // Everything it built so far frees like a whole one
+        leaveGuard(&g);
+        rain_destroy(rain);
+        return NULL;
+    }
+
+    rain = memCalloc(1, sizeof(Rain));
+    Engine *e = &rain->engine;
+
+    srand(config->seed);
+    srandom(config->seed);
+
+    initEngine(e);
+    e->numLayers = config->layers;
+    e->renderer = renderer;
+    e->colors = colors;
+    e->direction = direction;
+    e->subcells = subcells;
+    if (!config->repeat)
+        e->features &= ~ENCODE_REPEAT;
+    e->numPanes = 1;
+
+    Viewport *vp = &e->panes[0];
+    setupViewport(vp, 0, 0, 1, 1);
+    setViewportDirection(vp, direction);
+    vp->millis = config->millis;
+    vp->numDrops = config->drops;
+    vp->maxPerLane = config->column_drops;
+    vp->glyphs = glyphs;
+
+    rain->columns = config->columns;
+    rain->rows = config->rows;
+    layoutRain(rain);
+    startEngine(e, config->skip);
+
+    // Clock starts at 0, first steps are due one cycle later
+    rain->due = tickEngine(e, 0, true);
+    leaveGuard(&g);
+    return rain;
+}
+
+void rain_destroy(Rain *rain)
+{
+    if (rain == NULL)
+        return;
+    freeEngine(&rain->engine);
+    if (rain->engine.reveal != NULL)
+        freeReveal(&rain->reveal);
+    obFree(&rain->out);
+    memFree(rain);
+}
+
+int rain_step(Rain *rain, int millis)
+{
+    long long until = rain->clock + millis;
+    Guard g;
+
+    if (rain->broken)
+        return -1;
+    enterGuard(&g);
+    if (setjmp(g.failed))
+    {
+        breakRain(rain, &g);
+        return -1;
+    }
+
+    // Catch up step by step, a long step is the same as many short ones
+    while (rain->due <= until)
+    {
+        rain->clock = rain->due;
+        rain->due = tickEngine(&rain->engine, rain->clock, false);
+    }
+    rain->clock = until;
+    leaveGuard(&g);
+    return 0;
+}
+
+int rain_resize(Rain *rain, int columns, int rows)
+{
+    Guard g;
+
+    if (rain->broken || columns < 1 || rows < 1)
+        return -1;
+    enterGuard(&g);
+    if (setjmp(g.failed))
+    {
+        breakRain(rain, &g);
+        return -1;
+    }
+
+    // Drops that are outside now wrap around the same way as after a terminal resize
+    rain->columns = columns;
+    rain->rows = rows;
+    layoutRain(rain);
+    rain_invalidate(rain);
+    leaveGuard(&g);
+    return 0;
+}
+
+void rain_invalidate(Rain *rain)
+{
+    freeFrame(&rain->engine.shown);
+    obReset(&rain->out);
+    rain->encoded = false;
+}
+
+static void encodeRain(Rain *rain)
+{
+    if (rain->encoded)
+        return;
+    encodeHome(&rain->out);
+    composeEngine(&rain->engine, rain->columns, rain->rows);
+    encodeEngine(&rain->engine, &rain->out, 0, false);
+    rain->encoded = true;
+}
+
+size_t rain_render(Rain *rain, char *buf, size_t size)
+{
+    Guard g;
+
+    if (rain->broken)
+        return RAIN_ERROR;
+    enterGuard(&g);
+    if (setjmp(g.failed))
+    {
+        breakRain(rain, &g);
+        return RAIN_ERROR;
+    }
+    encodeRain(rain);
+    leaveGuard(&g);
+
+    size_t len = rain->out.len;
+    if (len > size)
+        return len;
+
+    memcpy(buf, rain->out.data, len);
+    obReset(&rain->out);
+    rain->encoded = false;
+    return len;
+}
+
+int rain_render_to(Rain *rain, RainWriter write, void *user)
+{
+    Guard g;
+
+    if (rain->broken)
+        return -1;
+    enterGuard(&g);
+    if (setjmp(g.failed))
+    {
+        breakRain(rain, &g);
+        return -1;
+    }
+    encodeRain(rain);
+    leaveGuard(&g);
+
+    write(user, rain->out.data, rain->out.len);
+    obReset(&rain->out);
+    rain->encoded = false;
+    return 0;
+}
+
+static void useReveal(Rain *rain, Mask *m)
+{
+    if (rain->engine.reveal != NULL)
+        freeReveal(&rain->reveal);
+    rain->engine.reveal = NULL;
+    // Layers recompose only what moved, old revealed cells have to go everywhere
+    freeFrame(&rain->engine.frame);
+    freeFrame(&rain->engine.fine);
+    if (m == NULL)
+        return;
+    initReveal(&rain->reveal, m);
+    rain->engine.reveal = &rain->reveal;
+    // Steps before the next frame already uncover it
+    layoutRain(rain);
+}
+
+int rain_reveal_text(Rain *rain, const char *text)
+{
+    Mask m;
+    Guard g;
+
+    if (rain->broken)
+        return -1;
+    enterGuard(&g);
+    if (setjmp(g.failed))
+    {
+        breakRain(rain, &g);
+        return -1;
+    }
+    if (text == NULL)
+        useReveal(rain, NULL);
+    else
+    {
+        rasterizeText(&m, text);
+        useReveal(rain, &m);
+    }
+    leaveGuard(&g);
+    return 0;
+}
+
+int rain_reveal_pbm(Rain *rain, const void *data, size_t len)
+{
+    Mask m;
+    Guard g;
+
+    if (rain->broken)
+        return -1;
+    enterGuard(&g);
+    if (setjmp(g.failed))
+    {
+        breakRain(rain, &g);
+        return -1;
+    }
+    // Not an image isn't a failure of the handle, it goes on with the old reveal
+    if (!parsePbm(&m, data, len))
+    {
+        leaveGuard(&g);
+        return -1;
+    }
+    useReveal(rain, &m);
+    leaveGuard(&g);
+    return 0;
+}
+
+int rain_overlay_add(Rain *rain, int x, int y, int z, const char *text)
+{
+    if (rain->broken)
+        return -1;
+    if (rain->engine.overlay == NULL)
+    {
+        initOverlay(&rain->overlay);
+        rain->engine.overlay = &rain->overlay;
+    }
+
+    int id = addOverlayBox(&rain->overlay, x, y, z, 0, STYLE_OVERLAY);
+    setOverlayText(&rain->overlay, id, text);
+    return id;
+}
+
+void rain_overlay_set(Rain *rain, int id, const char *text)
+{
+    if (rain->engine.overlay != NULL)
+        setOverlayText(&rain->overlay, id, text);
+}
+
+const RainCell* rain_cells(Rain *rain, int *columns, int *rows)
+{
+    Guard g;
+
+    if (rain->broken)
+        return NULL;
+    enterGuard(&g);
+    if (setjmp(g.failed))
+    {
+        breakRain(rain, &g);
+        return NULL;
+    }
+    composeEngine(&rain->engine, rain->columns, rain->rows);
+    leaveGuard(&g);
+    *columns = rain->columns;
+    *rows = rain->rows;
+    return (const RainCell*)rain->engine.frame.cells;
+}
@@ -0,0 +1,713 @@
+#include <string.h>
+
+#include "Renderer.h"
+#include "Trace.h"
+#include "types/Colors.h"
+#include "types/Escapes.h"
+
+static const char *rendererNames[NUM_RENDERERS] = { "scan", "full", "diff" };
+
+// Palette used by the encoder, depends on color depth, one color per shade
+static const char *colorTail[NUM_SHADES] = { ANSI_COLOR_MAIN_FONT, ANSI_COLOR_MID_FONT, ANSI_COLOR_FAR_FONT };
+static const char *colorDrop[NUM_SHADES] = { ANSI_COLOR_DROP, ANSI_COLOR_MID_DROP, ANSI_COLOR_FAR_DROP };
+static const char *colorDebug = ANSI_COLOR_BLUE;
+static const char *colorReveal = ANSI_COLOR_REVEAL;
+static const char *colorOverlay = ANSI_COLOR_OVERLAY;
+
+// Backgrounds by cell style, STYLE_EMPTY is never used as one and neither is STYLE_OVERLAY,
+// boxes are drawn over the packed sub-cells
+static const char *backgrounds16[NUM_STYLES] = { "", ANSI_BG_COLOR_FONT, ANSI_BG_COLOR_DROP,
+    ANSI_BG_COLOR_FONT, ANSI_BG_COLOR_FONT, ANSI_BG_COLOR_FONT, ANSI_BG_COLOR_FONT, ANSI_BG_COLOR_REVEAL, "" };
+static const char *backgrounds256[NUM_STYLES] = { "", ANSI_BG_256_MAIN_FONT, ANSI_BG_256_DROP,
+    ANSI_BG_256_MID_FONT, ANSI_BG_256_MID_DROP, ANSI_BG_256_FAR_FONT, ANSI_BG_256_FAR_DROP, ANSI_BG_256_REVEAL, "" };
+static const char *backgroundsRgb[NUM_STYLES] = { "", ANSI_BG_RGB_MAIN_FONT, ANSI_BG_RGB_DROP,
+    ANSI_BG_RGB_MID_FONT, ANSI_BG_RGB_MID_DROP, ANSI_BG_RGB_FAR_FONT, ANSI_BG_RGB_FAR_DROP, ANSI_BG_RGB_REVEAL, "" };
+static const char **colorBackground = backgrounds16;
+static int colorDepth = COLORS_16;
+
+int findRenderer(const char *name)
+{
+    for (int i = 0; i < NUM_RENDERERS; i++)
+    {
+        if (strcmp(rendererNames[i], name) == 0)
+            return i;
+    }
+    return -1;
+}
+
+const char* rendererName(int renderer)
+{
+    if (renderer < 0 || renderer >= NUM_RENDERERS)
+        return "?";
+    return rendererNames[renderer];
+}
+
+int parseColorDepth(const char *name)
+{
+    if (strcmp(name, "16") == 0)
+        return COLORS_16;
+    if (strcmp(name, "256") == 0)
+        return COLORS_256;
+    if (strcmp(name, "truecolor") == 0 || strcmp(name, "24") == 0)
+        return COLORS_TRUE;
+    return -1;
+}
+
+const char* colorDepthName(int depth)
+{
+    switch (depth)
+    {
+        case COLORS_256: return "256";
+        case COLORS_TRUE: return "truecolor";
+        default: return "16";
+    }
+}
+
+static void setPalette(const char *tail, const char *tailMid, const char *tailFar,
+    const char *drop, const char *dropMid, const char *dropFar)
+{
+    colorTail[0] = tail;
+    colorTail[1] = tailMid;
+    colorTail[2] = tailFar;
+    colorDrop[0] = drop;
+    colorDrop[1] = dropMid;
+    colorDrop[2] = dropFar;
+}
+
+int currentColorDepth()
+{
+    return colorDepth;
+}
+
+void setColorDepth(int depth)
+{
+    colorDepth = depth;
+    switch (depth)
+    {
+        case COLORS_256:
+            setPalette(ANSI_256_MAIN_FONT, ANSI_256_MID_FONT, ANSI_256_FAR_FONT,
+                ANSI_256_DROP, ANSI_256_MID_DROP, ANSI_256_FAR_DROP);
+            colorDebug = ANSI_256_BLUE;
+            colorReveal = ANSI_256_REVEAL;
+            colorOverlay = ANSI_256_OVERLAY;
+            colorBackground = backgrounds256;
+            break;
+        case COLORS_TRUE:
+            setPalette(ANSI_RGB_MAIN_FONT, ANSI_RGB_MID_FONT, ANSI_RGB_FAR_FONT,
+                ANSI_RGB_DROP, ANSI_RGB_MID_DROP, ANSI_RGB_FAR_DROP);
+            colorDebug = ANSI_RGB_BLUE;
+            colorReveal = ANSI_RGB_REVEAL;
+            colorOverlay = ANSI_RGB_OVERLAY;
+            colorBackground = backgroundsRgb;
+            break;
+        default:
+            setPalette(ANSI_COLOR_MAIN_FONT, ANSI_COLOR_MID_FONT, ANSI_COLOR_FAR_FONT,
+                ANSI_COLOR_DROP, ANSI_COLOR_MID_DROP, ANSI_COLOR_FAR_DROP);
+            colorDebug = ANSI_COLOR_BLUE;
+            colorReveal = ANSI_COLOR_REVEAL;
+            colorOverlay = ANSI_COLOR_OVERLAY;
+            colorBackground = backgrounds16;
+            break;
+    }
+}
+
+void composePanes(Frame *frame, const Viewport *panes, int numPanes, int renderer)
+{
+    TRACE_BEGIN("compose");
+    clearFrame(frame);
+
+    for (int i = 0; i < numPanes; i++)
+    {
+        if (renderer == RENDERER_SCAN)
+            composeViewportScan(frame, &panes[i]);
+        else
+            composeViewport(frame, &panes[i]);
+    }
+    TRACE_END("compose");
+}
+
+void encodeHome(OutBuf *ob)
+{
+    // One absolute move instead of going up line by line
+    obPuts(ob, ESC_CURSOR_HOME);
+}
+
+static void encodeEmpty(OutBuf *ob, bool debugMode)
+{
+    if (debugMode)
+    {
+        obPuts(ob, colorDebug);
+        obPutc(ob, '.');
+    }
+    else
+    {
+        obPutc(ob, ' ');
+    }
+}
+
+static const char* styleColor(int style)
+{
+    if (style == STYLE_REVEAL)
+        return colorReveal;
+    if (style == STYLE_OVERLAY)
+        return colorOverlay;
+    // Tails and drops alternate, shade of the layer is every second style
+    int shade = (style - 1) / 2;
+    return (style - 1) % 2 == 0 ? colorTail[shade] : colorDrop[shade];
+}
+
+static void encodeCell(OutBuf *ob, const Cell *cell, bool debugMode)
+{
+    if (cell->style == STYLE_EMPTY || cell->style >= NUM_STYLES)
+    {
+        encodeEmpty(ob, debugMode);
+        return;
+    }
+
+    obPuts(ob, styleColor(cell->style));
+    if (cell->bg != STYLE_EMPTY && cell->bg < NUM_STYLES)
+        obPuts(ob, colorBackground[cell->bg]);
+    obPutGlyph(ob, cell->c);
+    obPuts(ob, ANSI_COLOR_RESET);
+}
+
+void encodeFrame(OutBuf *ob, const Frame *frame, bool debugMode)
+{
+    for (int y = 0; y < frame->height; y++)
+    {
+        if (y > 0) obPutc(ob, '\n'); // Start at new line
+
+        for (int x = 0; x < frame->width; x++)
+        {
+            encodeCell(ob, frameCell(frame, x, y), debugMode);
+        }
+    }
+}
+
+static bool sameCell(const Cell *a, const Cell *b)
+{
+    return a->c == b->c && a->style == b->style && a->bg == b->bg;
+}
+
+// Pens of the diff encoder besides the cell styles
+#define PEN_DEFAULT STYLE_EMPTY // after a reset
+#define PEN_DEBUG NUM_STYLES    // dots of the debug mode
+
+// A pen is the cell style, with the background style (if any) in the bits above
+#define PEN_BG_SHIFT 4
+#define PEN_STYLE_MASK ((1 << PEN_BG_SHIFT) - 1)
+
+// Gaps up to this many cells may be written again instead of moving over them
+#define REWRITE_LIMIT 8
+
+static int encoderFeatures = ENCODE_ERASE | ENCODE_REPEAT;
+
+void setEncoderFeatures(int features)
+{
+    encoderFeatures = features;
+}
+
+int currentEncoderFeatures()
+{
+    return encoderFeatures;
+}
+
+/**
+ * What the diff encoder knows about the terminal. Column is -1 when unknown: after
+ * the last column the terminal may be waiting to wrap and relative moves can't be trusted.
+ */
+typedef struct {
+    OutBuf *ob;
+    const Frame *frame;
+    int originRow;
+    bool debugMode;
+    int x;
+    int y;    // -1 if unknown
+    int pen;  // PEN_* or the style the terminal draws with
+} Cursor;
+
+// How the cursor gets to the next cell, vertical part first
+enum { VERT_NONE, VERT_CUP, VERT_RELATIVE, VERT_ROW, VERT_NEWLINE };
+enum { MOVE_NONE, MOVE_CR, MOVE_RIGHT, MOVE_LEFT, MOVE_BACKSPACE, MOVE_COLUMN, MOVE_CR_RIGHT, MOVE_REWRITE };
+
+static inline bool blankCell(const Cell *cell)
+{
+    return cell->style == STYLE_EMPTY || cell->style >= NUM_STYLES;
+}
+
+// Pen the cell needs, -1 if any will do (a space looks the same in every color)
+static inline int cellPen(const Cell *cell, bool debugMode)
+{
+    if (blankCell(cell))
+        return debugMode ? PEN_DEBUG : -1;
+    return cell->bg < NUM_STYLES ? cell->style | cell->bg << PEN_BG_SHIFT : cell->style;
+}
+
+// Pen to write the cell with when the terminal draws with pen. A blank looks the same
+// in every color, but not on every background
+static inline int neededPen(const Cell *cell, int pen, bool debugMode)
+{
+    int need = cellPen(cell, debugMode);
+    if (need < 0 && pen >> PEN_BG_SHIFT != STYLE_EMPTY)
+        return PEN_DEFAULT;
+    return need;
+}
+
+static inline int cellGlyph(const Cell *cell, bool debugMode)
+{
+    if (blankCell(cell))
+        return debugMode ? '.' : ' ';
+    return cell->c;
+}
+
+static inline int glyphBytes(int c)
+{
+    return c < 0x80 ? 1 : c < 0x800 ? 2 : c < 0x10000 ? 3 : 4;
+}
+
+static inline int digits(int n)
+{
+    int d = 1;
+    while (n >= 10)
+    {
+        n /= 10;
+        d++;
+    }
+    return d;
+}
+
+// Bytes of CSI n F, count 1 is the default and left out
+static inline int csiCost(int n)
+{
+    return n == 1 ? 3 : 3 + digits(n);
+}
+
+static void putCsi(OutBuf *ob, int n, char final)
+{
+    obPuts(ob, ESC_CSI);
+    if (n != 1)
+        obPutNumber(ob, n);
+    obPutc(ob, final);
+}
+
+static const char* penColor(int pen)
+{
+    if (pen == PEN_DEBUG)
+        return colorDebug;
+    return styleColor(pen & PEN_STYLE_MASK);
+}
+
+// Background part of the pen, empty if it has none
+static const char* penBackground(int pen)
+{
+    return colorBackground[pen >> PEN_BG_SHIFT];
+}
+
+// Colors only add attributes, so going from one to another needs a reset,
+// it goes in front of the color's parameters: CSI 0;1;92m
+#define ESC_RESET_AND "\x1b[0;"
+
+static int penCost(int from, int to)
+{
+    if (from == to)
+        return 0;
+    if (to == PEN_DEFAULT)
+        return (int)sizeof(ANSI_COLOR_RESET) - 1;
+    int background = (int)strlen(penBackground(to));
+    if (from == PEN_DEFAULT)
+        return (int)strlen(penColor(to)) + background;
+    return (int)strlen(penColor(to)) + 2 + background;
+}
+
+static void setPen(Cursor *cur, int pen)
+{
+    if (pen == PEN_DEFAULT)
+        obPuts(cur->ob, ANSI_COLOR_RESET);
+    else if (cur->pen == PEN_DEFAULT)
+        obPuts(cur->ob, penColor(pen));
+    else
+    {
+        obPuts(cur->ob, ESC_RESET_AND);
+        obPuts(cur->ob, penColor(pen) + sizeof(ESC_CSI) - 1);
+    }
+    if (pen != PEN_DEFAULT)
+        obPuts(cur->ob, penBackground(pen));
+    cur->pen = pen;
+}
+
+static void advance(Cursor *cur, int n)
+{
+    cur->x = cur->x + n < cur->frame->width ? cur->x + n : -1;
+}
+
+static void writeCell(Cursor *cur, const Cell *cell)
+{
+    int pen = neededPen(cell, cur->pen, cur->debugMode);
+    if (pen >= 0 && pen != cur->pen)
+        setPen(cur, pen);
+    obPutGlyph(cur->ob, cellGlyph(cell, cur->debugMode));
+    advance(cur, 1);
+}
+
+// Bytes needed to write cells from..to-1 of row y again, counting stops above limit
+static int rewriteCost(const Cursor *cur, int y, int from, int to, int limit)
+{
+    int pen = cur->pen;
+    int cost = 0;
+
+    for (int x = from; x < to && cost <= limit; x++)
+    {
+        const Cell *cell = frameCell(cur->frame, x, y);
+        int need = neededPen(cell, pen, cur->debugMode);
+        if (need >= 0 && need != pen)
+        {
+            cost += penCost(pen, need);
+            pen = need;
+        }
+        cost += glyphBytes(cellGlyph(cell, cur->debugMode));
+    }
+    return cost;
+}
+
+// Cheapest way from column from (-1 unknown) to x on row y
+static int horizontalCost(const Cursor *cur, int from, int x, int y, int *how)
+{
+    if (from == x)
+    {
+        *how = MOVE_NONE;
+        return 0;
+    }
+    if (x == 0)
+    {
+        *how = MOVE_CR;
+        return 1;
+    }
+
+    int best = csiCost(x + 1);
+    *how = MOVE_COLUMN;
+
+    if (1 + csiCost(x) < best)
+    {
+        best = 1 + csiCost(x);
+        *how = MOVE_CR_RIGHT;
+    }
+    if (from < 0)
+        return best;
+
+    if (x > from)
+    {
+        if (csiCost(x - from) < best)
+        {
+            best = csiCost(x - from);
+            *how = MOVE_RIGHT;
+        }
+        // Writing what is already there can be shorter than any escape sequence
+        if (x - from <= REWRITE_LIMIT)
+        {
+            int cost = rewriteCost(cur, y, from, x, best - 1);
+            if (cost < best)
+            {
+                best = cost;
+                *how = MOVE_REWRITE;
+            }
+        }
+    }
+    else
+    {
+        if (csiCost(from - x) < best)
+        {
+            best = csiCost(from - x);
+            *how = MOVE_LEFT;
+        }
+        if (from - x < best)
+        {
+            best = from - x;
+            *how = MOVE_BACKSPACE;
+        }
+    }
+    return best;
+}
+
+static int cupCost(const Cursor *cur, int x, int y)
+{
+    int row = cur->originRow + y + 1;
+    if (x == 0)
+        return row == 1 ? 3 : 3 + digits(row);
+    return 4 + digits(row) + digits(x + 1);
+}
+
+/**
+ * Pick the cheapest way to x,y, like mvcur of ncurses: absolute CUP, relative CUU/CUD,
+ * VPA or CR LF for the row, then CR, CUF/CUB, BS, CHA or writing the cells again for the column.
+ */
+static int planMove(const Cursor *cur, int x, int y, int *vert, int *horiz)
+{
+    int best = cupCost(cur, x, y);
+    int cost, how;
+
+    *vert = VERT_CUP;
+    *horiz = MOVE_NONE;
+
+    if (cur->y == y)
+    {
+        cost = horizontalCost(cur, cur->x, x, y, &how);
+        if (cost < best)
+        {
+            best = cost;
+            *vert = VERT_NONE;
+            *horiz = how;
+        }
+        return best;
+    }
+    if (cur->y < 0)
+        return best;
+
+    int dy = y - cur->y;
+    int across = horizontalCost(cur, cur->x, x, y, &how);
+
+    // Up or down, the column stays
+    cost = csiCost(dy > 0 ? dy : -dy) + across;
+    if (cost < best)
+    {
+        best = cost;
+        *vert = VERT_RELATIVE;
+        *horiz = how;
+    }
+    cost = 3 + digits(cur->originRow + y + 1) + across;
+    if (cost < best)
+    {
+        best = cost;
+        *vert = VERT_ROW;
+        *horiz = how;
+    }
+    // CR first, so it is the same with or without the tty turning LF into CR LF
+    if (dy > 0)
+    {
+        cost = 1 + dy + horizontalCost(cur, 0, x, y, &how);
+        if (cost < best)
+        {
+            best = cost;
+            *vert = VERT_NEWLINE;
+            *horiz = how;
+        }
+    }
+    return best;
+}
+
+static void moveCursor(Cursor *cur, int x, int y)
+{
+    OutBuf *ob = cur->ob;
+    int vert, horiz;
+
+    planMove(cur, x, y, &vert, &horiz);
+
+    switch (vert)
+    {
+        case VERT_CUP:
+            obPuts(ob, ESC_CSI);
+            if (cur->originRow + y > 0 || x > 0)
+                obPutNumber(ob, cur->originRow + y + 1);
+            if (x > 0)
+            {
+                obPutc(ob, ';');
+                obPutNumber(ob, x + 1);
+            }
+            obPutc(ob, 'H');
+            cur->x = x;
+            cur->y = y;
+            return;
+        case VERT_RELATIVE:
+            putCsi(ob, y > cur->y ? y - cur->y : cur->y - y, y > cur->y ? 'B' : 'A');
+            break;
+        case VERT_ROW:
+            putCsi(ob, cur->originRow + y + 1, 'd');
+            break;
+        case VERT_NEWLINE:
+            obPutc(ob, '\r');
+            for (int i = cur->y; i < y; i++)
+                obPutc(ob, '\n');
+            cur->x = 0;
+            break;
+        default:
+            break;
+    }
+    cur->y = y;
+
+    switch (horiz)
+    {
+        case MOVE_CR: obPutc(ob, '\r'); break;
+        case MOVE_RIGHT: putCsi(ob, x - cur->x, 'C'); break;
+        case MOVE_LEFT: putCsi(ob, cur->x - x, 'D'); break;
+        case MOVE_COLUMN: putCsi(ob, x + 1, 'G'); break;
+        case MOVE_CR_RIGHT:
+            obPutc(ob, '\r');
+            putCsi(ob, x, 'C');
+            break;
+        case MOVE_BACKSPACE:
+            for (int i = x; i < cur->x; i++)
+                obPutc(ob, '\b');
+            break;
+        case MOVE_REWRITE:
+            for (int i = cur->x; i < x; i++)
+                writeCell(cur, frameCell(cur->frame, i, y));
+            break;
+        default:
+            break;
+    }
+    cur->x = x;
+}
+
+// Cost of moving to the next cell to write, from column x on row y
+static int moveCostFrom(const Cursor *cur, int x, int y, int next)
+{
+    if (next >= cur->frame->width)
+        return 0;
+
+    Cursor at = *cur;
+    int vert, horiz;
+    at.x = x < cur->frame->width ? x : -1;
+    at.y = y;
+    return planMove(&at, next, y, &vert, &horiz);
+}
+
+static int nextChange(const Frame *frame, const Frame *prev, int y, int x)
+{
+    while (x < frame->width && sameCell(frameCell(frame, x, y), frameCell(prev, x, y)))
+        x++;
+    return x;
+}
+
+/**
+ * Changed blanks starting at x: spaces, a space repeated with REP, ECH that leaves
+ * the cursor where it is, or EL when everything up to the edge is blank.
+ * Returns the column after the last blank that was written.
+ */
+static int encodeBlanks(Cursor *cur, const Frame *prev, int x, int y)
+{
+    const Frame *frame = cur->frame;
+    int end = x;
+    int last = x;
+
+    while (end < frame->width && blankCell(frameCell(frame, end, y)))
+    {
+        if (!sameCell(frameCell(frame, end, y), frameCell(prev, end, y)))
+            last = end;
+        end++;
+    }
+
+    int count = last - x + 1;
+    int next = nextChange(frame, prev, y, last + 1);
+    int after = moveCostFrom(cur, x + count, y, next);
+    int stay = moveCostFrom(cur, x, y, next);
+
+    // Spaces and erased cells take the background of the pen
+    if (cur->pen >> PEN_BG_SHIFT != STYLE_EMPTY)
+        setPen(cur, PEN_DEFAULT);
+
+    enum { SPACES, REPEAT, ERASE_CHARS, ERASE_LINE } how = SPACES;
+    int best = count + after;
+
+    if ((encoderFeatures & ENCODE_REPEAT) && count > 1 && 1 + csiCost(count - 1) + after < best)
+    {
+        best = 1 + csiCost(count - 1) + after;
+        how = REPEAT;
+    }
+    if (encoderFeatures & ENCODE_ERASE)
+    {
+        if (csiCost(count) + stay < best)
+        {
+            best = csiCost(count) + stay;
+            how = ERASE_CHARS;
+        }
+        // Frame goes up to the right edge of the terminal, so does EL
+        if (end == frame->width && (int)sizeof(ESC_CLEAR_LINE) - 1 < best)
+            how = ERASE_LINE;
+    }
+
+    switch (how)
+    {
+        case REPEAT:
+            obPutc(cur->ob, ' ');
+            putCsi(cur->ob, count - 1, 'b');
+            advance(cur, count);
+            break;
+        case ERASE_CHARS:
+            putCsi(cur->ob, count, 'X');
+            break;
+        case ERASE_LINE:
+            obPuts(cur->ob, ESC_CLEAR_LINE);
+            break;
+        default:
+            for (int i = 0; i < count; i++)
+                obPutc(cur->ob, ' ');
+            advance(cur, count);
+            break;
+    }
+    return last + 1;
+}
+
+// Changed glyph at x, identical ones right after it go out as REP. Returns the column after them
+static int encodeGlyphs(Cursor *cur, const Frame *prev, int x, int y)
+{
+    const Frame *frame = cur->frame;
+    const Cell *cell = frameCell(frame, x, y);
+
+    writeCell(cur, cell);
+    if (!(encoderFeatures & ENCODE_REPEAT))
+        return x + 1;
+
+    int end = x + 1;
+    int last = x;
+    while (end < frame->width && sameCell(frameCell(frame, end, y), cell))
+    {
+        if (!sameCell(frameCell(frame, end, y), frameCell(prev, end, y)))
+            last = end;
+        end++;
+    }
+
+    int count = last - x;
+    if (count == 0 || csiCost(count) >= count * glyphBytes(cellGlyph(cell, cur->debugMode)))
+        return x + 1;
+
+    putCsi(cur->ob, count, 'b');
+    advance(cur, count);
+    return last + 1;
+}
+
+void encodeFrameDiff(OutBuf *ob, const Frame *frame, const Frame *prev, int originRow, bool debugMode)
+{
+    // Pen is reset between frames, cursor is anywhere
+    Cursor cur = { ob, frame, originRow, debugMode, -1, -1, PEN_DEFAULT };
+
+    for (int y = 0; y < frame->height; y++)
+    {
+        int x = nextChange(frame, prev, y, 0);
+        while (x < frame->width)
+        {
+            moveCursor(&cur, x, y);
+            if (!debugMode && blankCell(frameCell(frame, x, y)))
+                x = encodeBlanks(&cur, prev, x, y);
+            else
+                x = encodeGlyphs(&cur, prev, x, y);
+            x = nextChange(frame, prev, y, x);
+        }
+    }
+
+    if (cur.pen != PEN_DEFAULT)
+        obPuts(ob, ANSI_COLOR_RESET);
+}
+
+void encodeUpdate(OutBuf *ob, const Frame *frame, Frame *shown, int renderer, int originRow, bool debugMode)
+{
+    bool known = shown->cells != NULL && shown->width == frame->width && shown->height == frame->height;
+
+    TRACE_BEGIN("encode");
+
+    if (renderer == RENDERER_DIFF && known)
+        encodeFrameDiff(ob, frame, shown, originRow, debugMode);
+    else
+        encodeFrame(ob, frame, debugMode);
+
+    copyFrame(shown, frame);
+    TRACE_END("encode");
+}
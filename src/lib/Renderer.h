@@ -0,0 +1,73 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <stdbool.h>
+
+#include "Frame.h"
+#include "Output.h"
+
+// How the frame is produced from the panes and encoded
+enum {
+    RENDERER_SCAN = 0, // per cell scan of all drops and full repaint, the original way
+    RENDERER_FULL,     // drops stamped into the frame and full repaint
+    RENDERER_DIFF,     // only cells that differ from what is on the screen
+    NUM_RENDERERS
+};
+
+// Supported color depths
+enum {
+    COLORS_16 = 16,
+    COLORS_256 = 256,
+    COLORS_TRUE = 24
+};
+
+// Sequences the diff encoder may use besides cursor moves, not every terminal has them
+enum {
+    ENCODE_ERASE = 1,  // ECH and EL for runs of blanks (VT220 and anything newer)
+    ENCODE_REPEAT = 2  // REP for runs of the same glyph (ECMA-48, xterm and most newer terminals)
+};
+
+// Return RENDERER_* for the name, -1 if unknown
+int findRenderer(const char *name);
+
+const char* rendererName(int renderer);
+
+// Return COLORS_* for "16", "256" or "truecolor", -1 if unknown
+int parseColorDepth(const char *name);
+
+const char* colorDepthName(int depth);
+
+void setColorDepth(int depth);
+
+int currentColorDepth();
+
+// ENCODE_* flags of the diff encoder, shared by all frames like the palette
+void setEncoderFeatures(int features);
+
+int currentEncoderFeatures();
+
+// Clear the frame and compose all panes into it
+void composePanes(Frame *frame, const Viewport *panes, int numPanes, int renderer);
+
+// Move cursor back to the top left corner
+void encodeHome(OutBuf *ob);
+
+// Full repaint of the frame, line by line starting from top (cursor must be at top left)
+void encodeFrame(OutBuf *ob, const Frame *frame, bool debugMode);
+
+/**
+ * Only the cells that differ from prev, each gap crossed the cheapest way (see planMove),
+ * runs of blanks and repeated glyphs with ECH/EL/REP as the features allow. Colors are
+ * set only when they change and reset at the end. Frame's first line is at terminal row
+ * originRow, the frame has to reach the right edge of the terminal (EL erases up to it).
+ */
+void encodeFrameDiff(OutBuf *ob, const Frame *frame, const Frame *prev, int originRow, bool debugMode);
+
+/**
+ * Encode frame with the given renderer. shown is what the terminal has on the screen,
+ * it is updated to frame afterwards (empty shown means unknown, then it is a full repaint).
+ * For full repaint the cursor must already be at the start of originRow.
+ */
+void encodeUpdate(OutBuf *ob, const Frame *frame, Frame *shown, int renderer, int originRow, bool debugMode);
+
+#endif
@@ -0,0 +1,93 @@
+#include <string.h>
+
+#include "Reveal.h"
+#include "Memory.h"
+
+void initReveal(Reveal *r, Mask *source)
+{
+    memset(r, 0, sizeof(*r));
+    r->source = *source;
+    memset(source, 0, sizeof(*source));
+}
+
+void freeReveal(Reveal *r)
+{
+    freeMask(&r->source);
+    freeMask(&r->mask);
+    freeMask(&r->revealed);
+    memFree(r->glyphs);
+    r->glyphs = NULL;
+}
+
+void fitReveal(Reveal *r, int width, int height)
+{
+    if (r->glyphs != NULL && r->mask.width == width && r->mask.height == height)
+        return;
+
+    freeMask(&r->mask);
+    freeMask(&r->revealed);
+    memFree(r->glyphs);
+    r->glyphs = NULL;
+
+    scaleMask(&r->mask, &r->source, width, height);
+    initMask(&r->revealed, width, height);
+    r->glyphs = memAlloc(((size_t)width * height + 1) * sizeof(int));
+}
+
+void resetReveal(Reveal *r)
+{
+    if (r->revealed.bits != NULL)
+        clearMask(&r->revealed);
+}
+
+void markReveal(Reveal *r, const Viewport *vp)
+{
+    if (r->glyphs == NULL)
+        return;
+
+    int width = vp->columns;
+    int depth = vp->rows - vp->paddingBottom;
+
+    for (int i = 0; i < vp->numDrops; i++)
+    {
+        int x = vp->drops[i].x;
+        int y = vp->drops[i].y;
+        if (x < 0 || y < 0 || x >= width || y >= depth)
+            continue;
+
+        x += vp->paddingLeft;
+        y += vp->paddingTop;
+        if (x >= r->mask.width || y >= r->mask.height)
+            continue;
+
+        if (maskBit(&r->mask, x, y) && !maskBit(&r->revealed, x, y))
+        {
+            setMaskBit(&r->revealed, x, y);
+            r->glyphs[y * r->mask.width + x] = vp->drops[i].c;
+        }
+    }
+}
+
+void drawReveal(const Reveal *r, Frame *frame)
+{
+    if (r->glyphs == NULL || frame->width != r->revealed.width || frame->height != r->revealed.height)
+        return;
+
+    // Empty words skip 64 cells at once, set bits are picked out lowest first
+    for (int y = 0; y < r->revealed.height; y++)
+    {
+        const uint64_t *row = maskRow(&r->revealed, y);
+        const int *glyphs = r->glyphs + (size_t)y * frame->width;
+
+        for (int w = 0; w < r->revealed.words; w++)
+        {
+            uint64_t bits = row[w];
+            while (bits)
+            {
+                int x = w * 64 + __builtin_ctzll(bits);
+                *frameCell(frame, x, y) = (Cell){ glyphs[x], STYLE_REVEAL };
+                bits &= bits - 1;
+            }
+        }
+    }
+}
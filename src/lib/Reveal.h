@@ -0,0 +1,35 @@
+#ifndef REVEAL_H
+#define REVEAL_H
+
+#include "Mask.h"
+#include "Frame.h"
+
+/**
+ * Hidden image or text the rain uncovers: a drop head passing over a cell of the mask
+ * leaves its glyph there, highlighted, until the rain starts over.
+ */
+typedef struct {
+    Mask source;   // image as loaded, any size
+    Mask mask;     // source fitted to the frame
+    Mask revealed; // cells of the mask a drop went over
+    int *glyphs;   // glyph left in every revealed cell
+} Reveal;
+
+// Reveal takes the source over, it is freed with the reveal
+void initReveal(Reveal *r, Mask *source);
+
+void freeReveal(Reveal *r);
+
+// Fit the mask to a new frame size, what was revealed is forgotten
+void fitReveal(Reveal *r, int width, int height);
+
+// Start over, nothing revealed
+void resetReveal(Reveal *r);
+
+// Drop heads of the pane that are over the mask reveal their cell
+void markReveal(Reveal *r, const Viewport *vp);
+
+// Revealed cells on top of the composed frame (same size the reveal was fitted to)
+void drawReveal(const Reveal *r, Frame *frame);
+
+#endif
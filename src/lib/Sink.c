@@ -0,0 +1,207 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+
+#include "Sink.h"
+#include "Trace.h"
+
+#define SINK_ABORT_BYTES 64 // most bytes sinkAbort still writes, blocking
+
+void obPrintf(OutBuf *ob, const char *fmt, ...)
+{
+    va_list args;
+
+    va_start(args, fmt);
+    int n = vsnprintf(NULL, 0, fmt, args);
+    va_end(args);
+    if (n <= 0)
+        return;
+
+    obReserve(ob, (size_t)n + 1);
+    va_start(args, fmt);
+    vsnprintf(ob->data + ob->len, (size_t)n + 1, fmt, args);
+    va_end(args);
+    ob->len += n;
+}
+
+int obFlush(OutBuf *ob, int fd)
+{
+    size_t done = 0;
+    while (done < ob->len)
+    {
+        ssize_t n = write(fd, ob->data + done, ob->len - done);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        done += (size_t)n;
+    }
+    ob->len = 0;
+    return 0;
+}
+
+void sinkOpen(OutputSink *sink, int fd, long long maxBandwidth)
+{
+    memset(sink, 0, sizeof(*sink));
+    sink->fd = fd;
+    sink->maxBandwidth = maxBandwidth;
+    sink->savedFlags = -1;
+
+    if (fd >= 0)
+    {
+        sink->savedFlags = fcntl(fd, F_GETFL);
+        if (sink->savedFlags >= 0)
+            fcntl(fd, F_SETFL, sink->savedFlags | O_NONBLOCK);
+    }
+}
+
+void sinkClose(OutputSink *sink)
+{
+    if (sink->fd >= 0 && sink->savedFlags >= 0)
+        fcntl(sink->fd, F_SETFL, sink->savedFlags);
+    obFree(&sink->pending);
+    sink->sent = 0;
+}
+
+bool sinkReady(const OutputSink *sink)
+{
+    return sink->sent >= sink->pending.len;
+}
+
+void sinkSubmit(OutputSink *sink, OutBuf *ob, long long now)
+{
+    // Swap buffers, this way neither one is ever reallocated in steady state
+    OutBuf tmp = sink->pending;
+    sink->pending = *ob;
+    *ob = tmp;
+    obReset(ob);
+
+    sink->sent = 0;
+    sink->framesSent++;
+    sinkPump(sink, now);
+}
+
+void sinkReserve(OutputSink *sink, OutBuf *ob, size_t bytes)
+{
+    if (ob->cap < bytes)
+        obReserve(ob, bytes - ob->len);
+    if (sink->pending.cap < bytes)
+        obReserve(&sink->pending, bytes - sink->pending.len);
+}
+
+// Refill the token bucket, at most 100ms worth of bytes is kept
+static size_t allowedBytes(OutputSink *sink, long long now)
+{
+    if (sink->maxBandwidth <= 0)
+        return (size_t)-1;
+
+    if (sink->lastPump == 0)
+        sink->lastPump = now;
+
+    double burst = sink->maxBandwidth / 10.0;
+    if (burst < 1) burst = 1;
+
+    sink->budget += (double)(now - sink->lastPump) * sink->maxBandwidth / 1000.0;
+    if (sink->budget > burst)
+        sink->budget = burst;
+    sink->lastPump = now;
+
+    return sink->budget >= 1 ? (size_t)sink->budget : 0;
+}
+
+// Nothing will ever take the rest, pending would keep poll reporting the fd forever
+static void dropPending(OutputSink *sink)
+{
+    sink->sent = 0;
+    obReset(&sink->pending);
+}
+
+size_t sinkPump(OutputSink *sink, long long now)
+{
+    if (sink->error != 0)
+    {
+        dropPending(sink);
+        return 0;
+    }
+
+    size_t allowed = allowedBytes(sink, now);
+    if (sink->sent >= sink->pending.len || allowed == 0)
+        return sink->pending.len - sink->sent;
+
+    TRACE_BEGIN("flush");
+    while (sink->sent < sink->pending.len && allowed > 0)
+    {
+        size_t chunk = sink->pending.len - sink->sent;
+        if (chunk > allowed)
+            chunk = allowed;
+
+        ssize_t n = (ssize_t)chunk;
+        if (sink->fd >= 0)
+        {
+            n = write(sink->fd, sink->pending.data + sink->sent, chunk);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                {
+                    sink->stalls++;
+                    break;
+                }
+                sink->error = errno;
+                dropPending(sink);
+                break;
+            }
+        }
+
+        sink->sent += (size_t)n;
+        sink->bytesWritten += n;
+        allowed -= (size_t)n;
+        if (sink->maxBandwidth > 0)
+            sink->budget -= n;
+    }
+    TRACE_END("flush");
+
+    return sink->pending.len - sink->sent;
+}
+
+void sinkAbort(OutputSink *sink)
+{
+    if (sinkReady(sink))
+        return;
+
+    // Up to the next escape, that is the rest of one cell or a run of them (ECH, REP, blanks).
+    // Never more than SINK_ABORT_BYTES on a slow link, a sequence cut after that is cancelled
+    // by restoreTerminal. A glyph is not cut in half
+    size_t end = sink->sent;
+    size_t cap = sink->sent + SINK_ABORT_BYTES;
+    while (end < sink->pending.len && end < cap && sink->pending.data[end] != '\x1b')
+        end++;
+    while (end > sink->sent && end < sink->pending.len && (sink->pending.data[end] & 0xC0) == 0x80)
+        end--;
+
+    if (sink->fd >= 0)
+    {
+        if (sink->savedFlags >= 0)
+            fcntl(sink->fd, F_SETFL, sink->savedFlags);
+
+        while (sink->sent < end)
+        {
+            ssize_t n = write(sink->fd, sink->pending.data + sink->sent, end - sink->sent);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                break;
+            sink->sent += (size_t)n;
+        }
+    }
+
+    sink->sent = 0;
+    obReset(&sink->pending);
+}
@@ -0,0 +1,62 @@
+#ifndef SINK_H
+#define SINK_H
+
+#include <stdbool.h>
+
+#include "Output.h"
+
+// The app's side of Output.h: formatting and writing to file descriptors, librain has neither
+
+void obPrintf(OutBuf *ob, const char *fmt, ...);
+
+// Write everything to the file descriptor and empty the buffer, returns -1 on error
+int obFlush(OutBuf *ob, int fd);
+
+/**
+ * Non blocking frame output. One frame is draining at a time, while it is
+ * the caller should not encode new frames (simulation keeps going, frames
+ * are dropped) and send one coalesced update once the sink is ready again.
+ * With fd -1 bytes are just thrown away at the bandwidth rate, which
+ * emulates a slow link in bench.
+ */
+typedef struct {
+    int fd;
+    int savedFlags;
+    OutBuf pending;        // frame currently draining
+    size_t sent;           // how much of it is already written
+    long long maxBandwidth; // bytes per second, 0 = unlimited
+    double budget;         // bytes we may still send in this moment
+    long long lastPump;    // ms of the last budget refill
+    long long bytesWritten;
+    long long framesSent;
+    long long framesDropped;
+    long long stalls;      // writes that hit EAGAIN
+    int error;             // errno of a write that failed for good (EIO, EPIPE), 0 while the fd works
+} OutputSink;
+
+void sinkOpen(OutputSink *sink, int fd, long long maxBandwidth);
+
+// Restore the fd flags and free the buffer, whatever is still pending is lost
+void sinkClose(OutputSink *sink);
+
+// True if previous frame is fully written and a new one can be submitted
+bool sinkReady(const OutputSink *sink);
+
+// Hand over encoded frame (buffers are swapped, ob is empty afterwards)
+void sinkSubmit(OutputSink *sink, OutBuf *ob, long long now);
+
+// Room for frames of up to bytes in ob and in the one draining, frames that size never allocate
+void sinkReserve(OutputSink *sink, OutBuf *ob, size_t bytes);
+
+/**
+ * Write as much of the pending frame as the link takes, returns bytes still pending.
+ * A write that fails for good drops the frame and sets error, the sink is ready again
+ * so nobody waits for it and the caller should stop like the terminal was gone.
+ */
+size_t sinkPump(OutputSink *sink, long long now);
+
+// Stop draining as soon as possible, finishing at most a few bytes of the current cell
+// (an escape sequence cut after that needs the CAN restoreTerminal sends)
+void sinkAbort(OutputSink *sink);
+
+#endif
@@ -0,0 +1,200 @@
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "Soak.h"
+#include "Renderer.h"
+#include "Memory.h"
+#include "Trace.h"
+
+#define SOAK_WARMUP 100                // frames after the start and after every reset that may still allocate
+#define SOAK_SAMPLE_FRAMES 1000        // RSS is read this often
+#define SOAK_RSS_SLACK (1024 * 1024)   // malloc may keep a little more around than at the first sample
+#define SOAK_REPORT_MILLIS (60 * 1000) // progress on stderr, soaks run for hours
+
+static volatile sig_atomic_t soakStop = 0;
+
+static void stopSoak(int sig)
+{
+    (void)sig;
+    soakStop = 1;
+}
+
+static long long soakMillis()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Resident set size in bytes, read without stdio so the sampling itself doesn't allocate
+static long long residentBytes()
+{
+    char text[128];
+    int fd = open("/proc/self/statm", O_RDONLY);
+    if (fd < 0)
+        return 0;
+    ssize_t n = read(fd, text, sizeof(text) - 1);
+    close(fd);
+    if (n <= 0)
+        return 0;
+    text[n] = 0;
+
+    long long size, resident;
+    if (sscanf(text, "%lld %lld", &size, &resident) != 2)
+        return 0;
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+static inline long long liveAllocations()
+{
+    return allocStats.allocs - allocStats.frees;
+}
+
+int runSoak(Engine *e, const SoakOptions *opts)
+{
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = stopSoak;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    if (opts->seconds > 0)
+        fprintf(stderr, "soak: %dx%d for %lld s, Ctrl-C stops it early\n", opts->columns, opts->rows, opts->seconds);
+    else
+        fprintf(stderr, "soak: %dx%d for %lld frames, Ctrl-C stops it early\n", opts->columns, opts->rows, opts->cycles);
+
+    OutBuf ob = { 0 };
+    long long start = soakMillis();
+    long long lastReport = start;
+    long long clock = 0; // simulation time, it jumps from one due step to the next
+    long long due = 0;
+    long long frame = 0;
+    long long resets = 0;
+    int settle = SOAK_WARMUP;    // frames until the next steady state
+    long long allocatingFrames = 0; // steady frames that allocated
+    long long firstAllocating = -1;
+    long long steadyAllocs = 0;
+    long long liveBase = -1;     // live allocations when the rain first settled
+    long long liveLeaks = 0;     // resets after which they didn't come back there
+    long long rssBase = -1;      // RSS when the rain first settled
+    long long rssPeak = 0;
+
+    freeFrame(&e->shown);
+    for (; !soakStop; frame++)
+    {
+        if (opts->cycles > 0 && frame >= opts->cycles)
+            break;
+        if (opts->seconds > 0 && (frame & 63) == 0 && soakMillis() - start >= opts->seconds * 1000)
+            break;
+
+        if (opts->reset != NULL && opts->resetEvery > 0 && frame > 0 && frame % opts->resetEvery == 0)
+        {
+            // Like the 'r' key: rain starts over and the screen is cleared
+            opts->reset();
+            freeFrame(&e->shown);
+            resets++;
+            settle = SOAK_WARMUP;
+        }
+
+        long long before = allocStats.allocs;
+        TRACE_BEGIN("frame");
+        if (opts->update != NULL)
+            opts->update();
+        clock = due;
+        due = tickEngine(e, clock, false);
+        composeEngine(e, opts->columns, opts->rows);
+        encodeHome(&ob);
+        encodeEngine(e, &ob, 0, false);
+        obReset(&ob);
+        TRACE_END("frame");
+        long long allocated = allocStats.allocs - before;
+
+        if (settle > 0)
+        {
+            // From here on nothing may allocate, and what the warmup left alive is the level to come back to
+            if (--settle == 0)
+            {
+                if (liveBase < 0)
+                {
+                    liveBase = liveAllocations();
+                    rssBase = residentBytes();
+                    rssPeak = rssBase;
+                }
+                else if (liveAllocations() != liveBase)
+                    liveLeaks++;
+            }
+        }
+        else if (allocated > 0)
+        {
+            if (allocatingFrames++ == 0)
+                firstAllocating = frame;
+            steadyAllocs += allocated;
+        }
+
+        if (rssBase >= 0 && frame % SOAK_SAMPLE_FRAMES == 0)
+        {
+            long long rss = residentBytes();
+            if (rss > rssPeak)
+                rssPeak = rss;
+
+            long long now = soakMillis();
+            if (now - lastReport >= SOAK_REPORT_MILLIS)
+            {
+                fprintf(stderr, "soak: %lld frames, %lld s, rss %lld KiB, live allocations %lld\n",
+                    frame, (now - start) / 1000, rss / 1024, liveAllocations());
+                lastReport = now;
+            }
+        }
+    }
+    long long elapsed = soakMillis() - start;
+    long long rssEnd = residentBytes();
+    long long liveEnd = liveAllocations(); // the output buffer was alive at the base too
+    obFree(&ob);
+    if (rssEnd > rssPeak)
+        rssPeak = rssEnd;
+
+    printf("soak: %lld frames in %.1f s (%.0f frames/s), %dx%d, %lld resets\n",
+        frame, elapsed / 1000.0, elapsed > 0 ? frame * 1000.0 / elapsed : 0, opts->columns, opts->rows, resets);
+    printf("soak: allocations %lld, frees %lld, live %lld after warmup, %lld at the end\n",
+        allocStats.allocs, allocStats.frees, liveBase, liveEnd);
+    printf("soak: steady frames that allocated %lld (%lld allocations)", allocatingFrames, steadyAllocs);
+    if (firstAllocating >= 0)
+        printf(", first at frame %lld", firstAllocating);
+    printf("\n");
+    printf("soak: rss %lld KiB after warmup, peak %lld KiB, %lld KiB at the end\n",
+        rssBase / 1024, rssPeak / 1024, rssEnd / 1024);
+
+    if (rssBase < 0)
+    {
+        printf("soak: FAILED, stopped before the rain settled (%d frames)\n", SOAK_WARMUP);
+        return 1;
+    }
+
+    // Live allocations only count when the rain is settled, right after a reset they are still changing
+    if (settle == 0 && liveEnd != liveBase)
+        liveLeaks++;
+
+    bool failed = false;
+    if (allocatingFrames > 0)
+    {
+        printf("soak: FAILED, steady frames allocate\n");
+        failed = true;
+    }
+    if (liveLeaks > 0)
+    {
+        printf("soak: FAILED, live allocations didn't come back %lld times, something leaks\n", liveLeaks);
+        failed = true;
+    }
+    if (rssEnd > rssBase + SOAK_RSS_SLACK)
+    {
+        printf("soak: FAILED, rss grew by %lld KiB\n", (rssEnd - rssBase) / 1024);
+        failed = true;
+    }
+    if (!failed)
+        printf("soak: ok\n");
+    return failed ? 1 : 0;
+}
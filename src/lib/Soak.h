@@ -0,0 +1,26 @@
+#ifndef SOAK_H
+#define SOAK_H
+
+#include "Engine.h"
+
+typedef struct {
+    long long cycles;     // frames to run, 0 = only the duration counts
+    long long seconds;    // wall time to run, 0 = only the cycles count
+    int columns;          // frame size in cells
+    int rows;
+    int resetEvery;       // frames between resets ('r'), 0 = never
+    void (*reset)(void);  // starts the rain over like the 'r' key, NULL if not possible
+    void (*update)(void); // called before every frame (clock, header), NULL if nothing changes
+} SoakOptions;
+
+/**
+ * Run the engine headless as fast as it goes, every frame composed and encoded (output is
+ * thrown away), and watch the memory: allocations through mem* per frame, live allocations
+ * after every reset and the resident set size. After a short warmup and after every reset
+ * no frame may allocate, live allocations have to come back to where they were and RSS must
+ * not grow. Prints a summary at the end, also when stopped with SIGINT or SIGTERM.
+ * Returns exit code, non zero if memory misbehaved.
+ */
+int runSoak(Engine *e, const SoakOptions *opts);
+
+#endif
@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+
+#include "Stream.h"
+#include "Renderer.h"
+#include "Sink.h"
+#include "Trace.h"
+#include "types/Colors.h"
+#include "types/Escapes.h"
+
+#define STREAM_BLOCK_SIZE (256 * 1024) // unpaced frames are written in blocks of about this much
+
+static long long streamMillis()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void sleepMillis(long long ms)
+{
+    struct timespec ts = { ms / 1000, (ms % 1000) * 1000000 };
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR)
+        ;
+}
+
+static inline void putLittleEndian(unsigned char *p, unsigned int value, int bytes)
+{
+    for (int i = 0; i < bytes; i++)
+    {
+        p[i] = (unsigned char)(value >> (8 * i));
+    }
+}
+
+// Header and every cell of the frame, the same size every frame so readers can simply read that much
+static void putCells(OutBuf *ob, const Frame *frame, unsigned int number)
+{
+    size_t count = (size_t)frame->width * frame->height;
+    obReserve(ob, STREAM_HEADER_SIZE + count * STREAM_CELL_SIZE);
+
+    unsigned char *p = (unsigned char *)ob->data + ob->len;
+    memcpy(p, STREAM_MAGIC, 4);
+    putLittleEndian(p + 4, (unsigned int)frame->width, 2);
+    putLittleEndian(p + 6, (unsigned int)frame->height, 2);
+    putLittleEndian(p + 8, number, 4);
+    p += STREAM_HEADER_SIZE;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const Cell *cell = &frame->cells[i];
+        putLittleEndian(p, (unsigned int)cell->c, 3);
+        p[3] = (unsigned char)(cell->style | cell->bg << 4);
+        p += STREAM_CELL_SIZE;
+    }
+    ob->len = (size_t)(p - (unsigned char *)ob->data);
+}
+
+// Returns false if the reader is gone or writing failed, rc says which
+static bool flushStream(OutBuf *ob, int fd, int *rc)
+{
+    TRACE_BEGIN("write");
+    int result = obFlush(ob, fd);
+    TRACE_END("write");
+    if (result == 0)
+        return true;
+
+    if (errno != EPIPE)
+    {
+        perror("stream");
+        *rc = 1;
+    }
+    return false;
+}
+
+int runStream(Engine *e, const StreamOptions *opts)
+{
+    if (opts->columns < 1 || opts->rows < 1 || opts->columns > 0xFFFF || opts->rows > 0xFFFF)
+    {
+        fprintf(stderr, "stream: bad size %dx%d\n", opts->columns, opts->rows);
+        return 1;
+    }
+
+    // A reader that quits shows up as EPIPE from write instead of killing us
+    signal(SIGPIPE, SIG_IGN);
+
+    if (opts->format == STREAM_CELLS)
+        fprintf(stderr, "stream: %dx%d cells, frames of %d bytes (%d byte header, %d per cell), %s\n",
+            opts->columns, opts->rows, STREAM_HEADER_SIZE + opts->columns * opts->rows * STREAM_CELL_SIZE,
+            STREAM_HEADER_SIZE, STREAM_CELL_SIZE, opts->paced ? "paced" : "unpaced");
+    else
+        fprintf(stderr, "stream: %dx%d ansi, %s\n", opts->columns, opts->rows, opts->paced ? "paced" : "unpaced");
+
+    OutBuf ob = { 0 };
+    int rc = 0;
+    long long clock = 0; // simulation time, like rain_step it jumps from one due step to the next
+    long long due = 0;
+    long long start = streamMillis();
+
+    freeFrame(&e->shown);
+    if (opts->format == STREAM_ANSI)
+        obPuts(&ob, ANSI_COLOR_RESET ESC_CLEAR_SCREEN ESC_CURSOR_HIDE);
+
+    for (long long frame = 0; opts->frames <= 0 || frame < opts->frames; frame++)
+    {
+        TRACE_BEGIN("frame");
+        if (opts->update != NULL)
+            opts->update();
+        clock = due;
+        due = tickEngine(e, clock, false);
+        composeEngine(e, opts->columns, opts->rows);
+
+        if (opts->format == STREAM_CELLS)
+            putCells(&ob, &e->frame, (unsigned int)frame);
+        else
+        {
+            encodeHome(&ob);
+            encodeEngine(e, &ob, 0, false);
+        }
+        TRACE_END("frame");
+
+        // Paced frames go out when they are due, the others wait until there is a block worth a write
+        if ((opts->paced || ob.len >= STREAM_BLOCK_SIZE) && !flushStream(&ob, opts->fd, &rc))
+            break;
+
+        if (opts->paced)
+        {
+            long long late = streamMillis() - (start + due);
+            if (late < 0)
+                sleepMillis(-late);
+            else
+                start += late; // a slow reader doesn't get a burst of frames to catch up
+        }
+    }
+
+    if (opts->format == STREAM_ANSI)
+        obPuts(&ob, ANSI_COLOR_RESET);
+    if (rc == 0)
+        flushStream(&ob, opts->fd, &rc);
+    obFree(&ob);
+    return rc;
+}
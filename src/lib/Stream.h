@@ -0,0 +1,35 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdbool.h>
+
+#include "Engine.h"
+
+enum {
+    STREAM_ANSI = 0, // escape sequences, what a terminal would get
+    STREAM_CELLS     // fixed size frames of cells, for programs that draw them themselves
+};
+
+#define STREAM_MAGIC "RAIN"
+#define STREAM_HEADER_SIZE 12 // magic, columns and rows (u16), frame number (u32), little endian
+#define STREAM_CELL_SIZE 4    // code point (u24), style in the low and background in the high nibble
+
+typedef struct {
+    int format;    // STREAM_*
+    int fd;
+    int columns;   // frame size in cells, there is no terminal to ask
+    int rows;
+    int frames;    // 0 = until the reader goes away
+    bool paced;    // frames at the rain's own speed, otherwise as fast as the reader takes them
+    void (*update)(void); // called before every frame (clock, header), NULL if nothing changes
+} StreamOptions;
+
+/**
+ * Run the engine without a terminal and write every frame to opts->fd, e.g. a pipe or a FIFO.
+ * The caller sets up and starts the panes for the size. Frames are collected and written
+ * in large blocks, paced frames are flushed one by one. Returns exit code, a reader that
+ * closed the pipe is a normal end.
+ */
+int runStream(Engine *e, const StreamOptions *opts);
+
+#endif
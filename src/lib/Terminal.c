@@ -0,0 +1,244 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+
+#include "Terminal.h"
+#include "types/Escapes.h"
+#include "types/Colors.h"
+
+static struct termios savedSettings;
+static int savedInFlags = -1;
+static int savedOutFlags = -1;
+static volatile sig_atomic_t saved = 0;
+static volatile sig_atomic_t altScreen = 0;
+static volatile sig_atomic_t focusReports = 0;
+static volatile sig_atomic_t mouseReports = 0;
+static int resizePipe[2] = { -1, -1 };
+static void (*signalHook)() = NULL;
+
+static void writeAll(const char *s)
+{
+    size_t len = strlen(s);
+    while (len > 0)
+    {
+        ssize_t n = write(STDOUT_FILENO, s, len);
+        if (n <= 0)
+            return;
+        s += n;
+        len -= (size_t)n;
+    }
+}
+
+void restoreTerminal()
+{
+    if (!saved)
+        return;
+
+    // Flags first, so writes below block instead of failing with EAGAIN
+    if (savedInFlags >= 0) fcntl(STDIN_FILENO, F_SETFL, savedInFlags);
+    if (savedOutFlags >= 0) fcntl(STDOUT_FILENO, F_SETFL, savedOutFlags);
+
+    // A frame can be cut anywhere, cancel the half written sequence first
+    writeAll(ESC_CANCEL ESC_SYNC_END ANSI_COLOR_RESET ESC_CURSOR_SHOW);
+    if (focusReports)
+        writeAll(ESC_FOCUS_REPORTS_OFF);
+    focusReports = 0;
+    if (mouseReports)
+        writeAll(ESC_MOUSE_REPORTS_OFF);
+    mouseReports = 0;
+    if (altScreen)
+        writeAll(ESC_ALT_SCREEN_OFF);
+    altScreen = 0;
+
+    if (isatty(STDIN_FILENO))
+        tcsetattr(STDIN_FILENO, TCSANOW, &savedSettings);
+}
+
+static void onSignal(int sig)
+{
+    restoreTerminal();
+    if (signalHook != NULL)
+        signalHook();
+
+    // Die the way the signal wanted
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+void setSignalHook(void (*hook)())
+{
+    signalHook = hook;
+}
+
+void saveTerminal()
+{
+    if (isatty(STDIN_FILENO))
+        tcgetattr(STDIN_FILENO, &savedSettings);
+    savedInFlags = fcntl(STDIN_FILENO, F_GETFL);
+    savedOutFlags = fcntl(STDOUT_FILENO, F_GETFL);
+    saved = 1;
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = onSignal;
+    sigemptyset(&sa.sa_mask);
+
+    const int signals[] = { SIGINT, SIGTERM, SIGHUP, SIGQUIT };
+    for (int i = 0; i < (int)(sizeof(signals) / sizeof(signals[0])); i++)
+    {
+        sigaction(signals[i], &sa, NULL);
+    }
+}
+
+void enterAltScreen()
+{
+    fflush(stdout);
+    writeAll(ESC_ALT_SCREEN_ON ESC_CURSOR_HOME);
+    altScreen = 1;
+}
+
+void leaveAltScreen()
+{
+    fflush(stdout);
+    writeAll(ESC_ALT_SCREEN_OFF);
+    altScreen = 0;
+}
+
+void enableFocusReports()
+{
+    fflush(stdout);
+    writeAll(ESC_FOCUS_REPORTS_ON);
+    focusReports = 1;
+}
+
+void enableMouseReports()
+{
+    fflush(stdout);
+    writeAll(ESC_MOUSE_REPORTS_ON);
+    mouseReports = 1;
+}
+
+static void onResize(int sig)
+{
+    (void)sig;
+    int saved = errno;
+    char c = 0;
+    // Pipe full means a wakeup is already pending, that is enough
+    ssize_t n = write(resizePipe[1], &c, 1);
+    (void)n;
+    errno = saved;
+}
+
+int watchResize()
+{
+    if (resizePipe[0] >= 0)
+        return resizePipe[0];
+    if (pipe(resizePipe) < 0)
+        return -1;
+
+    for (int i = 0; i < 2; i++)
+    {
+        fcntl(resizePipe[i], F_SETFL, fcntl(resizePipe[i], F_GETFL) | O_NONBLOCK);
+        fcntl(resizePipe[i], F_SETFD, FD_CLOEXEC);
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = onResize;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGWINCH, &sa, NULL);
+    return resizePipe[0];
+}
+
+bool takeResize()
+{
+    char buf[64];
+    bool resized = false;
+
+    if (resizePipe[0] < 0)
+        return false;
+    while (read(resizePipe[0], buf, sizeof(buf)) > 0)
+    {
+        resized = true;
+    }
+    return resized;
+}
+
+// Read one byte from stdin, waiting at most timeoutMs, returns -1 on timeout
+static int readByte(int timeoutMs)
+{
+    struct pollfd pfd = { STDIN_FILENO, POLLIN, 0 };
+    if (poll(&pfd, 1, timeoutMs) <= 0)
+        return -1;
+
+    unsigned char c;
+    if (read(STDIN_FILENO, &c, 1) != 1)
+        return -1;
+    return c;
+}
+
+static long long terminalMillis()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void queryTerminalSupport(int timeoutMs, bool *sync, bool *repeat)
+{
+    *sync = false;
+    *repeat = false;
+    if (!isatty(STDIN_FILENO) || !isatty(STDOUT_FILENO))
+        return;
+
+    // A space and REP of it, the cursor ends in column 3 only if REP did something.
+    // Then DECRQM for mode 2026 and device attributes, which every terminal answers last
+    fflush(stdout);
+    writeAll(ESC_CURSOR_HOME " " ESC_CSI "b" ESC_CURSOR_REPORT ESC_CURSOR_HOME
+        ESC_SYNC_QUERY ESC_DEVICE_ATTRIBUTES);
+
+    // Collect one CSI sequence at a time until DA answer arrives, all of them in one timeout
+    long long deadline = terminalMillis() + timeoutMs;
+    char seq[64];
+    int len = 0;
+
+    while (1)
+    {
+        long long left = deadline - terminalMillis();
+        int c = readByte(left > 0 ? (int)left : 0);
+        if (c < 0)
+            break;
+
+        if (c == 0x1b)
+        {
+            len = 0;
+            continue;
+        }
+        if (len < (int)sizeof(seq) - 1)
+            seq[len++] = (char)c;
+        seq[len] = '\0';
+
+        // Final byte of CSI sequence
+        if (len > 1 && c >= 0x40 && c <= 0x7e)
+        {
+            int a, b;
+            if (c == 'R' && sscanf(seq, "[%d;%dR", &a, &b) == 2)
+                *repeat = b == 3;
+            else if (c == 'y' && sscanf(seq, "[?%d;%d$y", &a, &b) == 2 && a == 2026)
+            {
+                // 1 = set, 2 = reset, both mean the terminal knows the mode
+                *sync = (b == 1 || b == 2);
+            }
+            else if (c == 'c')
+                break;
+            len = 0;
+        }
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef TERMINAL_H
+#define TERMINAL_H
+
+#include <stdbool.h>
+
+/**
+ * Remember terminal settings and flags of stdin/stdout as they were at start,
+ * and restore them from SIGINT, SIGTERM, SIGHUP and SIGQUIT handlers
+ * so the shell is never left without echo or on the alternate screen.
+ */
+void saveTerminal();
+
+/**
+ * Put everything back as saveTerminal found it: colors, cursor, main screen,
+ * termios and file flags. Only uses async-signal-safe calls.
+ */
+void restoreTerminal();
+
+// Called from the signal handlers after the terminal is restored, before the process dies
+void setSignalHook(void (*hook)());
+
+void enterAltScreen();
+
+// Terminal reports focus changes (mode 1004) as key input, restoreTerminal turns it off
+void enableFocusReports();
+
+// Terminal reports pointer motion and clicks (SGR mouse) as key input, restoreTerminal turns it off
+void enableMouseReports();
+
+/**
+ * Turn SIGWINCH into a readable fd, so a loop sleeping in poll without timeout
+ * still wakes up on resize. Poll the returned fd for POLLIN, takeResize empties it.
+ */
+int watchResize();
+
+// True if the window was resized since the last call
+bool takeResize();
+
+void leaveAltScreen();
+
+/**
+ * Ask the terminal what it supports, all questions in one write and every answer within
+ * one timeout: synchronized output (DECRQM for mode 2026) and REP (a space and REP of it
+ * at the top left corner, then where the cursor ended). Device attributes are asked last,
+ * every terminal answers them, so we don't wait for the whole timeout.
+ * Input has to be in non-canonical mode already.
+ */
+void queryTerminalSupport(int timeoutMs, bool *sync, bool *repeat);
+
+#endif
@@ -0,0 +1,216 @@
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "Trace.h"
+#include "Memory.h"
+
+#define TRACE_MAX_THREADS 64
+
+typedef struct {
+    const char *name;
+    long long ts; // ns since traceStart
+    char phase;   // 'B' or 'E'
+} TraceEvent;
+
+typedef struct {
+    int tid;
+    const char *name;
+    volatile long long count; // events ever recorded, ring position is count & mask
+    TraceEvent *events;
+} TraceRing;
+
+bool traceEnabled = false;
+
+static long long traceOrigin = 0;
+static long long ringMask = 0;
+static TraceRing rings[TRACE_MAX_THREADS];
+static volatile int numRings = 0;
+static pthread_mutex_t ringLock = PTHREAD_MUTEX_INITIALIZER;
+static __thread TraceRing *ring = NULL;
+
+static long long nowNanos()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void traceStart(int eventsPerThread)
+{
+    long long size = 1;
+    while (size < eventsPerThread)
+        size <<= 1;
+
+    ringMask = size - 1;
+    traceOrigin = nowNanos();
+    traceEnabled = true;
+    traceThread("main");
+}
+
+void traceThread(const char *name)
+{
+    if (!traceEnabled || ring != NULL)
+        return;
+
+    // Allocated outside the lock, running out of memory may jump out of memAlloc (see Rain.c)
+    TraceEvent *events = (TraceEvent *)memAlloc((ringMask + 1) * sizeof(TraceEvent));
+    if (events == NULL)
+        return;
+
+    pthread_mutex_lock(&ringLock);
+    if (numRings < TRACE_MAX_THREADS)
+    {
+        TraceRing *r = &rings[numRings];
+        r->tid = numRings + 1;
+        r->name = name;
+        r->count = 0;
+        r->events = events;
+        ring = r;
+        numRings++; // only now the dump may look at it
+        events = NULL;
+    }
+    pthread_mutex_unlock(&ringLock);
+    memFree(events);
+}
+
+void traceEvent(const char *name, char phase)
+{
+    if (ring == NULL)
+    {
+        traceThread("thread");
+        if (ring == NULL)
+            return; // too many threads, this one is not recorded
+    }
+
+    TraceEvent *e = &ring->events[ring->count & ringMask];
+    e->name = name;
+    e->phase = phase;
+    e->ts = nowNanos() - traceOrigin;
+    ring->count++;
+}
+
+// Dump goes out through this small buffer, no stdio or allocations because of signal handlers
+typedef struct {
+    TraceWriter write;
+    void *user;
+    int len;
+    char data[4096];
+} DumpBuf;
+
+static void dumpFlush(DumpBuf *b)
+{
+    if (b->len > 0)
+        b->write(b->user, b->data, (size_t)b->len);
+    b->len = 0;
+}
+
+static void dumpStr(DumpBuf *b, const char *s)
+{
+    while (*s)
+    {
+        if (b->len == (int)sizeof(b->data))
+            dumpFlush(b);
+        b->data[b->len++] = *s++;
+    }
+}
+
+static void dumpNum(DumpBuf *b, long long v)
+{
+    char digits[24];
+    int n = 0;
+    do
+    {
+        digits[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v > 0);
+
+    char s[24];
+    for (int i = 0; i < n; i++)
+        s[i] = digits[n - 1 - i];
+    s[n] = '\0';
+    dumpStr(b, s);
+}
+
+// Chrome wants microseconds, keep the nanoseconds as fraction
+static void dumpMicros(DumpBuf *b, long long ns)
+{
+    dumpNum(b, ns / 1000);
+    long long frac = ns % 1000;
+    dumpStr(b, frac < 10 ? ".00" : frac < 100 ? ".0" : ".");
+    dumpNum(b, frac);
+}
+
+static void dumpEventHead(DumpBuf *b, bool *first, const char *name, char phase, int tid)
+{
+    char ph[2] = { phase, '\0' };
+    dumpStr(b, *first ? "\n" : ",\n");
+    *first = false;
+    dumpStr(b, "{\"name\":\"");
+    dumpStr(b, name);
+    dumpStr(b, "\",\"ph\":\"");
+    dumpStr(b, ph);
+    dumpStr(b, "\",\"pid\":1,\"tid\":");
+    dumpNum(b, tid);
+}
+
+void traceWrite(TraceWriter write, void *user)
+{
+    DumpBuf b;
+    b.write = write;
+    b.user = user;
+    b.len = 0;
+
+    bool first = true;
+    dumpStr(&b, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+    int n = numRings;
+    for (int r = 0; r < n; r++)
+    {
+        const TraceRing *tr = &rings[r];
+
+        dumpEventHead(&b, &first, "thread_name", 'M', tr->tid);
+        dumpStr(&b, ",\"args\":{\"name\":\"");
+        dumpStr(&b, tr->name);
+        dumpStr(&b, "\"}}");
+
+        long long count = tr->count;
+        long long start = count > ringMask + 1 ? count - (ringMask + 1) : 0;
+        int depth = 0;
+
+        for (long long i = start; i < count; i++)
+        {
+            const TraceEvent *e = &tr->events[i & ringMask];
+
+            // Begin of this one was overwritten already
+            if (e->phase == 'E' && depth == 0)
+                continue;
+            depth += e->phase == 'B' ? 1 : -1;
+
+            dumpEventHead(&b, &first, e->name, e->phase, tr->tid);
+            dumpStr(&b, ",\"ts\":");
+            dumpMicros(&b, e->ts);
+            dumpStr(&b, "}");
+        }
+    }
+
+    dumpStr(&b, "\n]}\n");
+    dumpFlush(&b);
+}
+
+void traceStop()
+{
+    if (!traceEnabled)
+        return;
+
+    traceEnabled = false;
+    pthread_mutex_lock(&ringLock);
+    for (int i = 0; i < numRings; i++)
+    {
+        memFree(rings[i].events);
+        rings[i].events = NULL;
+    }
+    numRings = 0;
+    pthread_mutex_unlock(&ringLock);
+    ring = NULL;
+}
@@ -0,0 +1,41 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Opt-in timeline of frame phases. Every thread records begin/end events into its
+ * own preallocated ring (oldest events are overwritten), so recording costs one clock
+ * read and no locks or allocations. Dump is Chrome trace-event JSON, it opens in
+ * Perfetto (ui.perfetto.dev) or chrome://tracing.
+ * Names must be string literals, only the pointer is stored.
+ */
+
+extern bool traceEnabled;
+
+#define TRACE_BEGIN(name) do { if (traceEnabled) traceEvent(name, 'B'); } while (0)
+#define TRACE_END(name) do { if (traceEnabled) traceEvent(name, 'E'); } while (0)
+
+// Start recording. Events per thread is rounded up to a power of two
+void traceStart(int eventsPerThread);
+
+// Give the calling thread its ring and a name in the timeline. Threads that
+// don't call it get one (named "thread") with their first event
+void traceThread(const char *name);
+
+void traceEvent(const char *name, char phase);
+
+// Gets the dump piece by piece
+typedef void (*TraceWriter)(void *user, const char *data, size_t len);
+
+/**
+ * Hand everything still in the rings to write as JSON. Nothing is allocated or locked,
+ * with an async-signal-safe writer it can run from a signal handler (see TraceFile.h).
+ */
+void traceWrite(TraceWriter write, void *user);
+
+// Stop recording and free the rings, whatever wasn't written is lost
+void traceStop();
+
+#endif
@@ -0,0 +1,69 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+
+#include "TraceFile.h"
+#include "Trace.h"
+
+static const char *tracePath = NULL;
+
+void traceOpen(const char *path, int eventsPerThread)
+{
+    tracePath = path;
+    traceStart(eventsPerThread);
+}
+
+// A short write loses the rest of the piece, the dump is still worth having
+static void writeFd(void *user, const char *data, size_t len)
+{
+    int fd = *(int *)user;
+    size_t done = 0;
+    while (done < len)
+    {
+        ssize_t n = write(fd, data + done, len - done);
+        if (n <= 0)
+            break;
+        done += (size_t)n;
+    }
+}
+
+int traceDump()
+{
+    if (tracePath == NULL)
+        return -1;
+
+    int fd = open(tracePath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return -1;
+    traceWrite(writeFd, &fd);
+    close(fd);
+    return 0;
+}
+
+static void onDumpSignal(int sig)
+{
+    (void)sig;
+    traceDump();
+}
+
+void traceDumpOnSignal(int sig)
+{
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = onDumpSignal;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaction(sig, &sa, NULL);
+}
+
+void traceClose()
+{
+    if (!traceEnabled)
+        return;
+
+    if (traceDump() < 0)
+        perror(tracePath);
+    traceStop();
+}
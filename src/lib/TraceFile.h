@@ -0,0 +1,21 @@
+#ifndef TRACE_FILE_H
+#define TRACE_FILE_H
+
+// Trace dumps to a file, the app's side of Trace.h
+
+// Start recording, path is where dumps go
+void traceOpen(const char *path, int eventsPerThread);
+
+/**
+ * Write everything still in the rings to the trace file. Only async-signal-safe
+ * calls are used, so it can run from a signal handler. Returns -1 on error.
+ */
+int traceDump();
+
+// Dump whenever this signal arrives (e.g. SIGUSR1), recording goes on
+void traceDumpOnSignal(int sig);
+
+// Dump (a failure goes to stderr) and stop recording
+void traceClose();
+
+#endif
@@ -0,0 +1,649 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include "Verify.h"
+#include "Vt.h"
+#include "Viewport.h"
+#include "Frame.h"
+#include "Sink.h"
+#include "Renderer.h"
+#include "Parallax.h"
+#include "Memory.h"
+#include "Graphics.h"
+#include "Reveal.h"
+#include "Overlay.h"
+#include "Font.h"
+#include "types/Colors.h"
+#include "types/Escapes.h"
+
+#define VERIFY_MILLIS 20
+#define VERIFY_CELL_WIDTH 10 // pixels of a terminal cell for the graphics backends
+#define VERIFY_CELL_HEIGHT 20
+#define VERIFY_SINK_BYTES (1 << 20) // more than a pipe holds
+
+typedef struct {
+    int columns;
+    int rows;
+    int numDrops;
+    int colors;
+    int direction;
+    int layers;
+    int frames;
+    bool reveal; // rain uncovers VERIFY_REVEAL_TEXT
+    int subcells; // SUBCELLS_*, rain runs on the finer grid
+    bool overlay; // text boxes over the rain, one of them changing
+} VerifyScenario;
+
+// Scan renderer is slow, so screens stay small. Every direction, color depth, layers, reveal, sub-cells and overlay once
+static const VerifyScenario verifyScenarios[] = {
+    { 80, 24, 220, COLORS_16, 'D', 1, 60, false, SUBCELLS_OFF, false },
+    { 80, 24, 220, COLORS_256, 'U', 1, 60, false, SUBCELLS_OFF, false },
+    { 80, 24, 220, COLORS_TRUE, 'L', 1, 60, false, SUBCELLS_OFF, false },
+    { 80, 24, 220, COLORS_16, 'R', 1, 60, false, SUBCELLS_OFF, false },
+    { 100, 30, 600, COLORS_256, 'D', 1, 40, false, SUBCELLS_OFF, false },
+    { 100, 30, 600, COLORS_256, 'D', 3, 60, false, SUBCELLS_OFF, false },
+    { 80, 24, 400, COLORS_TRUE, 'D', 1, 60, true, SUBCELLS_OFF, false },
+    { 80, 24, 400, COLORS_16, 'R', 3, 60, true, SUBCELLS_OFF, false },
+    { 80, 24, 400, COLORS_256, 'D', 1, 60, true, SUBCELLS_HALF, false },
+    { 80, 24, 800, COLORS_TRUE, 'L', 3, 60, false, SUBCELLS_HALF, false },
+    { 80, 24, 800, COLORS_16, 'D', 1, 60, true, SUBCELLS_BRAILLE, false },
+    { 80, 24, 400, COLORS_256, 'U', 1, 60, false, SUBCELLS_OFF, true },
+    { 80, 24, 400, COLORS_TRUE, 'D', 3, 60, false, SUBCELLS_OFF, true },
+};
+
+#define VERIFY_REVEAL_TEXT "Wake up,\nNeo..."
+#define VERIFY_OVERLAY_TEXT "Knock, knock,\nNeo."
+
+// Graphics backends draw pixels, their screens are compared with the rasterized frame
+static const VerifyScenario graphicsScenarios[] = {
+    { 48, 12, 120, COLORS_16, 'D', 1, 30, false, SUBCELLS_OFF, false },
+    { 48, 12, 120, COLORS_16, 'L', 3, 30, false, SUBCELLS_OFF, false },
+};
+static const int graphicsProtocols[] = { GRAPHICS_SIXEL, GRAPHICS_KITTY };
+
+// Diff encoder with every optional sequence and without any, like a plain VT100
+static const int encoderVariants[] = { ENCODE_ERASE | ENCODE_REPEAT, 0 };
+
+// Wrapping drops have to keep changing lanes, also with every lane at its share or its cap
+typedef struct {
+    int columns;
+    int rows;
+    int numDrops;
+    int maxPerLane; // column-drops, 0 = no cap
+    int direction;
+} SpreadScenario;
+
+static const SpreadScenario spreadScenarios[] = {
+    { 80, 24, 80, 0, 'D' },
+    { 80, 24, 160, 0, 'U' },
+    { 80, 24, 240, 0, 'L' },
+    { 80, 24, 220, 1, 'D' },
+    { 80, 24, 220, 2, 'R' },
+};
+#define SPREAD_WRAPS 20 // times every drop wraps, one that never changed lane by then is stuck
+
+typedef struct {
+    int numDrops;   // after the cap
+    int limit;      // most drops a lane may hold
+    int fullest;    // most drops seen in one lane
+    long long wraps;
+    long long moves; // wraps that came back in another lane
+    int stuck;      // drops that never changed lanes
+} SpreadResult;
+
+// Sixel colors are percentages, a few steps off is still the same color
+#define VERIFY_PIXEL_TOLERANCE 3
+
+#define COUNT(a) (int)(sizeof(a) / sizeof(a[0]))
+
+typedef struct {
+    long long bytes;
+    long long escapes;
+    long long unknown;
+    int badFrames;
+    int firstBad; // frame, -1 if all matched
+    int badX;
+    int badY;
+    VtCell expected;
+    VtCell got;
+} VerifyResult;
+
+static const char* directionName(int direction)
+{
+    switch (direction)
+    {
+        case 'U': return "up";
+        case 'L': return "left";
+        case 'R': return "right";
+        default: return "down";
+    }
+}
+
+/**
+ * Run one renderer through the scenario. Frames are sent the same way the interactive
+ * loop does it (sync block, home, update, hidden cursor), half way the screen is cleared
+ * like after a reset. With record the screens are stored, otherwise compared with screens.
+ */
+static void runRenderer(const VerifyScenario *sc, int renderer, unsigned int seed, long long skip,
+    VtCell *screens, bool record, VerifyResult *result)
+{
+    Viewport vp;
+    Parallax parallax;
+    Reveal reveal;
+    Overlay overlay;
+    int counterBox = -1;
+    Frame fine = { 0 };
+    Frame frame = { 0 };
+    Frame shown = { 0 };
+    OutBuf out = { 0 };
+    VtScreen vt;
+    size_t screenCells = (size_t)sc->columns * sc->rows;
+    int sx, sy;
+
+    // Sub-cells (and layers under an overlay) are composed into fine and then go into frame, like the engine does
+    subcellScale(sc->subcells, &sx, &sy);
+    bool layered = sc->layers > 1 && sc->overlay;
+    Frame *target = sc->subcells != SUBCELLS_OFF || layered ? &fine : &frame;
+
+    memset(result, 0, sizeof(*result));
+    result->firstBad = -1;
+
+    srand(seed);
+    srandom(seed);
+    setColorDepth(sc->colors);
+
+    setupViewport(&vp, 0, 0, sc->columns * sx, sc->rows * sy);
+    vp.numDrops = sc->numDrops;
+    vp.millis = VERIFY_MILLIS;
+    setViewportDirection(&vp, sc->direction);
+    initViewport(&vp);
+    // Like the interactive start, by default the screen is full of rain from the first frame
+    if (skip < 0)
+        skip = sc->rows;
+    fastForwardViewport(&vp, skip);
+    if (sc->layers > 1)
+        initParallax(&parallax, &vp, sc->layers, skip);
+
+    if (sc->reveal)
+    {
+        Mask text;
+        rasterizeText(&text, VERIFY_REVEAL_TEXT);
+        initReveal(&reveal, &text);
+        fitReveal(&reveal, vp.columns, vp.rows);
+    }
+
+    if (sc->overlay)
+    {
+        // Header line, a box partly under a higher one, and a counter that changes now and then
+        initOverlay(&overlay);
+        setOverlayText(&overlay, addOverlayBox(&overlay, 0, 0, 1, -1, STYLE_OVERLAY), "verify overlay");
+        setOverlayText(&overlay, addOverlayBox(&overlay, 10, 8, 0, 24, STYLE_OVERLAY), VERIFY_OVERLAY_TEXT);
+        setOverlayText(&overlay, addOverlayBox(&overlay, 20, 9, 2, 0, STYLE_OVERLAY), "[covers]");
+        counterBox = addOverlayBox(&overlay, -12, -1, 0, 0, STYLE_OVERLAY);
+    }
+
+    resizeFrame(&frame, sc->columns, sc->rows);
+    clearFrame(&frame);
+    resizeFrame(target, vp.columns, vp.rows);
+    clearFrame(target);
+    vtInit(&vt, sc->columns, sc->rows);
+
+    for (int f = 0; f < sc->frames; f++)
+    {
+        long long now = (long long)(f + 1) * VERIFY_MILLIS;
+
+        if (sc->layers > 1)
+        {
+            tickParallax(&parallax, now, false);
+            composeParallax(target, &parallax, false);
+        }
+        else
+        {
+            updateViewport(&vp);
+            composePanes(target, &vp, 1, renderer);
+        }
+        // Marked after compose, then the heads uncover their cells the frame after
+        if (sc->reveal)
+        {
+            markReveal(&reveal, &vp);
+            drawReveal(&reveal, target);
+        }
+        if (sc->subcells != SUBCELLS_OFF)
+            packSubcells(&frame, &fine, sc->subcells);
+        else if (layered)
+            copyFrame(&frame, &fine);
+        if (sc->overlay)
+        {
+            char counter[24];
+            snprintf(counter, sizeof(counter), "frame %d", f / 8 * 8);
+            setOverlayText(&overlay, counterBox, counter);
+            drawOverlay(&overlay, &frame);
+        }
+
+        obPuts(&out, ESC_SYNC_BEGIN);
+        if (f == sc->frames / 2)
+        {
+            obPuts(&out, ANSI_COLOR_RESET ESC_CLEAR_SCREEN);
+            freeFrame(&shown);
+        }
+        encodeHome(&out);
+        encodeUpdate(&out, &frame, &shown, renderer, 0, false);
+        obPuts(&out, ESC_CURSOR_HIDE);
+        obPuts(&out, ESC_SYNC_END);
+
+        vtFeed(&vt, out.data, out.len);
+        obReset(&out);
+
+        // A frame left inside the sync block would never be shown
+        if (vt.sync)
+            result->unknown++;
+
+        VtCell *screen = screens + f * screenCells;
+        if (record)
+        {
+            memcpy(screen, vt.cells, screenCells * sizeof(VtCell));
+            continue;
+        }
+
+        for (int i = 0; i < (int)screenCells; i++)
+        {
+            if (vtSameCell(&screen[i], &vt.cells[i]))
+                continue;
+
+            if (result->firstBad < 0)
+            {
+                result->firstBad = f;
+                result->badX = i % sc->columns;
+                result->badY = i / sc->columns;
+                result->expected = screen[i];
+                result->got = vt.cells[i];
+            }
+            result->badFrames++;
+            break;
+        }
+    }
+
+    result->bytes = vt.bytes;
+    result->escapes = vt.escapes;
+    result->unknown += vt.unknown;
+
+    vtFree(&vt);
+    obFree(&out);
+    freeFrame(&fine);
+    freeFrame(&frame);
+    freeFrame(&shown);
+    if (sc->layers > 1)
+        freeParallax(&parallax);
+    if (sc->reveal)
+        freeReveal(&reveal);
+    freeViewport(&vp);
+    setColorDepth(COLORS_16);
+}
+
+static bool samePixel(const unsigned char *a, const unsigned char *b)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        if (abs(a[i] - b[i]) > VERIFY_PIXEL_TOLERANCE)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Same frames as runRenderer, but sent as images. After every frame the decoded
+ * pixels have to match the frame rasterized through the same atlas. Sixel never
+ * draws the last line, so that one is left out of the comparison.
+ */
+static void runGraphics(const VerifyScenario *sc, int protocol, unsigned int seed, long long skip, VerifyResult *result)
+{
+    Viewport vp;
+    Parallax parallax;
+    GraphicsOutput g;
+    Frame frame = { 0 };
+    Frame shown = { 0 };
+    OutBuf out = { 0 };
+    VtScreen vt;
+
+    memset(result, 0, sizeof(*result));
+    result->firstBad = -1;
+
+    srand(seed);
+    srandom(seed);
+
+    setupViewport(&vp, 0, 0, sc->columns, sc->rows);
+    vp.numDrops = sc->numDrops;
+    vp.millis = VERIFY_MILLIS;
+    setViewportDirection(&vp, sc->direction);
+    initViewport(&vp);
+    if (skip < 0)
+        skip = sc->rows;
+    fastForwardViewport(&vp, skip);
+    if (sc->layers > 1)
+        initParallax(&parallax, &vp, sc->layers, skip);
+
+    initGraphics(&g, protocol, VERIFY_CELL_WIDTH, VERIFY_CELL_HEIGHT, 2);
+    resizeFrame(&frame, sc->columns, sc->rows);
+    clearFrame(&frame);
+    vtInit(&vt, sc->columns, sc->rows);
+    vtEnablePixels(&vt, g.atlas.tileWidth, g.atlas.tileHeight);
+
+    int width = sc->columns * g.atlas.tileWidth;
+    int height = (protocol == GRAPHICS_SIXEL ? sc->rows - 1 : sc->rows) * g.atlas.tileHeight;
+    unsigned char *expected = (unsigned char *)memAlloc((size_t)sc->columns * g.atlas.tileWidth * sc->rows * g.atlas.tileHeight * 3);
+
+    for (int f = 0; f < sc->frames; f++)
+    {
+        if (sc->layers > 1)
+        {
+            tickParallax(&parallax, (long long)(f + 1) * VERIFY_MILLIS, false);
+            composeParallax(&frame, &parallax, false);
+        }
+        else
+        {
+            updateViewport(&vp);
+            composePanes(&frame, &vp, 1, RENDERER_FULL);
+        }
+
+        obPuts(&out, ESC_SYNC_BEGIN);
+        if (f == sc->frames / 2)
+        {
+            obPuts(&out, ANSI_COLOR_RESET ESC_CLEAR_SCREEN);
+            freeFrame(&shown);
+        }
+        encodeGraphics(&g, &out, &frame, &shown, 0, sc->rows);
+        obPuts(&out, ESC_SYNC_END);
+
+        vtFeed(&vt, out.data, out.len);
+        obReset(&out);
+
+        rasterizeFrame(&g.atlas, &frame, expected);
+        for (int i = 0; i < width * height; i++)
+        {
+            if (samePixel(expected + (size_t)i * 3, vt.pixels + (size_t)i * 3))
+                continue;
+
+            if (result->firstBad < 0)
+            {
+                result->firstBad = f;
+                result->badX = i % width / g.atlas.tileWidth;
+                result->badY = i / width / g.atlas.tileHeight;
+                result->expected = (VtCell){ '#', (unsigned int)(expected[i * 3] << 16 | expected[i * 3 + 1] << 8 | expected[i * 3 + 2]), 0, 0 };
+                const unsigned char *got = vt.pixels + (size_t)i * 3;
+                result->got = (VtCell){ '#', (unsigned int)(got[0] << 16 | got[1] << 8 | got[2]), 0, 0 };
+            }
+            result->badFrames++;
+            break;
+        }
+    }
+
+    result->bytes = vt.bytes;
+    result->escapes = vt.escapes;
+    result->unknown = vt.unknown;
+
+    memFree(expected);
+    vtFree(&vt);
+    obFree(&out);
+    freeFrame(&frame);
+    freeFrame(&shown);
+    freeGraphics(&g);
+    if (sc->layers > 1)
+        freeParallax(&parallax);
+    freeViewport(&vp);
+}
+
+static void runSpread(const SpreadScenario *sc, unsigned int seed, SpreadResult *result)
+{
+    Viewport vp;
+    bool vertical = sc->direction == 'D' || sc->direction == 'U';
+
+    srand(seed);
+    srandom(seed);
+    setupViewport(&vp, 0, 0, sc->columns, sc->rows);
+    vp.numDrops = sc->numDrops;
+    vp.maxPerLane = sc->maxPerLane;
+    setViewportDirection(&vp, sc->direction);
+    initViewport(&vp);
+
+    int lanes = vertical ? vp.columns - vp.paddingRight : vp.rows - vp.paddingBottom;
+    int span = vertical ? vp.rows : vp.columns;
+    int *count = (int *)memCalloc(lanes, sizeof(int));
+    int *lane = (int *)memAlloc(vp.numDrops * sizeof(int));
+    int *pos = (int *)memAlloc(vp.numDrops * sizeof(int));
+    bool *moved = (bool *)memCalloc(vp.numDrops, sizeof(bool));
+
+    memset(result, 0, sizeof(*result));
+    result->numDrops = vp.numDrops;
+    result->limit = vp.numDrops / lanes + 1;
+    if (sc->maxPerLane > 0 && sc->maxPerLane < result->limit)
+        result->limit = sc->maxPerLane;
+
+    for (int i = 0; i < vp.numDrops; i++)
+    {
+        lane[i] = vertical ? vp.drops[i].x : vp.drops[i].y;
+        pos[i] = vertical ? vp.drops[i].y : vp.drops[i].x;
+    }
+
+    for (int frame = 0; frame < SPREAD_WRAPS * (span + 1); frame++)
+    {
+        updateViewport(&vp);
+        memset(count, 0, lanes * sizeof(int));
+        for (int i = 0; i < vp.numDrops; i++)
+        {
+            int l = vertical ? vp.drops[i].x : vp.drops[i].y;
+            int p = vertical ? vp.drops[i].y : vp.drops[i].x;
+
+            // One step a frame, going back means it wrapped
+            bool forward = sc->direction == 'D' || sc->direction == 'R';
+            if (forward ? p < pos[i] : p > pos[i])
+            {
+                result->wraps++;
+                if (l != lane[i])
+                {
+                    result->moves++;
+                    moved[i] = true;
+                }
+            }
+            lane[i] = l;
+            pos[i] = p;
+            if (l >= 0 && l < lanes && ++count[l] > result->fullest)
+                result->fullest = count[l];
+        }
+    }
+
+    for (int i = 0; i < vp.numDrops; i++)
+    {
+        if (!moved[i])
+            result->stuck++;
+    }
+
+    memFree(count);
+    memFree(lane);
+    memFree(pos);
+    memFree(moved);
+    freeViewport(&vp);
+}
+
+/**
+ * The sink on a pipe nobody reads: a full one stalls and keeps the frame, once the read
+ * end is closed the write fails for good and the frame is dropped instead of waited for.
+ * Returns what went wrong, NULL if nothing. SIGPIPE is ignored meanwhile, like stream does
+ */
+static const char* runSinkCheck()
+{
+    int fds[2];
+    struct sigaction ignore, old;
+    OutputSink sink;
+    OutBuf frame = { NULL, 0, 0 };
+    const char *problem = NULL;
+
+    if (pipe(fds) < 0)
+        return strerror(errno);
+    memset(&ignore, 0, sizeof(ignore));
+    ignore.sa_handler = SIG_IGN;
+    sigemptyset(&ignore.sa_mask);
+    sigaction(SIGPIPE, &ignore, &old);
+
+    obReserve(&frame, VERIFY_SINK_BYTES);
+    memset(frame.data, 'x', VERIFY_SINK_BYTES);
+    frame.len = VERIFY_SINK_BYTES;
+
+    sinkOpen(&sink, fds[1], 0);
+    sinkSubmit(&sink, &frame, 0);
+    if (sinkReady(&sink) || sink.stalls == 0 || sink.error != 0)
+        problem = "full pipe didn't stall";
+    else
+    {
+        close(fds[0]);
+        fds[0] = -1;
+        sinkPump(&sink, 1);
+        if (sink.error != EPIPE)
+            problem = "closed pipe wasn't an error";
+        else if (!sinkReady(&sink))
+            problem = "failed frame still pending";
+    }
+
+    sinkClose(&sink);
+    obFree(&frame);
+    if (fds[0] >= 0)
+        close(fds[0]);
+    close(fds[1]);
+    sigaction(SIGPIPE, &old, NULL);
+    return problem;
+}
+
+static void printResult(const char *name, const char *renderer, const VerifyScenario *sc, const VerifyResult *r, bool reference)
+{
+    printf("%-44s %-12s %12.1f %10.1f ", name, renderer, (double)r->bytes / sc->frames, (double)r->escapes / sc->frames);
+
+    if (reference)
+        printf("reference");
+    else if (r->badFrames == 0)
+        printf("ok");
+    else
+        printf("%d frames differ, first %d at %d,%d: '%c' %06x/%06x/%d, expected '%c' %06x/%06x/%d",
+            r->badFrames, r->firstBad, r->badX, r->badY,
+            r->got.c < 0x80 ? r->got.c : '?', r->got.fg & 0xFFFFFF, r->got.bg & 0xFFFFFF, r->got.attrs,
+            r->expected.c < 0x80 ? r->expected.c : '?', r->expected.fg & 0xFFFFFF, r->expected.bg & 0xFFFFFF, r->expected.attrs);
+    if (r->unknown > 0)
+        printf(" (%lld unknown or unfinished sequences)", r->unknown);
+    printf("\n");
+}
+
+int runVerify(unsigned int seed, long long skip)
+{
+    int failed = 0;
+
+    printf("%-44s %-12s %12s %10s %s\n", "scenario", "renderer", "bytes/frame", "esc/frame", "screens");
+
+    for (int s = 0; s < COUNT(verifyScenarios); s++)
+    {
+        const VerifyScenario *sc = &verifyScenarios[s];
+        char name[64];
+        VerifyResult result;
+
+        int len = snprintf(name, sizeof(name), "%dx%d-d%d-c%s-%s", sc->columns, sc->rows, sc->numDrops,
+            colorDepthName(sc->colors), directionName(sc->direction));
+        if (sc->layers > 1)
+            len += snprintf(name + len, sizeof(name) - len, "-layers%d", sc->layers);
+        if (sc->reveal)
+            len += snprintf(name + len, sizeof(name) - len, "-reveal");
+        if (sc->subcells != SUBCELLS_OFF)
+            len += snprintf(name + len, sizeof(name) - len, "-%s", sc->subcells == SUBCELLS_HALF ? "half" : "braille");
+        if (sc->overlay)
+            snprintf(name + len, sizeof(name) - len, "-overlay");
+
+        // Layers have their own compositor, scan has nothing to compare there
+        int reference = sc->layers > 1 ? RENDERER_FULL : RENDERER_SCAN;
+        VtCell *screens = (VtCell *)memAlloc((size_t)sc->frames * sc->columns * sc->rows * sizeof(VtCell));
+
+        runRenderer(sc, reference, seed, skip, screens, true, &result);
+        printResult(name, rendererName(reference), sc, &result, true);
+        if (result.unknown > 0)
+            failed++;
+
+        for (int renderer = reference + 1; renderer < NUM_RENDERERS; renderer++)
+        {
+            // Full repaint doesn't use the optional sequences
+            int variants = renderer == RENDERER_FULL ? 1 : COUNT(encoderVariants);
+            for (int v = 0; v < variants; v++)
+            {
+                char label[16];
+                snprintf(label, sizeof(label), "%s%s", rendererName(renderer), v > 0 ? "-vt100" : "");
+                setEncoderFeatures(encoderVariants[v]);
+                runRenderer(sc, renderer, seed, skip, screens, false, &result);
+                printResult("", label, sc, &result, false);
+                if (result.badFrames > 0 || result.unknown > 0)
+                    failed++;
+            }
+            setEncoderFeatures(encoderVariants[0]);
+        }
+        memFree(screens);
+    }
+
+    for (int s = 0; s < COUNT(graphicsScenarios); s++)
+    {
+        const VerifyScenario *sc = &graphicsScenarios[s];
+        char name[64];
+        VerifyResult result;
+
+        int len = snprintf(name, sizeof(name), "%dx%d-d%d-%s-px%dx%d", sc->columns, sc->rows, sc->numDrops,
+            directionName(sc->direction), VERIFY_CELL_WIDTH, VERIFY_CELL_HEIGHT);
+        if (sc->layers > 1)
+            snprintf(name + len, sizeof(name) - len, "-layers%d", sc->layers);
+
+        for (int i = 0; i < COUNT(graphicsProtocols); i++)
+        {
+            runGraphics(sc, graphicsProtocols[i], seed, skip, &result);
+            printResult(i == 0 ? name : "", graphicsName(graphicsProtocols[i]), sc, &result, false);
+            if (result.badFrames > 0 || result.unknown > 0)
+                failed++;
+        }
+    }
+
+    printf("\n%-44s %8s %8s %8s %8s %s\n", "lanes", "drops", "fullest", "wraps", "moved", "spread");
+    for (int s = 0; s < COUNT(spreadScenarios); s++)
+    {
+        const SpreadScenario *sc = &spreadScenarios[s];
+        char name[64];
+        SpreadResult result;
+
+        int len = snprintf(name, sizeof(name), "%dx%d-d%d-%s", sc->columns, sc->rows, sc->numDrops, directionName(sc->direction));
+        if (sc->maxPerLane > 0)
+            snprintf(name + len, sizeof(name) - len, "-column-drops%d", sc->maxPerLane);
+
+        runSpread(sc, seed, &result);
+        printf("%-44s %8d %8d %8lld %7.1f%% ", name, result.numDrops, result.fullest, result.wraps,
+            result.wraps > 0 ? result.moves * 100.0 / result.wraps : 0);
+        if (result.fullest > result.limit)
+        {
+            printf("a lane holds %d drops, at most %d allowed\n", result.fullest, result.limit);
+            failed++;
+        }
+        else if (result.stuck > 0)
+        {
+            printf("%d drops never changed lanes\n", result.stuck);
+            failed++;
+        }
+        else
+            printf("ok\n");
+    }
+
+    const char *problem = runSinkCheck();
+    printf("\n%-44s %s\n", "sink", "result");
+    printf("%-44s %s\n", "pipe-full-then-closed", problem != NULL ? problem : "ok");
+    if (problem != NULL)
+        failed++;
+
+    if (failed > 0)
+    {
+        printf("verify: %d renderer runs, lane or sink checks failed\n", failed);
+        return 1;
+    }
+    printf("verify: all renderers match the reference\n");
+    return 0;
+}
@@ -0,0 +1,14 @@
+#ifndef VERIFY_H
+#define VERIFY_H
+
+/**
+ * Differential check of the renderers. Every scenario is simulated with the same seed
+ * once per renderer, the output is replayed on an in-process VT screen and after every
+ * frame the screen must be identical to the one of the reference renderer (scan, or full
+ * where scan has no equivalent). Bytes and escape sequences per frame are reported too.
+ * skip < 0 fast-forwards every scenario by its height, like the interactive start.
+ * Returns exit code, non zero if any renderer showed something else.
+ */
+int runVerify(unsigned int seed, long long skip);
+
+#endif
@@ -0,0 +1,501 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "Viewport.h"
+#include "DropIndex.h"
+#include "Occupancy.h"
+#include "Glyphs.h"
+#include "Memory.h"
+#include "Trace.h"
+
+#define DEFAULT_TAIL_CAPACITY 150
+
+void setupViewport(Viewport *vp, int left, int top, int columns, int rows)
+{
+    vp->rows = rows;
+    vp->columns = columns;
+    vp->paddingLeft = left;
+    vp->paddingTop = top;
+    vp->paddingBottom = 0;
+    vp->paddingRight = 0;
+    vp->minLength = 5;
+    vp->maxLength = 15;
+    vp->tailCapacity = DEFAULT_TAIL_CAPACITY;
+    vp->numDrops = 220;
+    vp->maxPerLane = 0;
+    vp->millis = 20;
+    vp->index = NULL; // before the direction, that rebuilds an index
+    setViewportDirection(vp, 'D');
+    vp->nextTick = 0;
+    vp->glyphs = defaultGlyphSet();
+    vp->drops = NULL;
+    vp->tailSegments = NULL;
+    memset(&vp->occupancy, 0, sizeof(vp->occupancy));
+}
+
+// Random length in [minLength, maxLength]
+static int randomLength(const Viewport *vp)
+{
+    return vp->minLength + rand() % (vp->maxLength - vp->minLength + 1);
+}
+
+static void initDrop(Viewport *vp, int i)
+{
+    // Anywhere along the way it falls, across it in a lane that has room
+    if (vp->direction == 'D' || vp->direction == 'U')
+    {
+        vp->drops[i].x = spawnLane(vp);
+        vp->drops[i].y = rand() % (vp->rows + 1);     // Random y in range [0, rows]
+    }
+    else
+    {
+        vp->drops[i].x = rand() % (vp->columns + 1);  // Random x in range [0, columns]
+        vp->drops[i].y = spawnLane(vp);
+    }
+    vp->drops[i].length = randomLength(vp);
+    vp->drops[i].c = getRandomGlyph(vp->glyphs);
+}
+
+static void initializeDrops(Viewport *vp)
+{
+    //Instead of hardcoding we assign drops dynamicaly with this parameters:
+    //1. n - number of drops to initialize
+    //2. max number for x
+    //3. max number for y
+    //4. max length
+    //5. points 2,3,4 should be random numbers from 0 to max
+
+    vp->numDrops = laneCapacity(vp, vp->numDrops);
+    int n = vp->numDrops;
+    vp->minLength = 5;
+    vp->maxLength = (vp->rows - 5) / 2;
+
+    // Small panes would otherwise end up with max < min
+    if (vp->maxLength < vp->minLength)
+        vp->maxLength = vp->minLength;
+    if (vp->maxLength > vp->tailCapacity)
+        vp->maxLength = vp->tailCapacity;
+
+    vp->drops = (Position*)memAlloc(n * sizeof(Position));
+    resetOccupancy(vp, 0);
+
+    // Initialize each Position with random values
+    for (int i = 0; i < n; i++)
+    {
+        initDrop(vp, i);
+    }
+}
+
+static void allocTail(const Viewport *vp, TailSegment *tail)
+{
+    tail->x = (int *)memAlloc(vp->tailCapacity * sizeof(int));
+    tail->y = (int *)memAlloc(vp->tailCapacity * sizeof(int));
+    tail->c = (int *)memAlloc(vp->tailCapacity * sizeof(int));
+}
+
+static void initTails(Viewport *vp)
+{
+    // Drops never get longer than maxLength, no need for more
+    int maxLength = vp->maxLength;
+    vp->tailCapacity = maxLength;
+
+    // Zeroed, tails that never got their arrays free as NULL
+    vp->tailSegments = (TailSegment *)memCalloc(vp->numDrops, sizeof(TailSegment));
+
+    for (int i = 0; i < vp->numDrops; i++)
+    {
+        allocTail(vp, &vp->tailSegments[i]);
+
+        // Initialize each segment's arrays
+        for (int j = 0; j < maxLength; j++)
+        {
+            vp->tailSegments[i].x[j] = 0;
+            vp->tailSegments[i].y[j] = 0;
+            vp->tailSegments[i].c[j] = getRandomGlyph(vp->glyphs);
+        }
+    }
+}
+
+static void freeTail(TailSegment *tail)
+{
+    memFree(tail->x);
+    memFree(tail->y);
+    memFree(tail->c);
+    tail->x = tail->y = tail->c = NULL;
+}
+
+void initViewport(Viewport *vp)
+{
+    initializeDrops(vp);
+    initTails(vp);
+    if (vp->index != NULL)
+        rebuildDropIndex(vp->index, vp);
+}
+
+void freeViewport(Viewport *vp)
+{
+    if (vp->tailSegments != NULL)
+    {
+        for (int i = 0; i < vp->numDrops; i++)
+        {
+            freeTail(&vp->tailSegments[i]);
+        }
+        memFree(vp->tailSegments);
+        vp->tailSegments = NULL;
+    }
+    memFree(vp->drops);
+    vp->drops = NULL;
+    freeOccupancy(&vp->occupancy);
+}
+
+void resizeDrops(Viewport *vp, int numDrops)
+{
+    if (numDrops < 0)
+        numDrops = 0;
+    if (vp->drops == NULL)
+    {
+        vp->numDrops = numDrops;
+        return;
+    }
+    numDrops = laneCapacity(vp, numDrops);
+    if (numDrops == vp->numDrops)
+        return;
+
+    // Drops that go away are the last ones, the rest keep falling where they are
+    for (int i = numDrops; i < vp->numDrops; i++)
+    {
+        freeTail(&vp->tailSegments[i]);
+    }
+    int kept = numDrops < vp->numDrops ? numDrops : vp->numDrops;
+
+    // Keep room for one drop so the arrays never become NULL
+    int room = numDrops > 0 ? numDrops : 1;
+    vp->drops = (Position *)memRealloc(vp->drops, room * sizeof(Position));
+    vp->tailSegments = (TailSegment *)memRealloc(vp->tailSegments, room * sizeof(TailSegment));
+    if (numDrops > vp->numDrops)
+        memset(vp->tailSegments + vp->numDrops, 0, (numDrops - vp->numDrops) * sizeof(TailSegment));
+
+    // Lanes are shared out again for the new number of drops
+    int before = vp->numDrops;
+    vp->numDrops = numDrops;
+    resetOccupancy(vp, kept);
+
+    // New drops start with the whole tail under the head, it unrolls as they fall
+    for (int i = before; i < numDrops; i++)
+    {
+        TailSegment *tail = &vp->tailSegments[i];
+        initDrop(vp, i);
+        allocTail(vp, tail);
+        for (int j = 0; j < vp->tailCapacity; j++)
+        {
+            tail->x[j] = vp->drops[i].x;
+            tail->y[j] = vp->drops[i].y;
+            tail->c[j] = getRandomGlyph(vp->glyphs);
+        }
+    }
+    if (vp->index != NULL)
+        rebuildDropIndex(vp->index, vp);
+}
+
+void setDropLengths(Viewport *vp, int minLength, int maxLength)
+{
+    if (minLength < 1) minLength = 1;
+    if (maxLength < minLength) maxLength = minLength;
+
+    int oldCapacity = vp->tailCapacity;
+    vp->minLength = minLength;
+    vp->maxLength = maxLength;
+    if (vp->drops == NULL)
+        return;
+
+    // Tails only ever grow, shorter drops just use less of them
+    if (maxLength > oldCapacity)
+    {
+        vp->tailCapacity = maxLength;
+        for (int i = 0; i < vp->numDrops; i++)
+        {
+            TailSegment *tail = &vp->tailSegments[i];
+            tail->x = (int *)memRealloc(tail->x, maxLength * sizeof(int));
+            tail->y = (int *)memRealloc(tail->y, maxLength * sizeof(int));
+            tail->c = (int *)memRealloc(tail->c, maxLength * sizeof(int));
+        }
+    }
+
+    for (int i = 0; i < vp->numDrops; i++)
+    {
+        TailSegment *tail = &vp->tailSegments[i];
+        int old = vp->drops[i].length;
+        int length = randomLength(vp);
+
+        // Segments past the old end are stale, stack them on the last one
+        for (int j = old; j < length; j++)
+        {
+            tail->x[j] = tail->x[old - 1];
+            tail->y[j] = tail->y[old - 1];
+            tail->c[j] = tail->c[old - 1];
+        }
+        vp->drops[i].length = length;
+    }
+}
+
+// One kernel per direction, so the loop over drops never asks which way they go.
+// Vertical rain moves along y and takes a column with room on every wrap,
+// horizontal rain is the same with rows and columns swapped.
+
+void updateDropPositionDown(Viewport *vp)
+{
+    for (int i = 0; i < vp->numDrops; i++)
+    {
+        Position *drop = &vp->drops[i];
+
+        //Move it one position down by y axis
+        drop->y++;
+        drop->c = getRandomGlyph(vp->glyphs);
+
+        //If arrived at the end -> go back to top
+        if (drop->y > vp->rows)
+        {
+            drop->y = 0;
+
+            //Also move it to another column after the cycle ends, so it doesnt look stuck,
+            //one that has room so drops don't pile up in the same columns
+            drop->x = respawnLane(vp, drop->x);
+            if (vp->index != NULL)
+                moveDropLane(vp->index, i, drop->x);
+        }
+    }
+}
+
+void updateDropPositionUp(Viewport *vp)
+{
+    for (int i = 0; i < vp->numDrops; i++)
+    {
+        Position *drop = &vp->drops[i];
+
+        drop->y--;
+        drop->c = getRandomGlyph(vp->glyphs);
+
+        //If arrived at the top -> come back at the bottom
+        if (drop->y < 0)
+        {
+            drop->y = vp->rows;
+            drop->x = respawnLane(vp, drop->x);
+            if (vp->index != NULL)
+                moveDropLane(vp->index, i, drop->x);
+        }
+    }
+}
+
+void updateDropPositionRight(Viewport *vp)
+{
+    for (int i = 0; i < vp->numDrops; i++)
+    {
+        Position *drop = &vp->drops[i];
+
+        drop->x++;
+        drop->c = getRandomGlyph(vp->glyphs);
+
+        // Past the right edge -> back to the left, in a row that has room
+        if (drop->x > vp->columns)
+        {
+            drop->x = 0;
+            drop->y = respawnLane(vp, drop->y);
+            if (vp->index != NULL)
+                moveDropLane(vp->index, i, drop->y);
+        }
+    }
+}
+
+void updateDropPositionLeft(Viewport *vp)
+{
+    for (int i = 0; i < vp->numDrops; i++)
+    {
+        Position *drop = &vp->drops[i];
+
+        drop->x--;
+        drop->c = getRandomGlyph(vp->glyphs);
+
+        if (drop->x < 0)
+        {
+            drop->x = vp->columns;
+            drop->y = respawnLane(vp, drop->y);
+            if (vp->index != NULL)
+                moveDropLane(vp->index, i, drop->y);
+        }
+    }
+}
+
+void setViewportDirection(Viewport *vp, int direction)
+{
+    switch (direction)
+    {
+        case 'U': vp->updateDrops = updateDropPositionUp; break;
+        case 'L': vp->updateDrops = updateDropPositionLeft; break;
+        case 'R': vp->updateDrops = updateDropPositionRight; break;
+        default:
+            direction = 'D';
+            vp->updateDrops = updateDropPositionDown;
+            break;
+    }
+    vp->direction = direction;
+    // Lanes are columns or rows depending on the direction
+    if (vp->index != NULL)
+        rebuildDropIndex(vp->index, vp);
+}
+
+void updateDropPosition(Viewport *vp)
+{
+    vp->updateDrops(vp);
+}
+
+void updateTailPosition(Viewport *vp)
+{
+    //Every element (i) of the rains tail takes the x,y coordinates of the previous element (i-1)
+    //And first tail element takes head's position
+
+    for (int segment = 0; segment < vp->numDrops; segment++)
+    {
+        TailSegment *tail = &vp->tailSegments[segment];
+
+        // Shift the tail positions
+        for (int i = vp->drops[segment].length - 1; i > 0; i--)
+        {
+            tail->x[i] = tail->x[i - 1];
+            tail->y[i] = tail->y[i - 1];
+            tail->c[i] = tail->c[i - 1];
+        }
+
+        // Update the first element with the drop's position
+        tail->x[0] = vp->drops[segment].x;
+        tail->y[0] = vp->drops[segment].y;
+        tail->c[0] = getRandomGlyph(vp->glyphs);
+    }
+}
+
+void updateViewport(Viewport *vp)
+{
+    // Update tail before head, because it must follow the drops previous position
+    TRACE_BEGIN("updateTailPosition");
+    updateTailPosition(vp);
+    TRACE_END("updateTailPosition");
+
+    // Update head position based on current direction
+    TRACE_BEGIN("updateDropPosition");
+    updateDropPosition(vp);
+    TRACE_END("updateDropPosition");
+}
+
+/**
+ * Closed form of k steps along one axis: pos goes through 0..limit (forward) or limit..0.
+ * Returns how many times it wrapped.
+ */
+static long long advanceAxis(int *pos, int limit, bool forward, long long k)
+{
+    if (k <= 0)
+        return 0;
+
+    long long period = limit + 1; // head visits 0..limit
+    long long wraps;
+
+    if (forward)
+    {
+        long long first = *pos <= limit ? limit + 1 - *pos : 1;
+        if (k < first)
+        {
+            *pos += (int)k;
+            return 0;
+        }
+        wraps = 1 + (k - first) / period;
+        *pos = (int)((k - first) % period);
+    }
+    else
+    {
+        // Steps until it goes past 0 and comes back at limit
+        long long first = *pos >= 0 ? *pos + 1 : 1;
+        if (k < first)
+        {
+            *pos -= (int)k;
+            return 0;
+        }
+        wraps = 1 + (k - first) / period;
+        *pos = (int)(limit - (k - first) % period);
+    }
+    return wraps;
+}
+
+/**
+ * Where the head ends up after k cycles, computed directly instead of stepping.
+ * However often it wrapped, only the lane of the last one is still visible, so it takes one
+ */
+static void advancePosition(Viewport *vp, int *x, int *y, long long k)
+{
+    switch (vp->direction)
+    {
+        case 'U': if (advanceAxis(y, vp->rows, false, k) > 0) *x = respawnLane(vp, *x); break;
+        case 'L': if (advanceAxis(x, vp->columns, false, k) > 0) *y = respawnLane(vp, *y); break;
+        case 'R': if (advanceAxis(x, vp->columns, true, k) > 0) *y = respawnLane(vp, *y); break;
+        default:  if (advanceAxis(y, vp->rows, true, k) > 0) *x = respawnLane(vp, *x); break;
+    }
+}
+
+void fastForwardViewport(Viewport *vp, long long cycles)
+{
+    if (cycles <= 0)
+        return;
+
+    for (int i = 0; i < vp->numDrops; i++)
+    {
+        Position *drop = &vp->drops[i];
+        TailSegment *tail = &vp->tailSegments[i];
+
+        // Only the last `length` cycles are still visible in the tail,
+        // jump to where the head was before them and replay just those
+        int replay = cycles < drop->length ? (int)cycles : drop->length;
+
+        // If fewer cycles than the length pass, older segments just move down the tail
+        for (int j = drop->length - 1; j >= replay; j--)
+        {
+            tail->x[j] = tail->x[j - replay];
+            tail->y[j] = tail->y[j - replay];
+            tail->c[j] = tail->c[j - replay];
+        }
+
+        advancePosition(vp, &drop->x, &drop->y, cycles - replay);
+
+        for (int j = replay - 1; j >= 0; j--)
+        {
+            tail->x[j] = drop->x;
+            tail->y[j] = drop->y;
+            tail->c[j] = getRandomGlyph(vp->glyphs);
+            advancePosition(vp, &drop->x, &drop->y, 1);
+        }
+        drop->c = getRandomGlyph(vp->glyphs);
+    }
+    if (vp->index != NULL)
+        rebuildDropIndex(vp->index, vp);
+}
+
+bool checkDrop(const Viewport *vp, int x, int y)
+{
+    for (int i = 0; i < vp->numDrops; i++)
+    {
+        if (x == vp->drops[i].x && y == vp->drops[i].y)
+            return true;
+    }
+    return false;
+}
+
+int checkTail(const Viewport *vp, int x, int y)
+{
+    for (int i = 0; i < vp->numDrops; i++)
+    {
+        for (int j = 0; j < vp->drops[i].length; j++)
+        {
+            if (x == vp->tailSegments[i].x[j] && y == vp->tailSegments[i].y[j])
+            {
+                return vp->tailSegments[i].c[j];
+            }
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,51 @@
+#ifndef VIEWPORT_API_H
+#define VIEWPORT_API_H
+
+#include <stdbool.h>
+
+#include "types/Viewport.h"
+
+// Fill in defaults for a pane covering the given rectangle of the terminal
+void setupViewport(Viewport *vp, int left, int top, int columns, int rows);
+
+/**
+ * Allocate drops and tails and spread the drops randomly over the pane, every column (row for
+ * horizontal rain) gets at most its share of them. With maxPerLane set numDrops is cut to what fits.
+ */
+void initViewport(Viewport *vp);
+
+void freeViewport(Viewport *vp);
+
+/**
+ * Change number of drops of a running pane. Existing drops keep falling,
+ * only the added ones are initialized and only the removed ones are freed.
+ * Cut to what fits with maxPerLane, like initViewport.
+ */
+void resizeDrops(Viewport *vp, int numDrops);
+
+// Change the range of drop lengths of a running pane, every drop gets a new length
+void setDropLengths(Viewport *vp, int minLength, int maxLength);
+
+/**
+ * Pick the drop kernel for direction ('D', 'U', 'L' or 'R'). Takes effect with the
+ * next update, drops and tails stay as they are.
+ */
+void setViewportDirection(Viewport *vp, int direction);
+
+// Advance the pane by one cycle
+void updateViewport(Viewport *vp);
+
+/**
+ * Advance the pane by many cycles at once without rendering, e.g. to start with
+ * a full screen of rain. Cost per drop is its length, not the number of cycles.
+ * Result looks the same as stepping, but random glyphs are drawn in different order.
+ */
+void fastForwardViewport(Viewport *vp, long long cycles);
+
+// Return true if rain drop is present at given x,y position (pane coordinates)
+bool checkDrop(const Viewport *vp, int x, int y);
+
+// Return char of the first tail element present at given x,y position, otherwise -1
+int checkTail(const Viewport *vp, int x, int y);
+
+#endif
@@ -0,0 +1,576 @@
+#include <string.h>
+
+#include "Vt.h"
+#include "Memory.h"
+
+enum { VT_GROUND, VT_ESCAPE, VT_CSI, VT_STRING, VT_STRING_ESCAPE };
+enum { VT_STRING_DCS, VT_STRING_APC };
+
+static const VtCell blankCell = { ' ', VT_COLOR_DEFAULT, VT_COLOR_DEFAULT, 0 };
+
+void vtInit(VtScreen *vt, int width, int height)
+{
+    memset(vt, 0, sizeof(*vt));
+    vt->width = width > 0 ? width : 1;
+    vt->height = height > 0 ? height : 1;
+    vt->cells = (VtCell *)memAlloc((size_t)vt->width * vt->height * sizeof(VtCell));
+    for (int i = 0; i < vt->width * vt->height; i++)
+    {
+        vt->cells[i] = blankCell;
+    }
+    vt->bottom = vt->height - 1;
+    vt->pen = blankCell;
+    vt->lastChar = ' ';
+}
+
+void vtFree(VtScreen *vt)
+{
+    memFree(vt->cells);
+    memFree(vt->pixels);
+    memFree(vt->string);
+    memFree(vt->image);
+    vt->cells = NULL;
+    vt->pixels = NULL;
+    vt->string = NULL;
+    vt->image = NULL;
+}
+
+void vtEnablePixels(VtScreen *vt, int cellWidth, int cellHeight)
+{
+    vt->cellWidth = cellWidth;
+    vt->cellHeight = cellHeight;
+    vt->pixels = (unsigned char *)memCalloc((size_t)vt->width * cellWidth * vt->height * cellHeight, 3);
+}
+
+static void erasePixels(VtScreen *vt)
+{
+    if (vt->pixels != NULL)
+        memset(vt->pixels, 0, (size_t)vt->width * vt->cellWidth * vt->height * vt->cellHeight * 3);
+}
+
+static void putPixel(VtScreen *vt, int x, int y, int color)
+{
+    int w = vt->width * vt->cellWidth;
+    if (x < 0 || y < 0 || x >= w || y >= vt->height * vt->cellHeight)
+        return;
+    unsigned char *p = vt->pixels + ((size_t)y * w + x) * 3;
+    p[0] = (color >> 16) & 0xFF;
+    p[1] = (color >> 8) & 0xFF;
+    p[2] = color & 0xFF;
+}
+
+static int readNumber(const char **p, const char *end)
+{
+    int n = 0;
+    while (*p < end && **p >= '0' && **p <= '9')
+    {
+        n = n * 10 + (**p - '0');
+        (*p)++;
+    }
+    return n;
+}
+
+// DCS P1;P2;P3 q <sixel data>, drawn with its top left corner at the cursor cell
+static void drawSixel(VtScreen *vt, const char *p, const char *end)
+{
+    int palette[256] = { 0 };
+    int color = 0;
+    int x0 = vt->x * vt->cellWidth;
+    int y0 = vt->y * vt->cellHeight;
+    int x = 0, y = 0;
+
+    while (p < end && *p != 'q')
+        p++;
+    if (p == end)
+    {
+        vt->unknown++;
+        return;
+    }
+    p++;
+
+    while (p < end)
+    {
+        char c = *p++;
+        int repeat = 1;
+
+        if (c == '"')
+        {
+            // Raster attributes, size is not needed to draw
+            while (p < end && ((*p >= '0' && *p <= '9') || *p == ';'))
+                p++;
+            continue;
+        }
+        if (c == '#')
+        {
+            int reg = readNumber(&p, end) & 0xFF;
+            if (p < end && *p == ';')
+            {
+                int v[4] = { 0 };
+                for (int i = 0; i < 4 && p < end && *p == ';'; i++)
+                {
+                    p++;
+                    v[i] = readNumber(&p, end);
+                }
+                // Only RGB in percent (2) is used
+                palette[reg] = ((v[1] * 255 + 50) / 100) << 16 | ((v[2] * 255 + 50) / 100) << 8 | ((v[3] * 255 + 50) / 100);
+            }
+            color = palette[reg];
+            continue;
+        }
+        if (c == '$') { x = 0; continue; }
+        if (c == '-') { x = 0; y += 6; continue; }
+        if (c == '!')
+        {
+            repeat = readNumber(&p, end);
+            if (p == end)
+                break;
+            c = *p++;
+        }
+        if (c < '?' || c > '~')
+            continue;
+
+        int bits = c - '?';
+        for (int i = 0; i < repeat; i++, x++)
+        {
+            for (int r = 0; r < 6; r++)
+            {
+                if (bits & (1 << r))
+                    putPixel(vt, x0 + x, y0 + y + r, color);
+            }
+        }
+    }
+}
+
+static int base64Value(char c)
+{
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+') return 62;
+    if (c == '/') return 63;
+    return -1;
+}
+
+// APC G key=value,...;base64 rgb24, chunks with m=1 until the last one
+static void drawKitty(VtScreen *vt, const char *p, const char *end)
+{
+    int more = 0;
+    bool first = false;
+
+    p++; // G
+    while (p < end && *p != ';')
+    {
+        char key = *p++;
+        if (p < end && *p == '=')
+            p++;
+        int value = readNumber(&p, end);
+
+        switch (key)
+        {
+            case 'a': first = true; p++; break; // action letter, only T is sent
+            case 's': vt->imageWidth = value; break;
+            case 'v': vt->imageHeight = value; break;
+            case 'm': more = value; break;
+            case 'f': if (value != 24) vt->unknown++; break;
+            default: break;
+        }
+        while (p < end && *p != ',' && *p != ';')
+            p++;
+        if (p < end && *p == ',')
+            p++;
+    }
+    if (first)
+        vt->imageLen = 0;
+    if (p < end)
+        p++;
+
+    // Decode this chunk's base64
+    size_t room = (size_t)(end - p) / 4 * 3 + 3;
+    vt->image = (unsigned char *)memRealloc(vt->image, vt->imageLen + room);
+    unsigned int acc = 0;
+    int bits = 0;
+    for (; p < end; p++)
+    {
+        int v = base64Value(*p);
+        if (v < 0)
+            continue;
+        acc = acc << 6 | v;
+        bits += 6;
+        if (bits >= 8)
+        {
+            bits -= 8;
+            vt->image[vt->imageLen++] = (unsigned char)(acc >> bits);
+        }
+    }
+
+    if (more)
+        return;
+    if (vt->imageLen < (size_t)vt->imageWidth * vt->imageHeight * 3)
+    {
+        vt->unknown++;
+        return;
+    }
+
+    int x0 = vt->x * vt->cellWidth;
+    int y0 = vt->y * vt->cellHeight;
+    for (int y = 0; y < vt->imageHeight; y++)
+    {
+        for (int x = 0; x < vt->imageWidth; x++)
+        {
+            const unsigned char *px = vt->image + ((size_t)y * vt->imageWidth + x) * 3;
+            putPixel(vt, x0 + x, y0 + y, px[0] << 16 | px[1] << 8 | px[2]);
+        }
+    }
+}
+
+static void finishString(VtScreen *vt)
+{
+    const char *p = vt->string;
+    const char *end = vt->string + vt->stringLen;
+
+    if (vt->pixels == NULL)
+        return;
+    if (vt->stringKind == VT_STRING_DCS)
+        drawSixel(vt, p, end);
+    else if (vt->stringLen > 0 && *p == 'G')
+        drawKitty(vt, p, end);
+}
+
+static void collectString(VtScreen *vt, char c)
+{
+    if (vt->stringLen == vt->stringCap)
+    {
+        vt->stringCap = vt->stringCap ? vt->stringCap * 2 : 4096;
+        vt->string = (char *)memRealloc(vt->string, vt->stringCap);
+    }
+    vt->string[vt->stringLen++] = c;
+}
+
+// Erased cells get the current background, like xterm (bce)
+static void eraseCells(VtScreen *vt, int from, int to)
+{
+    VtCell blank = blankCell;
+    blank.bg = vt->pen.bg;
+
+    for (int i = from; i < to; i++)
+    {
+        vt->cells[i] = blank;
+    }
+}
+
+// Move lines top..bottom by n, positive n moves them down (RI), negative up (IND)
+static void scrollRegion(VtScreen *vt, int n)
+{
+    int w = vt->width;
+    int lines = vt->bottom - vt->top + 1;
+    int shift = n > 0 ? n : -n;
+    if (shift > lines) shift = lines;
+
+    VtCell *region = vt->cells + (size_t)vt->top * w;
+    size_t keep = (size_t)(lines - shift) * w;
+
+    if (n > 0)
+    {
+        memmove(region + (size_t)shift * w, region, keep * sizeof(VtCell));
+        eraseCells(vt, vt->top * w, (vt->top + shift) * w);
+    }
+    else
+    {
+        memmove(region, region + (size_t)shift * w, keep * sizeof(VtCell));
+        eraseCells(vt, (vt->bottom + 1 - shift) * w, (vt->bottom + 1) * w);
+    }
+}
+
+static void lineFeed(VtScreen *vt)
+{
+    if (vt->y == vt->bottom)
+        scrollRegion(vt, -1);
+    else if (vt->y < vt->height - 1)
+        vt->y++;
+}
+
+static void reverseLineFeed(VtScreen *vt)
+{
+    if (vt->y == vt->top)
+        scrollRegion(vt, 1);
+    else if (vt->y > 0)
+        vt->y--;
+}
+
+static void moveTo(VtScreen *vt, int x, int y)
+{
+    vt->x = x < 0 ? 0 : x >= vt->width ? vt->width - 1 : x;
+    vt->y = y < 0 ? 0 : y >= vt->height ? vt->height - 1 : y;
+    vt->wrapPending = false;
+}
+
+static void putGlyph(VtScreen *vt, int c)
+{
+    if (vt->wrapPending)
+    {
+        vt->x = 0;
+        lineFeed(vt);
+        vt->wrapPending = false;
+    }
+
+    VtCell *cell = &vt->cells[(size_t)vt->y * vt->width + vt->x];
+    *cell = vt->pen;
+    cell->c = c;
+    vt->lastChar = c;
+
+    if (vt->x == vt->width - 1)
+        vt->wrapPending = true;
+    else
+        vt->x++;
+}
+
+static int param(const VtScreen *vt, int i, int def)
+{
+    return i < vt->numParams && vt->params[i] > 0 ? vt->params[i] : def;
+}
+
+static void selectGraphics(VtScreen *vt)
+{
+    if (vt->numParams == 0)
+    {
+        vt->pen = blankCell;
+        return;
+    }
+
+    for (int i = 0; i < vt->numParams; i++)
+    {
+        int p = vt->params[i];
+
+        if (p == 0)
+            vt->pen = blankCell;
+        else if (p == 1)
+            vt->pen.attrs |= VT_ATTR_BOLD;
+        else if (p == 2)
+            vt->pen.attrs |= VT_ATTR_FAINT;
+        else if (p == 22)
+            vt->pen.attrs &= ~(VT_ATTR_BOLD | VT_ATTR_FAINT);
+        else if (p >= 30 && p <= 37)
+            vt->pen.fg = VT_COLOR_INDEXED | (p - 30);
+        else if (p >= 90 && p <= 97)
+            vt->pen.fg = VT_COLOR_INDEXED | (p - 90 + 8);
+        else if (p == 39)
+            vt->pen.fg = VT_COLOR_DEFAULT;
+        else if (p >= 40 && p <= 47)
+            vt->pen.bg = VT_COLOR_INDEXED | (p - 40);
+        else if (p >= 100 && p <= 107)
+            vt->pen.bg = VT_COLOR_INDEXED | (p - 100 + 8);
+        else if (p == 49)
+            vt->pen.bg = VT_COLOR_DEFAULT;
+        else if ((p == 38 || p == 48) && i + 2 < vt->numParams && vt->params[i + 1] == 5)
+        {
+            unsigned int color = VT_COLOR_INDEXED | (vt->params[i + 2] & 0xFF);
+            *(p == 38 ? &vt->pen.fg : &vt->pen.bg) = color;
+            i += 2;
+        }
+        else if ((p == 38 || p == 48) && i + 4 < vt->numParams && vt->params[i + 1] == 2)
+        {
+            unsigned int color = VT_COLOR_RGB | (vt->params[i + 2] & 0xFF) << 16
+                | (vt->params[i + 3] & 0xFF) << 8 | (vt->params[i + 4] & 0xFF);
+            *(p == 38 ? &vt->pen.fg : &vt->pen.bg) = color;
+            i += 4;
+        }
+        // The rest doesn't show up in the rain
+    }
+}
+
+static void setMode(VtScreen *vt, bool on)
+{
+    for (int i = 0; i < vt->numParams; i++)
+    {
+        if (vt->privateMode && vt->params[i] == 2026)
+            vt->sync = on;
+        // Cursor visibility, alternate screen.. don't change the cells
+    }
+}
+
+static void executeCsi(VtScreen *vt, char final)
+{
+    int row = vt->y * vt->width;
+    int n = param(vt, 0, 1);
+
+    switch (final)
+    {
+        case 'H':
+        case 'f': moveTo(vt, param(vt, 1, 1) - 1, param(vt, 0, 1) - 1); break;
+        case 'A': moveTo(vt, vt->x, vt->y - n); break;
+        case 'B': moveTo(vt, vt->x, vt->y + n); break;
+        case 'C': moveTo(vt, vt->x + n, vt->y); break;
+        case 'D': moveTo(vt, vt->x - n, vt->y); break;
+        case 'G': moveTo(vt, n - 1, vt->y); break;
+        case 'd': moveTo(vt, vt->x, n - 1); break;
+        case 'J':
+            switch (param(vt, 0, 0))
+            {
+                case 0: eraseCells(vt, row + vt->x, vt->width * vt->height); break;
+                case 1: eraseCells(vt, 0, row + vt->x + 1); break;
+                default: eraseCells(vt, 0, vt->width * vt->height); erasePixels(vt); break;
+            }
+            break;
+        case 'K':
+            switch (param(vt, 0, 0))
+            {
+                case 0: eraseCells(vt, row + vt->x, row + vt->width); break;
+                case 1: eraseCells(vt, row, row + vt->x + 1); break;
+                default: eraseCells(vt, row, row + vt->width); break;
+            }
+            break;
+        case 'X':
+            eraseCells(vt, row + vt->x, row + (vt->x + n < vt->width ? vt->x + n : vt->width));
+            break;
+        case 'b':
+            for (int i = 0; i < n; i++)
+            {
+                putGlyph(vt, vt->lastChar);
+            }
+            break;
+        case 'r':
+        {
+            int top = param(vt, 0, 1) - 1;
+            int bottom = param(vt, 1, vt->height) - 1;
+            if (bottom >= vt->height) bottom = vt->height - 1;
+            if (top < bottom)
+            {
+                vt->top = top;
+                vt->bottom = bottom;
+            }
+            moveTo(vt, 0, 0);
+            break;
+        }
+        case 'm': selectGraphics(vt); break;
+        case 'h': setMode(vt, true); break;
+        case 'l': setMode(vt, false); break;
+        case 'p': break; // DECRQM, a query
+        default: vt->unknown++; break;
+    }
+}
+
+static void feedByte(VtScreen *vt, unsigned char b)
+{
+    // CAN and SUB abort a sequence wherever it is
+    if (b == 0x18 || b == 0x1a)
+    {
+        vt->state = VT_GROUND;
+        vt->utf8Left = 0;
+        return;
+    }
+
+    switch (vt->state)
+    {
+        case VT_STRING:
+            if (b == 0x1b)
+                vt->state = VT_STRING_ESCAPE;
+            else
+                collectString(vt, (char)b);
+            return;
+
+        case VT_STRING_ESCAPE:
+            // ST ends the string, anything else after ESC is taken as part of it
+            if (b == '\\')
+            {
+                finishString(vt);
+                vt->state = VT_GROUND;
+                return;
+            }
+            collectString(vt, 0x1b);
+            collectString(vt, (char)b);
+            vt->state = VT_STRING;
+            return;
+
+        case VT_ESCAPE:
+            vt->state = VT_GROUND;
+            switch (b)
+            {
+                case 'P':
+                case '_':
+                    vt->state = VT_STRING;
+                    vt->stringKind = b == 'P' ? VT_STRING_DCS : VT_STRING_APC;
+                    vt->stringLen = 0;
+                    break;
+                case '[':
+                    vt->state = VT_CSI;
+                    vt->numParams = 0;
+                    vt->params[0] = 0;
+                    vt->privateMode = false;
+                    break;
+                case 'D': lineFeed(vt); vt->wrapPending = false; break;
+                case 'M': reverseLineFeed(vt); vt->wrapPending = false; break;
+                case 'E': vt->x = 0; lineFeed(vt); vt->wrapPending = false; break;
+                default: vt->unknown++; break;
+            }
+            return;
+
+        case VT_CSI:
+            if (b >= '0' && b <= '9')
+            {
+                if (vt->numParams == 0)
+                    vt->numParams = 1;
+                if (vt->numParams <= 16)
+                    vt->params[vt->numParams - 1] = vt->params[vt->numParams - 1] * 10 + (b - '0');
+            }
+            else if (b == ';')
+            {
+                if (vt->numParams == 0)
+                    vt->numParams = 1;
+                if (vt->numParams < 16)
+                    vt->params[vt->numParams] = 0;
+                vt->numParams++;
+            }
+            else if (b == '?')
+                vt->privateMode = true;
+            else if (b >= 0x40 && b <= 0x7e)
+            {
+                if (vt->numParams > 16)
+                    vt->numParams = 16;
+                executeCsi(vt, (char)b);
+                vt->state = VT_GROUND;
+            }
+            // Intermediate bytes ($ of DECRQM..) are skipped
+            return;
+    }
+
+    if (vt->utf8Left > 0 && (b & 0xC0) == 0x80)
+    {
+        vt->utf8 = vt->utf8 << 6 | (b & 0x3F);
+        if (--vt->utf8Left == 0)
+            putGlyph(vt, (int)vt->utf8);
+        return;
+    }
+    vt->utf8Left = 0;
+
+    if (b == 0x1b)
+    {
+        vt->state = VT_ESCAPE;
+        vt->escapes++;
+    }
+    else if (b == '\n' || b == '\v' || b == '\f')
+    {
+        vt->x = 0; // ONLCR
+        lineFeed(vt);
+        vt->wrapPending = false;
+    }
+    else if (b == '\r')
+        moveTo(vt, 0, vt->y);
+    else if (b == '\b')
+        moveTo(vt, vt->x - 1, vt->y);
+    else if (b < 0x20 || b == 0x7f)
+        ; // other controls do nothing to the cells
+    else if (b < 0x80)
+        putGlyph(vt, b);
+    else if ((b & 0xE0) == 0xC0) { vt->utf8 = b & 0x1F; vt->utf8Left = 1; }
+    else if ((b & 0xF0) == 0xE0) { vt->utf8 = b & 0x0F; vt->utf8Left = 2; }
+    else if ((b & 0xF8) == 0xF0) { vt->utf8 = b & 0x07; vt->utf8Left = 3; }
+}
+
+void vtFeed(VtScreen *vt, const char *data, size_t len)
+{
+    vt->bytes += len;
+    for (size_t i = 0; i < len; i++)
+    {
+        feedByte(vt, (unsigned char)data[i]);
+    }
+}
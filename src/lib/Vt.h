@@ -0,0 +1,92 @@
+#ifndef VT_H
+#define VT_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// Color of a cell, kind in the top byte
+#define VT_COLOR_DEFAULT 0
+#define VT_COLOR_INDEXED 0x1000000 // | palette index, SGR 30-37/90-97 are 0-15
+#define VT_COLOR_RGB     0x2000000 // | 0xRRGGBB
+
+#define VT_ATTR_BOLD  1
+#define VT_ATTR_FAINT 2
+
+typedef struct {
+    int c;             // code point
+    unsigned int fg;
+    unsigned int bg;
+    unsigned char attrs;
+} VtCell;
+
+/**
+ * Minimal in-process VT100/xterm screen, just enough to replay what the renderers send:
+ * cursor motion (CUP, CUU/CUD/CUF/CUB, CHA, VPA), SGR colors, ED/EL/ECH, REP,
+ * scroll regions with IND/RI, synchronized output and autowrap.
+ * Like a real tty with OPOST, line feed also returns the carriage (ONLCR).
+ * Images are drawn at the cursor cell and don't move the cursor, erasing the screen erases them.
+ */
+typedef struct {
+    int width;
+    int height;
+    VtCell *cells;
+    int x;
+    int y;
+    bool wrapPending; // glyph was written to the last column, next one wraps
+    int top;          // scroll region, 0 based, inclusive
+    int bottom;
+    VtCell pen;       // attributes for new glyphs
+    int lastChar;     // what REP repeats
+    bool sync;        // inside a synchronized update
+
+    // Pixel graphics, only with vtEnablePixels: sixel (DCS q) and kitty (APC G, rgb24 a=T)
+    int cellWidth;
+    int cellHeight;
+    unsigned char *pixels; // rgb, width * cellWidth x height * cellHeight
+    char *string;          // DCS/APC payload being collected
+    size_t stringLen;
+    size_t stringCap;
+    int stringKind;
+    unsigned char *image;  // kitty payload of a chunked transfer
+    size_t imageLen;
+    int imageWidth;
+    int imageHeight;
+
+    // Parser
+    int state;
+    int params[16];
+    int numParams;
+    bool privateMode;
+    unsigned int utf8;
+    int utf8Left;
+
+    // Counters
+    long long bytes;
+    long long escapes;
+    long long unknown; // sequences the emulator doesn't know, renderers should send none
+} VtScreen;
+
+void vtInit(VtScreen *vt, int width, int height);
+
+void vtFree(VtScreen *vt);
+
+// Decode sixel and kitty images into a pixel canvas, one cell is cellWidth x cellHeight pixels
+void vtEnablePixels(VtScreen *vt, int cellWidth, int cellHeight);
+
+// Parse and apply output of a renderer
+void vtFeed(VtScreen *vt, const char *data, size_t len);
+
+static inline const VtCell* vtCell(const VtScreen *vt, int x, int y)
+{
+    return &vt->cells[(size_t)y * vt->width + x];
+}
+
+// Cells look the same, only the background of a blank matters
+static inline bool vtSameCell(const VtCell *a, const VtCell *b)
+{
+    if (a->c != b->c || a->bg != b->bg)
+        return false;
+    return a->c == ' ' || (a->fg == b->fg && a->attrs == b->attrs);
+}
+
+#endif
@@ -0,0 +1,379 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "Wall.h"
+#include "Viewport.h"
+#include "Renderer.h"
+#include "Parallax.h"
+
+#define WALL_MAGIC 0x4d575731 // MWW1
+#define WALL_ACK_TIMEOUT 1000 // ms a tile may hold the wall back before it is skipped
+
+typedef struct {
+    int pid;           // 0 = free
+    int width;
+    int height;
+    int x;
+    int y;
+    long long acked;   // last frame the tile copied
+} WallSlot;
+
+struct WallShared {
+    unsigned int magic;
+    int columns;
+    int rows;
+    pthread_mutex_t lock;
+    pthread_cond_t changed; // new frame, ack, tile attached or wall closed
+    long long frame;        // frames published so far
+    int closed;
+    WallSlot slots[WALL_MAX_TILES];
+    Cell cells[];           // columns * rows, the newest frame
+};
+
+static volatile sig_atomic_t stopWall = 0;
+
+static void onStop(int sig)
+{
+    (void)sig;
+    stopWall = 1;
+}
+
+static void shmName(char *buf, size_t size, const char *name)
+{
+    snprintf(buf, size, "/matrix-wall-%s", name);
+}
+
+static void deadline(struct timespec *ts, int ms)
+{
+    clock_gettime(CLOCK_MONOTONIC, ts);
+    ts->tv_sec += ms / 1000;
+    ts->tv_nsec += (long)(ms % 1000) * 1000000;
+    if (ts->tv_nsec >= 1000000000)
+    {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000;
+    }
+}
+
+// Robust lock, a tile killed while holding it doesn't freeze the wall
+static void lockWall(WallShared *w)
+{
+    if (pthread_mutex_lock(&w->lock) == EOWNERDEAD)
+        pthread_mutex_consistent(&w->lock);
+}
+
+static int waitWall(WallShared *w, const struct timespec *until)
+{
+    int rc = pthread_cond_timedwait(&w->changed, &w->lock, until);
+    if (rc == EOWNERDEAD)
+    {
+        pthread_mutex_consistent(&w->lock);
+        rc = 0;
+    }
+    return rc;
+}
+
+static void initShared(WallShared *w, const WallOptions *opts)
+{
+    pthread_mutexattr_t ma;
+    pthread_mutexattr_init(&ma);
+    pthread_mutexattr_setpshared(&ma, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&ma, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&w->lock, &ma);
+    pthread_mutexattr_destroy(&ma);
+
+    pthread_condattr_t ca;
+    pthread_condattr_init(&ca);
+    pthread_condattr_setpshared(&ca, PTHREAD_PROCESS_SHARED);
+    pthread_condattr_setclock(&ca, CLOCK_MONOTONIC);
+    pthread_cond_init(&w->changed, &ca);
+    pthread_condattr_destroy(&ca);
+
+    w->columns = opts->columns;
+    w->rows = opts->rows;
+    for (int i = 0; i < opts->columns * opts->rows; i++)
+    {
+        w->cells[i] = (Cell){ ' ', STYLE_EMPTY };
+    }
+    // Tiles check the magic, so it goes last
+    w->magic = WALL_MAGIC;
+}
+
+// Wait until every tile has the current frame. Tiles that are gone lose their slot,
+// the ones that are too slow are not waited for this time
+static void waitForTiles(WallShared *w)
+{
+    struct timespec until;
+    deadline(&until, WALL_ACK_TIMEOUT);
+
+    lockWall(w);
+    while (!stopWall)
+    {
+        bool waiting = false;
+        for (int i = 0; i < WALL_MAX_TILES; i++)
+        {
+            if (w->slots[i].pid == 0 || w->slots[i].acked >= w->frame)
+                continue;
+            if (kill(w->slots[i].pid, 0) < 0 && errno == ESRCH)
+            {
+                fprintf(stderr, "wall: tile %d left\n", w->slots[i].pid);
+                w->slots[i].pid = 0;
+                continue;
+            }
+            waiting = true;
+        }
+        if (!waiting || waitWall(w, &until) == ETIMEDOUT)
+            break;
+    }
+    pthread_mutex_unlock(&w->lock);
+}
+
+static void sleepUntil(long long ns)
+{
+    struct timespec ts = { ns / 1000000000LL, ns % 1000000000LL };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR && !stopWall)
+        ;
+}
+
+static long long nowNanos()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+int runWall(const WallOptions *opts)
+{
+    char name[256];
+    shmName(name, sizeof(name), opts->name);
+
+    if (opts->columns < 1 || opts->rows < 1)
+    {
+        fprintf(stderr, "wall: bad size %dx%d\n", opts->columns, opts->rows);
+        return EXIT_FAILURE;
+    }
+
+    size_t size = sizeof(WallShared) + (size_t)opts->columns * opts->rows * sizeof(Cell);
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0)
+    {
+        fprintf(stderr, "wall: %s: %s\n", name, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    if (ftruncate(fd, (off_t)size) < 0)
+    {
+        perror("wall: ftruncate");
+        close(fd);
+        shm_unlink(name);
+        return EXIT_FAILURE;
+    }
+    WallShared *w = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (w == MAP_FAILED)
+    {
+        perror("wall: mmap");
+        shm_unlink(name);
+        return EXIT_FAILURE;
+    }
+    initShared(w, opts);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = onStop;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGHUP, &sa, NULL);
+
+    // The one simulation of the whole wall
+    Viewport vp;
+    Parallax parallax;
+    Frame frame = { 0 };
+
+    srand(opts->seed);
+    srandom(opts->seed);
+    setupViewport(&vp, 0, 0, opts->columns, opts->rows);
+    vp.numDrops = opts->numDrops;
+    vp.millis = opts->millis;
+    vp.glyphs = opts->glyphs;
+    setViewportDirection(&vp, opts->direction);
+    initViewport(&vp);
+    fastForwardViewport(&vp, opts->skip);
+    if (opts->layers > 1)
+        initParallax(&parallax, &vp, opts->layers, opts->skip);
+    resizeFrame(&frame, opts->columns, opts->rows);
+    clearFrame(&frame);
+
+    fprintf(stderr, "wall: %s %dx%d, tiles attach with tile=%s:X,Y\n", name, opts->columns, opts->rows, opts->name);
+
+    long long start = nowNanos();
+    long long frames = 0;
+    while (!stopWall)
+    {
+        long long now = start + frames * opts->millis * 1000000LL;
+        sleepUntil(now);
+        if (stopWall)
+            break;
+
+        // Lockstep, nobody gets frame n+1 while someone still shows frame n-1
+        waitForTiles(w);
+
+        if (opts->layers > 1)
+        {
+            tickParallax(&parallax, now / 1000000, false);
+            composeParallax(&frame, &parallax, false);
+        }
+        else
+        {
+            updateViewport(&vp);
+            composePanes(&frame, &vp, 1, RENDERER_FULL);
+        }
+
+        lockWall(w);
+        memcpy(w->cells, frame.cells, (size_t)opts->columns * opts->rows * sizeof(Cell));
+        w->frame++;
+        pthread_cond_broadcast(&w->changed);
+        pthread_mutex_unlock(&w->lock);
+
+        // Running late, don't try to catch up with a burst of frames
+        frames++;
+        long long behind = (nowNanos() - start) / (opts->millis * 1000000LL);
+        if (behind > frames)
+            frames = behind;
+    }
+
+    lockWall(w);
+    w->closed = 1;
+    pthread_cond_broadcast(&w->changed);
+    pthread_mutex_unlock(&w->lock);
+
+    if (opts->layers > 1)
+        freeParallax(&parallax);
+    freeViewport(&vp);
+    freeFrame(&frame);
+    munmap(w, size);
+    shm_unlink(name);
+    return EXIT_SUCCESS;
+}
+
+int wallAttach(WallTile *tile, const char *name, int x, int y)
+{
+    char path[256];
+    struct stat st;
+
+    memset(tile, 0, sizeof(*tile));
+    tile->slot = -1;
+    shmName(path, sizeof(path), name);
+
+    int fd = shm_open(path, O_RDWR, 0);
+    if (fd < 0 || fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(WallShared))
+    {
+        fprintf(stderr, "No wall %s, start it first with wall=%s:COLUMNSxROWS\n", path, name);
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    WallShared *w = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (w == MAP_FAILED || w->magic != WALL_MAGIC)
+    {
+        fprintf(stderr, "%s is not a wall\n", path);
+        if (w != MAP_FAILED) munmap(w, (size_t)st.st_size);
+        return -1;
+    }
+
+    tile->shared = w;
+    tile->size = st.st_size;
+    tile->x = x;
+    tile->y = y;
+
+    lockWall(w);
+    for (int i = 0; i < WALL_MAX_TILES; i++)
+    {
+        if (w->slots[i].pid != 0)
+            continue;
+        // Joins at the current frame, so the coordinator doesn't wait for an older one
+        w->slots[i] = (WallSlot){ (int)getpid(), 0, 0, x, y, w->frame };
+        tile->slot = i;
+        break;
+    }
+    pthread_mutex_unlock(&w->lock);
+
+    if (tile->slot < 0)
+    {
+        fprintf(stderr, "Wall %s is full, max %d tiles\n", path, WALL_MAX_TILES);
+        wallDetach(tile);
+        return -1;
+    }
+    return 0;
+}
+
+void wallDetach(WallTile *tile)
+{
+    WallShared *w = tile->shared;
+    if (w == NULL)
+        return;
+
+    if (tile->slot >= 0)
+    {
+        lockWall(w);
+        w->slots[tile->slot].pid = 0;
+        pthread_cond_broadcast(&w->changed);
+        pthread_mutex_unlock(&w->lock);
+    }
+    munmap(w, (size_t)tile->size);
+    tile->shared = NULL;
+}
+
+long long wallWaitFrame(WallTile *tile, long long lastFrame, int timeoutMs)
+{
+    WallShared *w = tile->shared;
+    struct timespec until;
+    deadline(&until, timeoutMs);
+
+    lockWall(w);
+    while (w->frame == lastFrame && !w->closed)
+    {
+        if (waitWall(w, &until) == ETIMEDOUT)
+            break;
+    }
+    long long frame = w->closed ? -1 : w->frame;
+    pthread_mutex_unlock(&w->lock);
+    return frame;
+}
+
+long long wallCopyFrame(WallTile *tile, Frame *frame)
+{
+    WallShared *w = tile->shared;
+
+    lockWall(w);
+    for (int y = 0; y < frame->height; y++)
+    {
+        int wy = tile->y + y;
+        for (int x = 0; x < frame->width; x++)
+        {
+            int wx = tile->x + x;
+            if (wx < 0 || wy < 0 || wx >= w->columns || wy >= w->rows)
+                *frameCell(frame, x, y) = (Cell){ ' ', STYLE_EMPTY };
+            else
+                *frameCell(frame, x, y) = w->cells[(size_t)wy * w->columns + wx];
+        }
+    }
+
+    WallSlot *slot = &w->slots[tile->slot];
+    slot->width = frame->width;
+    slot->height = frame->height;
+    slot->acked = w->frame;
+    long long copied = w->frame;
+    pthread_cond_broadcast(&w->changed);
+    pthread_mutex_unlock(&w->lock);
+    return copied;
+}
@@ -0,0 +1,64 @@
+#ifndef WALL_H
+#define WALL_H
+
+#include <stdbool.h>
+
+#include "types/GlyphSet.h"
+#include "Frame.h"
+
+#define WALL_MAX_TILES 64
+
+/**
+ * Video wall: one coordinator owns the global simulation and publishes every composed
+ * frame of the whole wall to POSIX shared memory, tile processes (one per terminal)
+ * copy their rectangle out of it and render it like any other frame.
+ * Simulation is paid once, drops cross tile borders without seams.
+ */
+typedef struct {
+    const char *name;  // shared memory is /matrix-wall-<name>
+    int columns;       // size of the whole wall in cells
+    int rows;
+    int numDrops;
+    int millis;
+    int direction;
+    int layers;
+    const GlyphSet *glyphs;
+    unsigned int seed;
+    long long skip;
+} WallOptions;
+
+/**
+ * Run the coordinator until SIGINT/SIGTERM. Every frame waits (bounded) until all
+ * attached tiles took the previous one, so tiles present in lockstep. Returns exit code.
+ */
+int runWall(const WallOptions *opts);
+
+typedef struct WallShared WallShared;
+
+// Tile side of the wall, attached to the shared memory of a running coordinator
+typedef struct {
+    WallShared *shared;
+    long long size;
+    int slot;
+    int x;  // where the tile is in the wall
+    int y;
+} WallTile;
+
+// Attach as a tile at (x, y) of the wall, returns -1 with a message if there is no such wall
+int wallAttach(WallTile *tile, const char *name, int x, int y);
+
+void wallDetach(WallTile *tile);
+
+/**
+ * Wait at most timeoutMs for a frame newer than lastFrame. Returns number of the newest
+ * frame (may still be lastFrame after timeout), -1 once the coordinator is gone.
+ */
+long long wallWaitFrame(WallTile *tile, long long lastFrame, int timeoutMs);
+
+/**
+ * Copy the tile's rectangle of the newest frame into frame (its size is the tile size,
+ * cells outside the wall are empty) and tell the coordinator this tile has it.
+ */
+long long wallCopyFrame(WallTile *tile, Frame *frame);
+
+#endif
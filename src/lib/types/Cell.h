@@ -0,0 +1,34 @@
+#ifndef CELL_H
+#define CELL_H
+
+// What a screen cell shows, the encoder picks the colors from this.
+// Rain of the depth layers further back uses the dimmer MID and FAR shades,
+// REVEAL is what the rain uncovered of the reveal mask, OVERLAY text boxes over the rain
+enum {
+    STYLE_EMPTY = 0,
+    STYLE_TAIL,
+    STYLE_DROP,
+    STYLE_TAIL_MID,
+    STYLE_DROP_MID,
+    STYLE_TAIL_FAR,
+    STYLE_DROP_FAR,
+    STYLE_REVEAL,
+    STYLE_OVERLAY,
+    NUM_STYLES
+};
+
+#define NUM_SHADES 3 // near, mid, far
+
+typedef struct {
+    int c;               // unicode code point of the glyph
+    unsigned char style; // one of STYLE_*
+    unsigned char bg;    // STYLE_* whose color is the background, STYLE_EMPTY = terminal's own
+} Cell;
+
+// Same style in the given shade (0 is near)
+static inline unsigned char shadeStyle(unsigned char style, int shade)
+{
+    return style == STYLE_EMPTY ? STYLE_EMPTY : (unsigned char)(style + 2 * shade);
+}
+
+#endif
@@ -17,4 +17,70 @@
 #define ANSI_COLOR_DROP "\e[1;92m" /*"\x1b[37m"*/
 #define ANSI_COLOR_HI_BLACK "\e[0;90m"//looks like this is problematic, causes flashing
 
+// Depth layers further back, 16 colors only have faint (not everywhere) and normal
+#define ANSI_COLOR_MID_FONT "\x1b[2;32m"
+#define ANSI_COLOR_MID_DROP "\x1b[32m"
+#define ANSI_COLOR_FAR_FONT "\x1b[2;32m"
+#define ANSI_COLOR_FAR_DROP "\x1b[2;32m"
+
+// Cells the rain uncovered in reveal mode
+#define ANSI_COLOR_REVEAL "\x1b[1;97m"
+
+// Text boxes over the rain (debug header, clock)
+#define ANSI_COLOR_OVERLAY ANSI_COLOR_RED
+
+// Same palette for terminals with 256 colors
+#define ANSI_256_MAIN_FONT "\x1b[38;5;34m"
+#define ANSI_256_DROP "\x1b[1;38;5;120m"
+#define ANSI_256_BLUE "\x1b[38;5;27m"
+#define ANSI_256_MID_FONT "\x1b[38;5;28m"
+#define ANSI_256_MID_DROP "\x1b[38;5;71m"
+#define ANSI_256_FAR_FONT "\x1b[38;5;22m"
+#define ANSI_256_FAR_DROP "\x1b[38;5;28m"
+#define ANSI_256_REVEAL "\x1b[1;38;5;194m"
+#define ANSI_256_OVERLAY "\x1b[38;5;160m"
+
+// And for truecolor terminals
+#define ANSI_RGB_MAIN_FONT "\x1b[38;2;0;190;60m"
+#define ANSI_RGB_DROP "\x1b[1;38;2;170;255;170m"
+#define ANSI_RGB_BLUE "\x1b[38;2;40;80;220m"
+#define ANSI_RGB_MID_FONT "\x1b[38;2;0;120;40m"
+#define ANSI_RGB_MID_DROP "\x1b[38;2;90;190;100m"
+#define ANSI_RGB_FAR_FONT "\x1b[38;2;0;70;25m"
+#define ANSI_RGB_FAR_DROP "\x1b[38;2;40;120;50m"
+#define ANSI_RGB_REVEAL "\x1b[1;38;2;220;255;220m"
+#define ANSI_RGB_OVERLAY "\x1b[38;2;205;0;0m"
+
+// Same colors as background, for the lower half of a cell with subcells=half.
+// 16 colors have no faint background, every shade of green is the same there
+#define ANSI_BG_COLOR_FONT "\x1b[42m"
+#define ANSI_BG_COLOR_DROP "\x1b[102m"
+#define ANSI_BG_COLOR_REVEAL "\x1b[107m"
+#define ANSI_BG_256_MAIN_FONT "\x1b[48;5;34m"
+#define ANSI_BG_256_DROP "\x1b[48;5;120m"
+#define ANSI_BG_256_MID_FONT "\x1b[48;5;28m"
+#define ANSI_BG_256_MID_DROP "\x1b[48;5;71m"
+#define ANSI_BG_256_FAR_FONT "\x1b[48;5;22m"
+#define ANSI_BG_256_FAR_DROP "\x1b[48;5;28m"
+#define ANSI_BG_256_REVEAL "\x1b[48;5;194m"
+#define ANSI_BG_RGB_MAIN_FONT "\x1b[48;2;0;190;60m"
+#define ANSI_BG_RGB_DROP "\x1b[48;2;170;255;170m"
+#define ANSI_BG_RGB_MID_FONT "\x1b[48;2;0;120;40m"
+#define ANSI_BG_RGB_MID_DROP "\x1b[48;2;90;190;100m"
+#define ANSI_BG_RGB_FAR_FONT "\x1b[48;2;0;70;25m"
+#define ANSI_BG_RGB_FAR_DROP "\x1b[48;2;40;120;50m"
+#define ANSI_BG_RGB_REVEAL "\x1b[48;2;220;255;220m"
+
+// Palette above as RGB, for rasterized output (xterm default colors)
+#define RGB_COLOR_MAIN_FONT 0x00CD00 // 32
+#define RGB_COLOR_DROP 0x5CFF5C      // 1;92
+#define RGB_COLOR_BLUE 0x0000EE      // 34
+#define RGB_COLOR_MID_FONT 0x007828
+#define RGB_COLOR_MID_DROP 0x5ABE64
+#define RGB_COLOR_FAR_FONT 0x004619
+#define RGB_COLOR_FAR_DROP 0x287832
+#define RGB_COLOR_REVEAL 0xFFFFFF    // 1;97
+#define RGB_COLOR_OVERLAY 0xCD0000   // 31
+#define RGB_COLOR_BACKGROUND 0x000000
+
 #endif
\ No newline at end of file
@@ -0,0 +1,54 @@
+#ifndef ESCAPES_H
+#define ESCAPES_H
+
+// Terminal control sequences (besides the colors)
+
+// Control sequence introducer, the encoders put numbers and the final byte after it
+#define ESC_CSI "\x1b["
+
+#define ESC_CURSOR_HOME "\x1b[H"
+#define ESC_CURSOR_HIDE "\x1b[?25l"
+#define ESC_CURSOR_SHOW "\x1b[?25h"
+
+// Erase whole screen (ED 2) and rest of the line (EL 0), in the current background color
+#define ESC_CLEAR_SCREEN "\x1b[2J"
+#define ESC_CLEAR_LINE "\x1b[K"
+
+// CAN, terminal drops an escape sequence that was cut in half
+#define ESC_CANCEL "\x18"
+
+#define ESC_ALT_SCREEN_ON "\x1b[?1049h"
+#define ESC_ALT_SCREEN_OFF "\x1b[?1049l"
+
+#define ESC_CURSOR_MOVE "\x1b[%d;%dH"
+
+// Synchronized output (DEC private mode 2026), terminal shows the frame only when it's complete
+#define ESC_SYNC_BEGIN "\x1b[?2026h"
+#define ESC_SYNC_END "\x1b[?2026l"
+
+// DECRQM for mode 2026, answer is CSI ? 2026 ; Ps $ y
+#define ESC_SYNC_QUERY "\x1b[?2026$p"
+
+// Cursor position report (DSR 6), answer is CSI row ; column R
+#define ESC_CURSOR_REPORT "\x1b[6n"
+
+// Primary device attributes, every terminal answers this one
+#define ESC_DEVICE_ATTRIBUTES "\x1b[c"
+
+// Pixel graphics. Sixel is a DCS string (P2=1: pixels not set stay transparent),
+// kitty graphics an APC string, both end with ST
+#define ESC_SIXEL_BEGIN "\x1bP0;1;0q"
+#define ESC_KITTY_BEGIN "\x1b_G"
+#define ESC_STRING_END "\x1b\\"
+#define ESC_KITTY_DELETE_ALL ESC_KITTY_BEGIN "a=d,q=2" ESC_STRING_END
+
+// Focus reporting (DEC private mode 1004), terminal sends CSI I on focus in and CSI O on focus out
+#define ESC_FOCUS_REPORTS_ON "\x1b[?1004h"
+#define ESC_FOCUS_REPORTS_OFF "\x1b[?1004l"
+
+// Mouse reporting of every motion (mode 1003) in SGR encoding (1006):
+// CSI < button ; x ; y M on press and motion, m on release, x and y from 1
+#define ESC_MOUSE_REPORTS_ON "\x1b[?1003h\x1b[?1006h"
+#define ESC_MOUSE_REPORTS_OFF "\x1b[?1006l\x1b[?1003l"
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef GLYPH_SET_H
+#define GLYPH_SET_H
+
+// Read only table of symbols a pane rains with, shared between all panes
+typedef struct {
+    const char *name;
+    const int *glyphs; // unicode code points
+    int count;
+} GlyphSet;
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef OCCUPANCY_H
+#define OCCUPANCY_H
+
+#include <stdbool.h>
+
+/**
+ * How many drops every lane of a pane holds (the column they fall in, or the row for
+ * horizontal rain) and the set of lanes that have room for one more. A drop takes a
+ * lane from the set when it spawns and gives it back when it wraps, both O(1).
+ */
+typedef struct {
+    int lanes;      // lanes drops spawn in, 0 = not built yet
+    bool vertical;  // lanes are columns for down and up, rows for left and right
+    int limit;      // drops a lane may hold, one over the even share of the pane's drops
+    int capacity;   // lanes the arrays have room for
+    int *count;     // drops in every lane
+    int *slot;      // where the lane sits in free, -1 if it is full
+    int *free;      // lanes with room, in no particular order
+    int numFree;
+    unsigned int rng; // own generator, the glibc one takes a lock on every wrap
+} Occupancy;
+
+#endif
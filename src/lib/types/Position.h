@@ -5,6 +5,7 @@ typedef struct {
     int x;
     int y;
     int length;
+    int c; // symbol currently shown by the head
 } Position;
 
-#endif
\ No newline at end of file
+#endif
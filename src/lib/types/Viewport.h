@@ -0,0 +1,40 @@
+#ifndef VIEWPORT_H
+#define VIEWPORT_H
+
+#include <stdbool.h>
+
+#include "Position.h"
+#include "TailSegment.h"
+#include "GlyphSet.h"
+#include "Occupancy.h"
+
+/**
+ * One rain pane. Everything that used to be a global in matrix.c and
+ * describes the rain itself lives here, so many panes can run in one process.
+ * Pane is placed inside the terminal at (paddingLeft, paddingTop),
+ * drops and tails are kept in pane local coordinates.
+ */
+typedef struct Viewport {
+    int rows;
+    int columns;
+    int paddingBottom;
+    int paddingRight;
+    int paddingLeft;
+    int paddingTop;
+    int minLength;
+    int maxLength;
+    int tailCapacity; // allocated length of every tail
+    int numDrops;
+    int maxPerLane;   // drops a column (row for horizontal rain) may hold, 0 = no limit
+    int millis;
+    int direction;    // R for right, L for left, U for up, D for down
+    void (*updateDrops)(struct Viewport *vp); // kernel for the direction, see setViewportDirection
+    long long nextTick;
+    const GlyphSet *glyphs;
+    Position *drops;
+    TailSegment *tailSegments;
+    struct DropIndex *index; // drops by lane for pointer queries, NULL if not kept
+    Occupancy occupancy;     // drops per lane, new and wrapped drops go where there is room
+} Viewport;
+
+#endif
@@ -1,7 +1,7 @@
 /**
  * This program is based on https://github.com/alsception/snake
  * Instead of 1 snake, there are many snakes called drops, each with head and tail,
- * And there is only down direction. Every cycle every tail's segment take position of previous one,
+ * Drops fall down, or up, left or right (arrows and w/a/s). Every cycle every tail's segment take position of previous one,
  * and first takes head's position. There is no user input, except of debug parameter, and 'p' on keyboard to pause, q for exit.
  * It is only intended to show basic operations with arrays while creating something beautiful.
  * Few improvements could be done one day, eventualy
@@ -42,37 +42,75 @@
 #include <time.h>   // Used for random
 #include <locale.h> // Use for japanese lang
 #include <math.h>
+#include <poll.h>
 
-#include "lib/types/Position.h"
-#include "lib/types/TailSegment.h"
 #include "lib/types/Colors.h"
+#include "lib/types/Escapes.h"
+#include "lib/Glyphs.h"
+#include "lib/Viewport.h"
+#include "lib/Frame.h"
+#include "lib/Sink.h"
+#include "lib/Renderer.h"
+#include "lib/Bench.h"
+#include "lib/Terminal.h"
+#include "lib/Export.h"
+#include "lib/Options.h"
+#include "lib/Control.h"
+#include "lib/Memory.h"
+#include "lib/Trace.h"
+#include "lib/TraceFile.h"
+#include "lib/Parallax.h"
+#include "lib/Verify.h"
+#include "lib/Wall.h"
+#include "lib/Graphics.h"
+#include "lib/Engine.h"
+#include "lib/Reveal.h"
+#include "lib/Overlay.h"
+#include "lib/Stream.h"
+#include "lib/Soak.h"
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
 #endif
 
+#define MAX_CONTROL_DROPS 1000000
+#define KEY_RIGHT 0x100 // right arrow, 'd' is taken by debug
+#define KEY_FOCUS_IN 0x101  // focus reports (mode 1004) come in as keys
+#define KEY_FOCUS_OUT 0x102
+#define KEY_MOUSE 0x103     // SGR mouse report, the pointer is updated
+
 // Variables
 long long int cycle = 0;
 int rows = 0;
-int rowsPrevious = 0;
 int columns = 0;
-int columnsPrevious = 0;
-//!ATTENTION:
-//If you set debugMode to true, and padding bottom/top > 0, then theres some issues rendering...
-int paddingBottom = 0; //if debug mode this should be 1 smaller
-int paddingRight = 0;//This is more like padding right (but only after first rain cycle ends :/ )...
-int paddingLeft = 0;
-int paddingTop = 0; 
-int max_length = 15;  // Maximum length
-int min_length = 5;
-int direction = 'D'; // R for right, L for left, U for up, D for down
-int cf = 1000; //Number of cycles to completely redraw the screen (Constant redrawing causes flashing, but neccessary)
-int maxLength = 1000;
-int numDrops = 220;  // Total number of tail segments
+int numDrops = 220;  // Default number of drops per pane
+int columnDrops = 0;    // most drops one column (row) of a pane may hold, 0 = no limit
 bool cursorVisible = false;
 bool pausa = false;
 bool debugMode = false;
-int millis = 20;
+int millis = 20;     // Default frame delay per pane
+bool benchMode = false;
+bool verifyMode = false;
+long long skipCycles = -1; // cycles simulated before the first frame, -1 = until the screen is full
+unsigned int seed = 0; // 0 means seed from time
+const char *benchSavePath = NULL;
+const char *benchCheckPath = NULL;
+int syncMode = -1;        // -1 auto detect, 0 off, 1 on
+int repeatMode = -1;      // REP in the diff encoder, -1 auto detect, 0 off, 1 on
+bool syncOutput = false;  // Wrap frames in synchronized update
+bool clearPending = false; // Erase the screen with the next frame
+bool redrawPending = false; // Something changed, draw a frame now even if paused
+bool focused = true;
+long long lastInput = 0;   // ms of the last key or control command
+int idleSeconds = 0;       // without input for this long counts as background, 0 = never
+int backgroundFps = 2;     // frame rate when unfocused or idle, 0 = stop until something happens
+int mouseRadius = 0;       // drops keep this many cells away from the pointer, 0 = no mouse
+
+// Where the pointer ended up since the last frame, reports in between only move it
+struct {
+    int x, y;     // frame cell, x is -1 while the pointer is not over the rain
+    bool pressed; // a button went down since the last frame
+} pointer = { -1, -1, false };
 /*********************************************************************************************
     Here are the recommended frame delays in milliseconds (ms) for various refresh rates:
     choose between 17 and 67.
@@ -94,17 +132,82 @@ int millis = 20;
     (1 second ÷ 10 frames = 100 ms/frame) 
    ********************************************************************************************/
 
-Position *drops;
-Position *drops2;
-TailSegment *tailSegments;
+/**
+ * Requested placement of a pane inside the terminal.
+ * Zero columns/rows means "up to the edge of the terminal", 
+ * this is resolved again on every frame so panes follow the window size.
+ */
+typedef struct {
+    int left;
+    int top;
+    int columns;
+    int rows;
+    int millis;
+    int numDrops;
+    const GlyphSet *glyphs;
+} PaneSpec;
+
+PaneSpec paneSpecs[MAX_PANES];
+int numPaneSpecs = 0;
+int splitPanes = 0; // If > 0 terminal is split in this many panes side by side
+const GlyphSet *glyphs = NULL;
+
+Engine engine; // panes, layers, frame and what the terminal shows
+Reveal reveal; // engine.reveal points here when reveal= or reveal-text= is given
+
+// Debug header, clock and text= boxes over the rain, engine.overlay points here
+#define OVERLAY_Z_HEADER 100 // over every text= box with a lower z
+Overlay overlay;
+int headerBox = -1;
+int clockBox = -1;
+bool showClock = false;
+OutBuf out;
+OutputSink sink;
+long long maxBandwidth = 0; // bytes per second, 0 = unlimited
+
+const char *tracePath = NULL;
+int traceEvents = 1 << 20; // per thread, about 20 minutes of frames
+const char *controlPath = NULL;
+ControlServer control = { -1 };
 
 /**
- * TODO:
- * 1. If columns(width) < certain size, then dont print the header line.
- * 2. If rows <5 OR columns < 155 -> exit with message
- * 3. update commit instructions: gcc src/snake.c -o bin/snake 
- * 4 ON RESIZE -> CLEAR SCREEN  
+ * Settings that came over the control socket. They are only recorded when the
+ * command arrives and applied at the start of the next frame, -1/NULL = unchanged.
  */
+typedef struct {
+    int numDrops;
+    int millis;
+    const GlyphSet *glyphs;
+    int minLength;
+    int maxLength;
+    int colors;
+    int renderer;
+    int direction;
+} PendingSettings;
+
+PendingSettings pending = { -1, -1, NULL, -1, -1, -1, -1, 0 };
+long long statsFrames = 0; // frames sent at the time of the last stats command
+long long statsMillis = 0;
+
+char wallName[64] = "";   // wall=NAME:.. runs the coordinator, tile=NAME:.. one of its tiles
+WallOptions wallOptions = { wallName, 0, 0, 0, 0, 'D', 1, NULL, 0, -1 };
+bool tileMode = false;
+WallTile wallTile = { NULL, 0, -1, 0, 0 };
+long long tileFrame = 0;  // wall frame the tile shows
+
+int graphicsProtocol = GRAPHICS_NONE; // pixel output instead of text cells
+GraphicsOutput graphics;
+
+bool exportMode = false;
+ExportOptions exportOptions = { EXPORT_PPM, ".", 80, 24, 250, 0, 2, NULL };
+
+// Frames into a pipe or FIFO instead of a terminal, also when stdout is not one
+bool streamMode = false;
+StreamOptions streamOptions = { STREAM_ANSI, STDOUT_FILENO, 80, 24, 0, true, NULL };
+
+// Headless run that watches allocations and RSS, for screens that rain for weeks
+bool soakMode = false;
+SoakOptions soakOptions = { 0, 0, 80, 24, 10000, NULL, NULL };
 
 // Function to enable non-canonical mode
 // https://stackoverflow.com/questions/358342/canonical-vs-non-canonical-terminal-input
@@ -116,154 +219,198 @@ void enableNonCanonicalMode()
     tcsetattr(STDIN_FILENO, TCSANOW, &newSettings);
 }
 
-// Function to restore terminal to original settings
-void disableNonCanonicalMode()
+long long nowMillis()
 {
-    struct termios originalSettings;
-    tcgetattr(STDIN_FILENO, &originalSettings);
-    originalSettings.c_lflag |= (ICANON | ECHO);
-    tcsetattr(STDIN_FILENO, TCSANOW, &originalSettings);
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
 }
 
-void freeTails() 
+void cleanUp()
 {
-    for (int i = 0; i < numDrops; i++) 
-    {
-        free(tailSegments[i].x);
-        free(tailSegments[i].y);
-    }
-    free(tailSegments);
+    // Don't wait for a slow link to finish the frame, quit must be instant
+    sinkAbort(&sink);
+    if( syncOutput ) obPuts(&out, ESC_SYNC_END);
+    obPuts(&out, ANSI_COLOR_RESET);
+    if (graphicsProtocol == GRAPHICS_KITTY)
+        obPuts(&out, ESC_KITTY_DELETE_ALL);
+    sinkClose(&sink);
+    controlClose(&control);
+    traceClose();
+    obFlush(&out, STDOUT_FILENO);
+
+    restoreTerminal();
+    freeEngine(&engine);
+    if (graphicsProtocol != GRAPHICS_NONE)
+        freeGraphics(&graphics);
+    obFree(&out);
 }
 
-void cleanUp()
+void getWindowSize()
 {
-    disableNonCanonicalMode();  
-    freeTails();
+    struct winsize w;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &w) == -1)
+    {
+        perror("ioctl");
+        return;
+    }
+    rows = w.ws_row;
+    columns = w.ws_col;
 }
 
-void initializeDrops() 
+// Pixels of one terminal cell for the graphics output, not every terminal tells, then guess
+void getCellPixels(int *width, int *height)
 {
-    //Instead of hardcoding we assign drops dynamicaly with this parameters:
-    //1. n - number of drops to initialize
-    //2. max number for x
-    //3. max number for y
-    //4. max length
-    //5. points 2,3,4 should be random numbers from 0 to max
-
-    printf("initializing drops...\n");
-    int n = numDrops;           // Number of drops
-    int max_x = columns;      // Maximum x value
-    int max_y = rows;      // Maximum y value
-    max_length = (rows-5)/2;  // Maximum length
-    min_length = 5;
-
-    // Allocate memory for n Position structures
-    drops = (Position*)malloc(n * sizeof(Position));
-    printf("Memory allocated\n");
-    if (drops == NULL) 
+    struct winsize w;
+    *width = 10;
+    *height = 20;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &w) == -1 || w.ws_col == 0 || w.ws_row == 0)
+        return;
+    if (w.ws_xpixel >= w.ws_col && w.ws_ypixel >= w.ws_row)
     {
-        fprintf(stderr, "Memory allocation failed\n");
-        exit(EXIT_FAILURE);
+        *width = w.ws_xpixel / w.ws_col;
+        *height = w.ws_ypixel / w.ws_row;
     }
+}
 
-    // Seed the random number generator
-    srand((unsigned int)time(NULL));
-
-    printf("initializing drops positions\n");
+// With sub-cells the simulation runs on the finer grid, pane geometry is in sub-cells too
+static void scalePanes()
+{
+    int sx, sy;
+    subcellScale(engine.subcells, &sx, &sy);
 
-    // Initialize each Position with random values
-    for (int i = 0; i < n; i++) 
+    for (int i = 0; i < engine.numPanes; i++)
     {
-        printf("initializing drop %i \n",i);
-        drops[i].x = rand() % (max_x + 1);        // Random x in range [0, max_x]
-        drops[i].y = rand() % (max_y + 1);        // Random y in range [0, max_y]
-        drops[i].length = min_length + rand() % (max_length - min_length + 1); // Random length in range [min_length, max_length]
-
-        printf("drop created x,y,l: %i,%i,%i \n",drops[i].x,drops[i].y,drops[i].length);
+        engine.panes[i].paddingLeft *= sx;
+        engine.panes[i].paddingTop *= sy;
+        engine.panes[i].columns *= sx;
+        engine.panes[i].rows *= sy;
     }
-    system("clear");
 }
 
-void getWindowSize()
+// Resolve the requested pane geometry against current terminal size
+void layoutPanes()
 {
-    struct winsize w;
-    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &w) == -1)
+    Viewport *panes = engine.panes;
+    int height = rows;
+
+    if (splitPanes > 0)
     {
-        perror("ioctl");
+        // Equal panes side by side with one empty column between them
+        int width = (columns - (splitPanes - 1)) / splitPanes;
+        if (width < 1) width = 1;
+
+        for (int i = 0; i < engine.numPanes; i++)
+        {
+            panes[i].paddingLeft = i * (width + 1);
+            panes[i].paddingTop = 0;
+            panes[i].columns = width;
+            panes[i].rows = height;
+        }
+        scalePanes();
         return;
     }
-    rows = w.ws_row;
-    columns = w.ws_col;
-    int maxLength = rows * columns;
-}
-
-char getRandomLatinChar(){
-    char randomletter = 'A' + (random() % 26);
-    return randomletter;
-}
 
-char getRandomFullLatinChar(){
-    char randomletter = '!' + (random() % (126-32));//full latin alfabet is going from 32(!) to 126
-    return randomletter;
+    for (int i = 0; i < engine.numPanes; i++)
+    {
+        PaneSpec *spec = &paneSpecs[i];
+        panes[i].paddingLeft = spec->left;
+        panes[i].paddingTop = spec->top;
+        panes[i].columns = spec->columns > 0 ? spec->columns : columns - spec->left;
+        panes[i].rows = spec->rows > 0 ? spec->rows : height - spec->top;
+        if (panes[i].columns < 1) panes[i].columns = 1;
+        if (panes[i].rows < 1) panes[i].rows = 1;
+    }
+    scalePanes();
 }
 
-char getRandomLatinChar2(){
-    //What we dont need is empty space, dot, comma... bc it doesnt look good
-    char randomletter = 48 + (random() % (93-48));//full latin alfabet is going from 32(!) to 126
-    return randomletter;
-}
+void initPanes()
+{
+    if (numPaneSpecs == 0 && splitPanes == 0)
+    {
+        // By default one pane covering the whole terminal
+        paneSpecs[0] = (PaneSpec){ 0, 0, 0, 0, 0, 0, NULL };
+        numPaneSpecs = 1;
+    }
 
-char getRandomChar(){
-    return getRandomFullLatinChar();
-}
+    engine.numPanes = splitPanes > 0 ? splitPanes : numPaneSpecs;
 
-void initTails(int numDrops, int maxLength) {
-    tailSegments = (TailSegment *)malloc(numDrops * sizeof(TailSegment));
-    
-    for (int i = 0; i < numDrops; i++) {
-        tailSegments[i].x = (int *)malloc(maxLength * sizeof(int));
-        tailSegments[i].y = (int *)malloc(maxLength * sizeof(int));
-        tailSegments[i].c = (int *)malloc(maxLength * sizeof(int));
-        
-        // Initialize each segment's arrays
-        for (int j = 0; j < maxLength; j++) {
-            tailSegments[i].x[j] = 0;
-            tailSegments[i].y[j] = 0;
-            tailSegments[i].c[j] = getRandomChar();
-        }
+    for (int i = 0; i < engine.numPanes; i++)
+    {
+        PaneSpec *spec = splitPanes > 0 ? NULL : &paneSpecs[i];
+        Viewport *vp = &engine.panes[i];
+
+        setupViewport(vp, 0, 0, 1, 1);
+        setViewportDirection(vp, engine.direction);
+        vp->millis = (spec && spec->millis > 0) ? spec->millis : millis;
+        vp->numDrops = (spec && spec->numDrops > 0) ? spec->numDrops : numDrops;
+        vp->maxPerLane = columnDrops;
+        vp->glyphs = (spec && spec->glyphs) ? spec->glyphs : glyphs;
     }
+
+    layoutPanes();
+    startEngine(&engine, skipCycles);
 }
 
-void initTail()
-{  
-    initTails(numDrops,150);
+// Rain starts over, everything of the panes is freed and allocated again
+void resetRain()
+{
+    stopEngine(&engine);
+    initPanes();
+    clearPending = true;
 }
 
 void initialize()
 {
     // Set the locale to UTF-8 to use other chars
     setlocale(LC_ALL, "");
-    system("clear");
     
     // Initial size print and frame
     // This is important to get rows and columns    
     getWindowSize();
 
-    //TODO:
-    //Take millis from command line or menu
-
-    //TODO 
-    /*** REALOCATE MEMORY IF WINDOW SIZE IS CHANGED ***/
-
-    initializeDrops();
+    // Seed the random number generator
+    unsigned int s = seed ? seed : (unsigned int)time(NULL);
+    srand(s);
+    srandom(s);
 
-    initTail();
+    resetRain();
 
     enableNonCanonicalMode();
     fcntl(STDIN_FILENO, F_SETFL, O_NONBLOCK); // Set input to non-blocking mode
 }
 
 
+// Rest of an SGR mouse report after CSI <: button ; x ; y and M (press, motion) or m (release)
+static int readMouseReport()
+{
+    int values[3] = { 0, 0, 0 };
+    int n = 0;
+    int ch;
+
+    while ((ch = fgetc(stdin)) != EOF)
+    {
+        if (ch >= '0' && ch <= '9')
+        {
+            if (values[n] < 100000)
+                values[n] = values[n] * 10 + ch - '0';
+        }
+        else if (ch == ';' && n < 2)
+            n++;
+        else
+            break;
+    }
+    if (n != 2 || (ch != 'M' && ch != 'm'))
+        return -1;
+
+    pointer.x = values[1] - 1;
+    pointer.y = values[2] - 1;
+    // Motion has bit 32 set, the wheel bit 64
+    if (ch == 'M' && (values[0] & (32 | 64)) == 0)
+        pointer.pressed = true;
+    return KEY_MOUSE;
+}
+
 // Function to read keypresses including arrow keys
 int readKeyPress() 
 {
@@ -280,8 +427,11 @@ int readKeyPress()
             {
                 case 'A': return 'W'; // Up arrow
                 case 'B': return 'S'; // Down arrow
-                //case 'C': return 'D'; // Right arrow. will not use because of debug mode
+                case 'C': return KEY_RIGHT; // Right arrow, not 'D' because of debug mode
                 case 'D': return 'A'; // Left arrow
+                case 'I': return KEY_FOCUS_IN;
+                case 'O': return KEY_FOCUS_OUT;
+                case '<': return readMouseReport();
                 default: return -1; // Unknown escape sequence
             }
         }
@@ -293,26 +443,46 @@ int handleKeypress()
 {
     // Check for keyboard input
     int ch = readKeyPress();
+
+    // A storm of pointer motion is taken in at once, the next frame makes one query
+    // for wherever the pointer ended up. Only keys draw a frame right away
+    while (ch == KEY_MOUSE)
+    {
+        lastInput = nowMillis();
+        ch = readKeyPress();
+    }
+
     if (ch != EOF)
     {
-        if ((ch == 'a' || ch == 'A') && (direction != 'R'))
-            direction = 'L';
+        // Any input wakes up a paused or idle screen
+        redrawPending = true;
+        lastInput = nowMillis();
+
+        if (ch == KEY_FOCUS_IN || ch == KEY_FOCUS_OUT)
+        {
+            focused = ch == KEY_FOCUS_IN;
+            pointer.x = -1; // it left with the focus, comes back with the next report
+        }
+
+        // Unlike the snake, rain can turn around on the spot
+        else if (ch == 'a' || ch == 'A')
+            setEngineDirection(&engine, 'L');
 
-        //else if ((ch == 'd' || ch == 'D') && (direction != 'L'))
-        //    direction = 'R';
+        else if (ch == KEY_RIGHT)
+            setEngineDirection(&engine, 'R');
 
-        else if ((ch == 'w' || ch == 'W') && (direction != 'D'))
-            direction = 'U';
+        else if (ch == 'w' || ch == 'W')
+            setEngineDirection(&engine, 'U');
 
-        else if ((ch == 's' || ch == 'S') && (direction != 'U'))
-            direction = 'D';
+        else if (ch == 's' || ch == 'S')
+            setEngineDirection(&engine, 'D');
 
         else if (ch == 'p' || ch == 'P')
             pausa = !pausa;
 
         else if (ch == 'd' || ch == 'D'){
             debugMode = !debugMode;    
-            system("clear");
+            clearPending = true;
         }            
 
         else if (ch == 'r' || ch == 'R')
@@ -320,8 +490,6 @@ int handleKeypress()
 
         else if (ch == 'q' || ch == 'Q')
             return 0; // Quit the game
-
-            //TODO: add pause
     }
     return 1;
 }
@@ -329,358 +497,1004 @@ int handleKeypress()
 void resetCursorPosition()
 {
     getWindowSize();//update window size
+    encodeHome(&out);
+}
+
+// Upper line with informations and the clock. They are boxes over the rain like the text= ones,
+// set every frame but sent only when their text changes
+void updateOverlay()
+{
+    char text[OVERLAY_TEXT_SIZE];
+
+    if (debugMode)
+    {
+        snprintf(text, sizeof(text),
+            "Terminal size:: "
+            "y:%d rows | "
+            "x:%d columns | "
+            "y-offset: %d | "
+            "refresh rate: %d | "
+            "numDrops: %d | "
+            "panes: %d | "
+            "debugMode: %d | ",
+            rows, columns, engine.panes[0].paddingBottom, engine.panes[0].millis, countDrops(&engine), engine.numPanes, debugMode);
+        setOverlayText(&overlay, headerBox, text);
+    }
+    else
+        setOverlayText(&overlay, headerBox, NULL);
+
+    if (showClock)
+    {
+        time_t now = time(NULL);
+        strftime(text, sizeof(text), " %H:%M:%S ", localtime(&now));
+        setOverlayText(&overlay, clockBox, text);
+    }
+}
+
+void printGameOverScreen()
+{
+    printf("\nWake up, Neo...\n");
+    printf("Cycles rained: %lld \n", cycle);
+    printf(ESC_CURSOR_SHOW); // Reenable cursor
+}
 
-    //TODO 
-    //If window size changed -> then clear the screen
-    //system("clear");
+// Put the terminal back and say goodbye, or why there was nobody to say it to
+int finishRun()
+{
+    int error = sink.error;
 
-    printf("\r"); //go to start of the line
-    for(int i = 0; i< rows; i++)
+    cleanUp();
+    if (error != 0)
     {
-        printf("\033[A");
-    } 
+        fprintf(stderr, "Output failed: %s\n", strerror(error));
+        return EXIT_FAILURE;
+    }
+    if (!tileMode)
+        printGameOverScreen();
+    return 0;
 }
 
-// Return true if rain drop is present at given x,y position
-bool checkDrop(int x, int y)
+// Compose all panes into one frame
+void printContent()
 {
-    for (int i = 0; i < numDrops; i++) 
+    if (tileMode)
     {
-        if (x == drops[i].x && y == drops[i].y)
-            return true;
+        resizeFrame(&engine.frame, columns, rows);
+        tileFrame = wallCopyFrame(&wallTile, &engine.frame);
+        drawOverlay(&overlay, &engine.frame);
     }
-   return false;
+    else
+        composeEngine(&engine, columns, rows);
+
+    if (graphicsProtocol != GRAPHICS_NONE)
+        encodeGraphics(&graphics, &out, &engine.frame, &engine.shown, 0, rows);
+    else
+        encodeEngine(&engine, &out, 0, debugMode);
 }
 
-// Return true if rain tail lastindex is present at given x,y position
-bool isLastTailElement(int x, int y)
+void render()
 {
-    for (int i = 0; i < numDrops; i++) 
+    // Link is still busy with the previous frame, skip this one.
+    // Next frame that goes out is a diff against what was really sent, so nothing is lost
+    if( !sinkReady(&sink) )
     {
-        for (int j = drops[i].length-2; j < drops[i].length; j++) 
-        {
-            if (x == tailSegments[i].x[j] && y == tailSegments[i].y[j]) 
-            {
-                return true;
-            }
-        }
+        sink.framesDropped++;
+        return;
+    }
+
+    if( syncOutput ) obPuts(&out, ESC_SYNC_BEGIN);
+
+    // Erase in the same frame that repaints, so nothing blank is ever shown
+    if( clearPending ){
+        obPuts(&out, ANSI_COLOR_RESET ESC_CLEAR_SCREEN);
+        freeFrame(&engine.shown);
+        clearPending = false;
+    }
+
+    resetCursorPosition();    
+    layoutPanes();
+
+    updateOverlay();
+
+    printContent();
+    
+    if( !cursorVisible ) obPuts(&out, ESC_CURSOR_HIDE); // Remove cursor and flashing
+
+    if( syncOutput ) obPuts(&out, ESC_SYNC_END);
+
+    // Whole frame goes out at once, without blocking
+    sinkSubmit(&sink, &out, nowMillis());
+}
+
+// Advance every pane whose delay has passed, return ms until the next one is due
+int updateRainData()
+{
+    long long now = nowMillis();
+    long long next = tickEngine(&engine, now, pausa);
+    if (next < 0 || next > now + millis)
+        next = now + millis;
+
+    int delay = (int)(next - now);
+    return delay > 0 ? delay : 1;
+}
+
+// Apply settings from the control socket, drops keep falling where they are
+void applyPendingSettings()
+{
+    for (int i = 0; i < numPaneSpecs; i++)
+    {
+        // Per pane values would win over the new ones after a reset
+        if (pending.numDrops >= 0) paneSpecs[i].numDrops = 0;
+        if (pending.millis > 0) paneSpecs[i].millis = 0;
+        if (pending.glyphs != NULL) paneSpecs[i].glyphs = NULL;
+    }
+
+    for (int i = 0; i < engine.numPanes; i++)
+    {
+        Viewport *vp = &engine.panes[i];
+        if (pending.numDrops >= 0) resizeDrops(vp, pending.numDrops);
+        if (pending.millis > 0) vp->millis = pending.millis;
+        if (pending.glyphs != NULL) vp->glyphs = pending.glyphs;
+        if (pending.minLength > 0) setDropLengths(vp, pending.minLength, pending.maxLength);
+    }
+    syncEngineLayers(&engine);
+
+    if (pending.numDrops >= 0) numDrops = pending.numDrops;
+    if (pending.millis > 0) millis = pending.millis;
+    if (pending.glyphs != NULL) glyphs = pending.glyphs;
+    if (pending.minLength > 0)
+    {
+        engine.minLength = pending.minLength;
+        engine.maxLength = pending.maxLength;
     }
-    return false;
+    if (pending.colors > 0)
+    {
+        engine.colors = pending.colors;
+        freeFrame(&engine.shown); // every cell has to be sent again in new colors
+    }
+    if (pending.renderer >= 0)
+    {
+        engine.renderer = pending.renderer;
+        freeFrame(&engine.shown);
+    }
+
+    if (pending.direction != 0)
+        setEngineDirection(&engine, pending.direction);
+
+    pending = (PendingSettings){ -1, -1, NULL, -1, -1, -1, -1, 0 };
 }
 
-// Return true if rain tail lastindex is present at given x,y position
-bool isMiddleTailElement(int x, int y)
+// One line from the control socket
+void handleControlCommand(const char *line, OutBuf *reply)
 {
-    for (int i = 0; i < numDrops; i++) 
+    char key[32], value[64];
+    int a, b;
+
+    redrawPending = true;
+    lastInput = nowMillis();
+
+    if (strcmp(line, "stats") == 0)
+    {
+        long long now = nowMillis();
+        long long frames = sink.framesSent - statsFrames;
+        double fps = now > statsMillis ? frames * 1000.0 / (now - statsMillis) : 0;
+        statsFrames = sink.framesSent;
+        statsMillis = now;
+
+        obPrintf(reply, "cycle %lld fps %.1f panes %d drops %d millis %d renderer %s colors %s "
+            "frames %lld dropped %lld bytes %lld stalls %lld allocs %lld\n",
+            cycle, fps, engine.numPanes, countDrops(&engine), millis, rendererName(engine.renderer), colorDepthName(engine.colors),
+            sink.framesSent, sink.framesDropped, sink.bytesWritten, sink.stalls, allocStats.allocs);
+    }
+    else if (strcmp(line, "help") == 0)
+    {
+        obPuts(reply, "set drops N | set fps N | set millis N | set length MIN MAX | "
+            "set glyphs NAME | set colors 16|256|truecolor | set renderer NAME | set direction down|up|left|right | stats\n");
+    }
+    else if (sscanf(line, "set length %d %d", &a, &b) == 2)
     {
-        for (int j = drops[i].length/2-1; j <= drops[i].length/2; j++) 
+        if (a < 1 || b < a)
+            obPuts(reply, "error length needs 1 <= MIN <= MAX\n");
+        else
         {
-            if (x == tailSegments[i].x[j] && y == tailSegments[i].y[j]) 
-            {
-                return true;
-            }
+            pending.minLength = a;
+            pending.maxLength = b;
+            obPuts(reply, "ok\n");
         }
     }
-    return false;
+    else if (sscanf(line, "set %31s %63s", key, value) == 2)
+    {
+        int n = atoi(value);
+
+        if (strcmp(key, "drops") == 0 && n >= 0 && n <= MAX_CONTROL_DROPS)
+            pending.numDrops = n;
+        else if (strcmp(key, "fps") == 0 && n > 0 && n <= 1000)
+            pending.millis = 1000 / n;
+        else if (strcmp(key, "millis") == 0 && n > 0)
+            pending.millis = n;
+        else if (strcmp(key, "glyphs") == 0 && findGlyphSet(value) != NULL)
+            pending.glyphs = findGlyphSet(value);
+        else if (strcmp(key, "colors") == 0 && parseColorDepth(value) > 0)
+            pending.colors = parseColorDepth(value);
+        else if (strcmp(key, "renderer") == 0 && findRenderer(value) >= 0)
+            pending.renderer = findRenderer(value);
+        else if (strcmp(key, "direction") == 0 && parseDirection(value) != 0)
+            pending.direction = parseDirection(value);
+        else
+        {
+            obPrintf(reply, "error bad value '%s' for '%s'\n", value, key);
+            return;
+        }
+        obPuts(reply, "ok\n");
+    }
+    else
+    {
+        obPrintf(reply, "error unknown command '%s', try help\n", line);
+    }
 }
 
-// Return index of snake's tail element if present at given x,y position
-// Otherwise return -1
-int checkTail(int x, int y)
+int refreshScreen()
 {
-   for (int i = 0; i < numDrops; i++) 
-   {
-        for (int j = 0; j < drops[i].length; j++) 
+    applyPendingSettings();
+
+    // Wherever the pointer is now, drops make way; one query per frame however many reports came
+    if (mouseRadius > 0 && pointer.x >= 0 && !pausa)
+    {
+        pointerEngine(&engine, pointer.x, pointer.y, mouseRadius, pointer.pressed);
+        pointer.pressed = false;
+    }
+
+    int delay = updateRainData();
+    render();    
+    return delay;
+}
+
+// Sleep until timeout (-1 = no timeout), a key is pressed, the window is resized
+// or the terminal takes the rest of the frame
+void waitForEvents(int timeoutMs)
+{
+    struct pollfd fds[4 + CONTROL_MAX_CLIENTS];
+    int n = 0;
+
+    fds[n++] = (struct pollfd){ STDIN_FILENO, POLLIN, 0 };
+    fds[n++] = (struct pollfd){ watchResize(), POLLIN, 0 };
+    n += controlPollFds(&control, fds + n, 1 + CONTROL_MAX_CLIENTS);
+
+    if( !sinkReady(&sink) )
+    {
+        // With bandwidth cap the fd is writable but we may not write yet, just come back soon
+        if( maxBandwidth > 0 )
         {
-            if (x == tailSegments[i].x[j] && y == tailSegments[i].y[j]) 
-            {
-                //return i;  // Return the index of the segment
-                return tailSegments[i].c[j];//actually return char
-            }
+            if( timeoutMs < 0 || timeoutMs > 10 ) timeoutMs = 10;
+        }
+        else
+        {
+            fds[n++] = (struct pollfd){ STDOUT_FILENO, POLLOUT, 0 };
         }
     }
-    return -1;
+
+    poll(fds, n, timeoutMs);
 }
 
-// Upper line with informations
-void printHeaderLine()
-{   
-    printf(
-        "\r" ANSI_COLOR_RED "Terminal size:: "
-        "y:%d rows | "
-        "x:%d columns | "
-        "y-offset: %d | "
-        "refresh rate: %d | "
-        "numDrops: %d | "
-        "debugMode: %d | " 
-        "     \n"//empty space is need 
-        ANSI_COLOR_RESET, rows, columns, paddingBottom, millis, numDrops, debugMode);   
+// Rain into a pipe: same engine, panes, layers and boxes as on the terminal, no terminal handling
+int runStreamMode()
+{
+    if (graphicsProtocol != GRAPHICS_NONE)
+        fprintf(stderr, "graphics= is ignored with stream\n");
+    if (repeatMode == 0)
+        engine.features &= ~ENCODE_REPEAT;
+
+    unsigned int s = seed ? seed : (unsigned int)time(NULL);
+    srand(s);
+    srandom(s);
+
+    columns = streamOptions.columns;
+    rows = streamOptions.rows;
+    initPanes();
+    streamOptions.update = updateOverlay;
+
+    int rc = runStream(&engine, &streamOptions);
+    freeEngine(&engine);
+    return rc;
+}
 
-    // You can also use Unicode escape sequences
-    //printf("\u30AB\u30BF\u30AB\u30CA");
+// Rain as images: same engine, panes, layers, reveal and boxes as on the terminal
+int runExportMode()
+{
+    unsigned int s = seed ? seed : 1234;
+    srand(s);
+    srandom(s);
+
+    columns = exportOptions.columns;
+    rows = exportOptions.rows;
+    initPanes();
+    exportOptions.update = updateOverlay;
+    if (exportOptions.threads <= 0)
+        exportOptions.threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+    int rc = runExport(&engine, &exportOptions);
+    freeEngine(&engine);
+    return rc;
 }
 
-void printGameOverScreen()
+// Headless rain with the options given, reset every so often like someone pressing 'r'
+int runSoakMode()
 {
-    printf("\nWake up, Neo...\n");
-    printf("Cycles rained: %lld \n", cycle);
-    printf("\e[?25h"); // Reenable cursor
+    unsigned int s = seed ? seed : 1234;
+    srand(s);
+    srandom(s);
+
+    columns = soakOptions.columns = exportOptions.columns;
+    rows = soakOptions.rows = exportOptions.rows;
+    initPanes();
+    soakOptions.reset = resetRain;
+    soakOptions.update = updateOverlay;
+
+    int rc = runSoak(&engine, &soakOptions);
+    freeEngine(&engine);
+    return rc;
 }
 
-void printTail(int tailIndex, int c, bool isLast, bool isMiddle)
+// Show our rectangle of a wall, simulation runs in the coordinator
+void runTile()
 {
-    char cc = getRandomChar();
+    getWindowSize();
+    fcntl(STDIN_FILENO, F_SETFL, O_NONBLOCK);
 
-    if( /*isMiddle*/false )
-    {
-        printf(ANSI_COLOR_MAIN_FONT);
-        putchar( cc );  
-    }       
-    else
+    while (1)
     {
-        printf(ANSI_COLOR_MAIN_FONT);
-        putchar( c );  
+        int ch = readKeyPress();
+        if (ch == 'q' || ch == 'Q')
+            break;
+        if (ch == 'd' || ch == 'D')
+        {
+            debugMode = !debugMode;
+            clearPending = true;
+            redrawPending = true;
+        }
+        if (takeResize())
+            redrawPending = true;
+
+        // Link still busy, the wall waits for us (up to a limit) so no frame is lost
+        if (!sinkReady(&sink))
+        {
+            sinkPump(&sink, nowMillis());
+            waitForEvents(20);
+            continue;
+        }
+
+        long long latest = wallWaitFrame(&wallTile, tileFrame, 20);
+        if (latest < 0)
+            break; // coordinator is gone
+        if (latest != tileFrame || redrawPending)
+        {
+            redrawPending = false;
+            cycle++;
+            TRACE_BEGIN("frame");
+            render();
+            TRACE_END("frame");
+        }
+        sinkPump(&sink, nowMillis());
+        if (sink.error != 0)
+            break; // terminal is gone, nothing to show the tile on
     }
-        
-    printf(ANSI_COLOR_RESET);
 }
 
-void printDrop()
+// Accepts plain bytes per second or with k/m suffix, e.g. 960, 64k, 1m
+long long parseBandwidth(const char *arg)
 {
-    char c = getRandomChar();
-    printf( ANSI_COLOR_DROP );
-    //printf("\e[0;102m"); backgroun
-    putchar( c );  
-    printf( ANSI_COLOR_RESET );
+    char *end;
+    double value = strtod(arg, &end);
+    if (*end == 'k' || *end == 'K') value *= 1000;
+    else if (*end == 'm' || *end == 'M') value *= 1000 * 1000;
+    return value > 0 ? (long long)value : 0;
 }
 
-void printEmptyContent( int x, int y, int width, int depth )
+// Frames, or a duration with s/m/h/d suffix, e.g. 100000, 90s, 12h
+bool parseSoak(const char *arg)
 {
-    if(debugMode)
+    char *end;
+    long long value = strtoll(arg, &end, 10);
+    long long unit = *end == 's' ? 1 : *end == 'm' ? 60 : *end == 'h' ? 3600 : *end == 'd' ? 86400 : 0;
+
+    soakMode = true;
+    if (value <= 0 || (*end != 0 && (unit == 0 || end[1] != 0)))
     {
-        //TODO-_ BUG: THIS ANSI COLOR ESCAPES CAUSES FLASHING 
-        printf( ANSI_COLOR_BLUE );
-        putchar( '.' );
-        //printf( ANSI_COLOR_RESET );
-    }else{
-        putchar( ' ' );
+        fprintf(stderr, "Bad soak '%s', expected FRAMES or a duration like 90s, 30m, 12h, 7d\n", arg);
+        return false;
     }
+    if (unit > 0)
+        soakOptions.seconds = value * unit;
+    else
+        soakOptions.cycles = value;
+    return true;
 }
 
-void printContent()
+// X,Y[,Z]:TEXT, a literal \n in the text starts a new line
+bool parseTextBox(const char *arg)
 {
-    int depth = (rows - 1 - paddingBottom);
-    depth = depth/1;
-    if(debugMode) depth--;
-    int width = (columns - 1);
-    int tailIndexChar = -1;
-    bool hasDrop = false;
-    bool isLast = false;
-    bool isMiddle = false;
+    int x, y, z = 0, n = 0, m = 0;
+    char text[OVERLAY_TEXT_SIZE];
 
-    //Screen printing is done line by line starting from top
-    for (int y = 0; y <= depth; y++)
+    if (sscanf(arg, "%d,%d%n", &x, &y, &n) == 2 && arg[n] == ',' && sscanf(arg + n, ",%d%n", &z, &m) == 1)
+        n += m;
+    if (n == 0 || arg[n] != ':')
     {
-        if (y > 0) printf("\n"); // Start at new line
+        fprintf(stderr, "Bad text '%s', expected X,Y[,Z]:TEXT\n", arg);
+        return false;
+    }
 
-        for (int x = 0; x <= width; x++)
-        {           
-                       
-            if( x<paddingLeft || y < paddingTop )
-            {
-                printEmptyContent( x, y, width, depth );
-            }
-            else
-            {
-                // 1. Check if the screen cell contains drop or tail
-                hasDrop = checkDrop( x, y );
-                tailIndexChar = checkTail( x, y );
-                isLast = isLastTailElement( x, y );
-                isMiddle = isMiddleTailElement( x, y );
-
-                // 2. Print appropriate element
-                if ( hasDrop )
-                {
-                    printDrop( tailIndexChar );
-                }
-                else if ( tailIndexChar >= 0 )
-                {
-                    printTail( tailIndexChar, tailIndexChar, isLast, isMiddle);
-                }
-                else
-                {
-                    printEmptyContent( x, y, width, depth );
-                }
-            }
-            
+    int len = 0;
+    for (const char *p = arg + n + 1; *p && len < OVERLAY_TEXT_SIZE - 1; p++)
+    {
+        if (p[0] == '\\' && p[1] == 'n')
+        {
+            text[len++] = '\n';
+            p++;
         }
+        else
+            text[len++] = *p;
     }
-    fflush(stdout);
-}
+    text[len] = 0;
 
-void gameOver()
-{
-    disableNonCanonicalMode();
-    //free memori...
-    printGameOverScreen();
-    exit(0);
+    // Two boxes stay free for the debug header and the clock
+    if (overlay.numBoxes >= MAX_OVERLAY_BOXES - 2)
+    {
+        fprintf(stderr, "Too many text boxes, max is %d\n", MAX_OVERLAY_BOXES - 2);
+        return false;
+    }
+    setOverlayText(&overlay, addOverlayBox(&overlay, x, y, z, 0, STYLE_OVERLAY), text);
+    return true;
 }
 
-void updateDropPositionDown()
+// pane=WxH+X+Y[:glyphs[:millis[:drops]]] ,W or H 0 means up to the edge
+bool parsePaneSpec(const char *arg)
 {
-    for (int i = 0; i < numDrops; i++) 
+    if (numPaneSpecs >= MAX_PANES)
     {
-	    //Move it one position down by y axis
-        drops[i].y++;
+        fprintf(stderr, "Too many panes, max is %d\n", MAX_PANES);
+        return false;
+    }
+
+    PaneSpec spec = { 0, 0, 0, 0, 0, 0, NULL };
+    char glyphName[32] = "";
 
-        //If arrived at the end -> go back to top
-        if (drops[i].y > rows)
+    int n = sscanf(arg, "%dx%d+%d+%d:%31[^:]:%d:%d",
+        &spec.columns, &spec.rows, &spec.left, &spec.top, glyphName, &spec.millis, &spec.numDrops);
+    if (n < 4)
+    {
+        fprintf(stderr, "Bad pane '%s', expected WxH+X+Y[:glyphs[:millis[:drops]]]\n", arg);
+        return false;
+    }
+    if (n >= 5)
+    {
+        spec.glyphs = findGlyphSet(glyphName);
+        if (spec.glyphs == NULL)
         {
+            fprintf(stderr, "Unknown glyphs '%s'\n", glyphName);
+            return false;
+        }
+    }
 
-            drops[i].y = 0;
+    paneSpecs[numPaneSpecs++] = spec;
+    return true;
+}
 
-            //Also shift it to the right after the cycle ends, so it doesnt look stuck
+// Killed by a signal, still leave the trace behind
+static void dumpTrace()
+{
+    traceDump();
+}
 
-            drops[i].x++;
+// The library hands this back as an error, for the app it is the end
+static void outOfMemory(size_t size)
+{
+    fprintf(stderr, "Memory allocation failed (%zu bytes)\n", size);
+    exit(EXIT_FAILURE);
+}
 
-            if(drops[i].x > columns - paddingRight-1)
-            {
-                drops[i].x = 0;
-            }
-        }
+// Option handlers, one per command line option
+
+static bool optDebug(const char *v)     { (void)v; debugMode = true; return true; }
+static bool optPane(const char *v)      { return parsePaneSpec(v); }
+static bool optText(const char *v)      { return parseTextBox(v); }
+static bool optClock(const char *v)     { (void)v; showClock = true; return true; }
+static bool optBench(const char *v)     { (void)v; benchMode = true; return true; }
+static bool optBenchSave(const char *v) { benchMode = true; benchSavePath = v; return true; }
+static bool optBenchCheck(const char *v){ benchMode = true; benchCheckPath = v; return true; }
+static bool optVerify(const char *v)    { (void)v; verifyMode = true; return true; }
+static bool optSoak(const char *v)      { return parseSoak(v); }
+static bool optSoakReset(const char *v) { soakOptions.resetEvery = atoi(v); return true; }
+static bool optIdle(const char *v)      { idleSeconds = atoi(v); return true; }
+static bool optBackgroundFps(const char *v) { backgroundFps = atoi(v); return true; }
+static bool optMouse(const char *v)     { mouseRadius = atoi(v); engine.pointer = mouseRadius > 0; return true; }
+static bool optSeed(const char *v)      { seed = (unsigned int)strtoul(v, NULL, 10); return true; }
+static bool optSkip(const char *v)      { skipCycles = atoll(v); return true; }
+static bool optColumnDrops(const char *v) { columnDrops = atoi(v); return true; }
+static bool optFrames(const char *v)    { exportOptions.frames = streamOptions.frames = atoi(v); return true; }
+static bool optOut(const char *v)       { exportOptions.dir = v; return true; }
+static bool optThreads(const char *v)   { exportOptions.threads = atoi(v); return true; }
+static bool optScale(const char *v)     { exportOptions.scale = atoi(v); return true; }
+static bool optBandwidth(const char *v) { maxBandwidth = parseBandwidth(v); return true; }
+static bool optControl(const char *v)   { controlPath = v; return true; }
+static bool optTrace(const char *v)     { tracePath = v; return true; }
+static bool optTraceEvents(const char *v) { traceEvents = atoi(v); return true; }
+
+static bool optLayers(const char *v)
+{
+    engine.numLayers = atoi(v);
+    if (engine.numLayers < 1) engine.numLayers = 1;
+    if (engine.numLayers > MAX_LAYERS) engine.numLayers = MAX_LAYERS;
+    return true;
+}
+
+static bool optPanes(const char *v)
+{
+    splitPanes = atoi(v);
+    if (splitPanes > MAX_PANES) splitPanes = MAX_PANES;
+    return true;
+}
+
+// Handlers below say what was wrong with the value and return false, startup stops then
+
+static bool optRenderer(const char *v)
+{
+    int r = findRenderer(v);
+    if (r < 0)
+    {
+        fprintf(stderr, "Unknown renderer '%s'\n", v);
+        return false;
     }
+    engine.renderer = r;
+    return true;
 }
 
-void updateDropPositionUp()
+static bool optColors(const char *v)
 {
-    for (int i = 0; i < numDrops; i++) 
+    int depth = parseColorDepth(v);
+    if (depth <= 0)
     {
-	    //Move it one position up by y axis
-        drops[i].y--;
+        fprintf(stderr, "Unknown colors '%s'\n", v);
+        return false;
+    }
+    engine.colors = depth;
+    return true;
+}
 
-        //If arrived at the end -> go back to top
-        if (drops[i].y < 0)
-        {
+static bool optExport(const char *v)
+{
+    exportMode = true;
+    if (strcmp(v, "raw") == 0) exportOptions.format = EXPORT_RAW;
+    else if (strcmp(v, "ppm") == 0) exportOptions.format = EXPORT_PPM;
+    else
+    {
+        fprintf(stderr, "Unknown export '%s'\n", v);
+        return false;
+    }
+    return true;
+}
 
-            drops[i].y = rows;
+static bool optStream(const char *v)
+{
+    streamMode = true;
+    if (strcmp(v, "cells") == 0) streamOptions.format = STREAM_CELLS;
+    else if (strcmp(v, "ansi") == 0) streamOptions.format = STREAM_ANSI;
+    else
+    {
+        fprintf(stderr, "Unknown stream '%s'\n", v);
+        return false;
+    }
+    return true;
+}
 
-            //Also shift it to the right after the cycle ends, so it doesnt look stuck
+// on|off, anything else is an error
+static int parseSwitch(const char *name, const char *v)
+{
+    if (strcmp(v, "on") == 0) return 1;
+    if (strcmp(v, "off") == 0) return 0;
+    fprintf(stderr, "Bad %s '%s', expected on or off\n", name, v);
+    return -1;
+}
 
-            drops[i].x++;
+// auto|on|off, -1 is auto
+static bool parseAuto(const char *name, const char *v, int *mode)
+{
+    if (strcmp(v, "auto") == 0) *mode = -1;
+    else if (strcmp(v, "on") == 0) *mode = 1;
+    else if (strcmp(v, "off") == 0) *mode = 0;
+    else
+    {
+        fprintf(stderr, "Bad %s '%s', expected auto, on or off\n", name, v);
+        return false;
+    }
+    return true;
+}
 
-            if(drops[i].x > columns - paddingRight-1)
-            {
-                drops[i].x = 0;
-            }
-        }
+static bool optPace(const char *v)
+{
+    int on = parseSwitch("pace", v);
+    if (on < 0)
+        return false;
+    streamOptions.paced = on;
+    return true;
+}
+
+static bool optSize(const char *v)
+{
+    if (sscanf(v, "%dx%d", &exportOptions.columns, &exportOptions.rows) != 2)
+    {
+        fprintf(stderr, "Bad size '%s', expected COLUMNSxROWS\n", v);
+        return false;
+    }
+    streamOptions.columns = exportOptions.columns;
+    streamOptions.rows = exportOptions.rows;
+    return true;
+}
 
+static bool optWall(const char *v)
+{
+    if (sscanf(v, "%63[^:]:%dx%d", wallName, &wallOptions.columns, &wallOptions.rows) != 3)
+    {
+        fprintf(stderr, "Bad wall '%s', expected NAME:COLUMNSxROWS\n", v);
+        return false;
     }
+    return true;
 }
 
-void updateDropPosition()
+static bool optTile(const char *v)
 {
-    //there is only direction 'D'
+    if (sscanf(v, "%63[^:]:%d,%d", wallName, &wallTile.x, &wallTile.y) != 3)
+    {
+        fprintf(stderr, "Bad tile '%s', expected NAME:X,Y\n", v);
+        return false;
+    }
+    tileMode = true;
+    return true;
+}
 
-    if(direction == 'D'){
-        updateDropPositionDown();
+static bool optGraphics(const char *v)
+{
+    int p = parseGraphics(v);
+    if (p < 0)
+    {
+        fprintf(stderr, "Unknown graphics '%s'\n", v);
+        return false;
     }
+    graphicsProtocol = p;
+    return true;
+}
 
+static bool optDirection(const char *v)
+{
+    int d = parseDirection(v);
+    if (d == 0)
+    {
+        fprintf(stderr, "Unknown direction '%s'\n", v);
+        return false;
+    }
+    engine.direction = d;
+    return true;
 }
 
-void updateTailPosition()
+static bool optSync(const char *v)
 {
-    //Every element (i) of the rains tail takes the x,y coordinates of the previous element (i-1)
-    //And first tail element takes head's position
+    return parseAuto("sync", v, &syncMode);
+}
 
-    for (int segment = 0; segment < numDrops; segment++) {
-        // Shift the tail positions
-        for (int i = drops[segment].length - 1; i > 0; i--) {
-            tailSegments[segment].x[i] = tailSegments[segment].x[i - 1];
-            tailSegments[segment].y[i] = tailSegments[segment].y[i - 1];
-            tailSegments[segment].c[i] = tailSegments[segment].c[i - 1];
-        }
+static bool optRepeat(const char *v)
+{
+    return parseAuto("repeat", v, &repeatMode);
+}
 
-        // Update the first element with the drop's position
-        tailSegments[segment].x[0] = drops[segment].x;
-        tailSegments[segment].y[0] = drops[segment].y;
-        tailSegments[segment].c[0] = getRandomChar();
-        /* if(cycle%3){
-            tailSegments[segment].c[0] = getRandomChar();
-        }
- */
+static bool optGlyphs(const char *v)
+{
+    const GlyphSet *gs = findGlyphSet(v);
+    if (gs == NULL)
+    {
+        fprintf(stderr, "Unknown glyphs '%s'\n", v);
+        return false;
     }
+    glyphs = gs;
+    return true;
 }
 
+static void useReveal(Mask *m)
+{
+    if (engine.reveal != NULL)
+        freeReveal(&reveal);
+    initReveal(&reveal, m);
+    engine.reveal = &reveal;
+}
 
-void updateRainData()
+static bool optReveal(const char *v)
 {
-    // Update tail before head, because it must follow the drops previous position
-    updateTailPosition();
+    FILE *f = fopen(v, "rb");
+    if (f == NULL)
+    {
+        fprintf(stderr, "Can't open reveal image '%s'\n", v);
+        return false;
+    }
 
-    // Update head position based on current direction
-    updateDropPosition();
+    OutBuf data = { 0 };
+    char chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0)
+        obAppend(&data, chunk, n);
+    fclose(f);
+
+    Mask m;
+    if (!parsePbm(&m, data.data, data.len))
+    {
+        fprintf(stderr, "Reveal image '%s' is not a PBM (P1 or P4)\n", v);
+        obFree(&data);
+        return false;
+    }
+    obFree(&data);
+    useReveal(&m);
+    return true;
 }
 
-void render()
+static bool optRevealText(const char *v)
 {
-    resetCursorPosition();    
+    Mask m;
+    rasterizeText(&m, v);
+    useReveal(&m);
+    return true;
+}
 
-    if( debugMode ){
-            
-        //FIX, BUT ACTUALLY CAUSES PROBLEMS MORE ON BOTTOM SCREEN
-        system("clear");
-        printHeaderLine();    
-    } 
+static bool optSubcells(const char *v)
+{
+    int mode = parseSubcells(v);
+    if (mode < 0)
+    {
+        fprintf(stderr, "Unknown subcells '%s'\n", v);
+        return false;
+    }
+    engine.subcells = mode;
+    return true;
+}
 
-    printContent();
-    
-    if( !cursorVisible ) printf("\e[?25l"); // Remove cursor and flashing
+static bool optHelp(const char *v);
+
+static const Option options[] = {
+    { "debug",          NULL,                                optDebug,         "header line with terminal and rain info" },
+    { "glyphs",         "latin|alpha|katakana",              optGlyphs,        "characters the rain is made of" },
+    { "colors",         "16|256|truecolor",                  optColors,        "color depth" },
+    { "renderer",       "scan|full|diff",                    optRenderer,      "how frames are written to the terminal" },
+    { "graphics",       "sixel|kitty|off",                   optGraphics,      "draw the rain as images, only changed blocks are sent" },
+    { "subcells",       "off|half|braille",                  optSubcells,      "finer rain, 1x2 (half blocks) or 2x4 (braille) per cell" },
+    { "direction",      "down|up|left|right",                optDirection,     "where the rain goes, arrows and w/a/s change it live" },
+    { "sync",           "auto|on|off",                       optSync,          "synchronized output (mode 2026)" },
+    { "repeat",         "auto|on|off",                       optRepeat,        "REP for runs of the same glyph, asked from the terminal by default" },
+    { "max-bandwidth",  "BYTES_PER_SEC",                     optBandwidth,     "cap on output, k/m suffixes work" },
+    { "background-fps", "N",                                 optBackgroundFps, "frame rate when unfocused or idle, 0 stops the rain" },
+    { "idle",           "SECONDS",                           optIdle,          "no input for this long counts as background, 0 never" },
+    { "mouse",          "RADIUS",                            optMouse,         "drops part around the pointer and splash on click, 0 off" },
+    { "seed",           "N",                                 optSeed,          "random seed, same seed same rain" },
+    { "control",        "PATH",                              optControl,       "unix socket for live changes, see README" },
+    { "trace",          "FILE",                              optTrace,         "record frame phases, chrome trace json (SIGUSR1 dumps)" },
+    { "trace-events",   "N",                                 optTraceEvents,   "events kept per thread for the trace" },
+    { "reveal",         "FILE",                              optReveal,        "PBM image the rain uncovers where drops pass" },
+    { "reveal-text",    "TEXT",                              optRevealText,    "same with text, e.g. 'Wake up, Neo...'" },
+    { "clock",          NULL,                                optClock,         "clock in the top right corner" },
+    { "text",           "X,Y[,Z]:TEXT",                      optText,          "text box over the rain, negative X,Y from the right/bottom, can be repeated" },
+    { "column-drops",   "N",                                 optColumnDrops,   "most drops in one column (row for left/right), panes get no more than fit" },
+    { "layers",         "1-4",                               optLayers,        "depth layers of rain, far ones dimmer and slower" },
+    { "skip",           "N",                                 optSkip,          "cycles simulated before the first frame" },
+    { "panes",          "N",                                 optPanes,         "split the terminal in N panes" },
+    { "pane",           "WxH+X+Y[:glyphs[:millis[:drops]]]", optPane,          "place a pane, can be repeated" },
+    { "bench",          NULL,                                optBench,         "run the benchmark matrix" },
+    { "bench-save",     "FILE",                              optBenchSave,     "run the benchmark and save it as baseline" },
+    { "bench-check",    "FILE",                              optBenchCheck,    "run the benchmark and compare with baseline" },
+    { "verify",         NULL,                                optVerify,        "check every renderer against the reference on an emulated terminal" },
+    { "soak",           "FRAMES|DURATION",                   optSoak,          "run headless and fail if frames allocate or memory grows, e.g. 12h" },
+    { "soak-reset",     "FRAMES",                            optSoakReset,     "frames between resets during soak, 0 never (default 10000)" },
+    { "wall",           "NAME:COLUMNSxROWS",                 optWall,          "run the simulation of a video wall for tile processes" },
+    { "tile",           "NAME:X,Y",                          optTile,          "show the part of a wall at X,Y in this terminal" },
+    { "export",         "ppm|raw",                           optExport,        "render frames to images instead of the terminal" },
+    { "stream",         "ansi|cells",                        optStream,        "write frames to stdout for a pipe, the default when it is not a terminal" },
+    { "pace",           "on|off",                            optPace,          "stream at the rain's speed or as fast as the reader takes it" },
+    { "size",           "COLUMNSxROWS",                      optSize,          "export, stream and soak size in cells" },
+    { "frames",         "N",                                 optFrames,        "number of exported frames, streamed ones (0 = no end)" },
+    { "out",            "DIR",                               optOut,           "where exported ppm files go" },
+    { "threads",        "N",                                 optThreads,       "export rasterizer threads" },
+    { "scale",          "N",                                 optScale,         "export pixels per font pixel" },
+    { "help",           NULL,                                optHelp,          "show this help" },
+};
+
+#define NUM_OPTIONS (int)(sizeof(options) / sizeof(options[0]))
+
+static void printUsage(FILE *f)
+{
+    fprintf(f, "Usage: matrix [option...]\n");
+    printOptions(f, options, NUM_OPTIONS);
 }
 
-void refreshScreen()
+static bool optHelp(const char *v)
 {
-    if(!pausa) 
-        updateRainData();
-    render();    
+    (void)v;
+    printUsage(stdout);
+    exit(EXIT_SUCCESS);
+    return true;
 }
 
 void processArguments(int argc, char **argv)
 {
-    char gm[] = "debug";
-   
-    for (int i = 1; i < argc; ++i)
+    if (!parseOptions(argc, argv, options, NUM_OPTIONS))
     {
-        int result;
-        
-        result = strcmp(gm, argv[i]);
-        if (result == 0) 
-        {
-            debugMode = true;
-            printf("Debug mode activated\n");
-        } 
-
-       usleep(1000 * 1000);
+        printUsage(stderr);
+        exit(EXIT_FAILURE);
     }
 }
 
 int main(int argc, char **argv)
 {
+    setMemoryFailure(outOfMemory);
+    initGlyphSets();
+    glyphs = defaultGlyphSet();
+    initEngine(&engine);
+
     if(argc > 0)
         processArguments(argc,argv);    
 
+    // Hidden until debug mode or clock, text= boxes left room for them
+    headerBox = addOverlayBox(&overlay, 0, 0, OVERLAY_Z_HEADER, -1, STYLE_OVERLAY);
+    clockBox = addOverlayBox(&overlay, -10, 0, OVERLAY_Z_HEADER + 1, 0, STYLE_OVERLAY);
+    engine.overlay = &overlay;
+
+    if (tracePath != NULL)
+    {
+        traceOpen(tracePath, traceEvents);
+        traceDumpOnSignal(SIGUSR1);
+        setSignalHook(dumpTrace);
+    }
+
+    if (benchMode)
+    {
+        int rc = runBench(seed ? seed : 1234, skipCycles < 0 ? 0 : skipCycles, benchSavePath, benchCheckPath);
+        traceClose();
+        return rc;
+    }
+
+    if (verifyMode)
+    {
+        int rc = runVerify(seed ? seed : 1234, skipCycles);
+        traceClose();
+        return rc;
+    }
+
+    if (soakMode)
+    {
+        int rc = runSoakMode();
+        traceClose();
+        return rc;
+    }
+
+    if (wallOptions.columns > 0 && !tileMode)
+    {
+        wallOptions.numDrops = numDrops;
+        wallOptions.millis = millis;
+        wallOptions.direction = engine.direction;
+        wallOptions.layers = engine.numLayers;
+        wallOptions.glyphs = glyphs;
+        wallOptions.seed = seed ? seed : (unsigned int)time(NULL);
+        wallOptions.skip = skipCycles < 0 ? wallOptions.rows : skipCycles;
+        int rc = runWall(&wallOptions);
+        traceClose();
+        return rc;
+    }
+
+    if (tileMode && wallAttach(&wallTile, wallName, wallTile.x, wallTile.y) < 0)
+        exit(EXIT_FAILURE);
+
+    if (exportMode)
+    {
+        // The font has no block or braille glyphs, sub-cells would come out blank
+        if (engine.subcells != SUBCELLS_OFF)
+        {
+            fprintf(stderr, "subcells= can't be exported, the font has no block or braille glyphs\n");
+            printUsage(stderr);
+            traceClose();
+            return EXIT_FAILURE;
+        }
+        int rc = runExportMode();
+        traceClose();
+        return rc;
+    }
+
+    // Nobody to ask for a size, it comes from size=
+    if (!tileMode && (streamMode || !isatty(STDOUT_FILENO)))
+    {
+        int rc = runStreamMode();
+        traceClose();
+        return rc;
+    }
+
+    if (engine.subcells != SUBCELLS_OFF && (graphicsProtocol != GRAPHICS_NONE || tileMode))
+    {
+        // Pixels have no use for block and braille glyphs, a tile shows the wall's cells
+        fprintf(stderr, "subcells= is ignored with graphics= and tile=\n");
+        engine.subcells = SUBCELLS_OFF;
+    }
+
+    if (controlPath != NULL && controlOpen(&control, controlPath) < 0)
+        exit(EXIT_FAILURE);
+
+    // Rain gets its own screen, what was in the terminal is back after exit (or kill)
+    saveTerminal();
+    enterAltScreen();
+    enableNonCanonicalMode();
+    bool syncSupported = false, repeatSupported = false;
+    if (syncMode < 0 || repeatMode < 0)
+        queryTerminalSupport(200, &syncSupported, &repeatSupported);
+    syncOutput = syncMode < 0 ? syncSupported : syncMode == 1;
+    if (!(repeatMode < 0 ? repeatSupported : repeatMode == 1))
+        engine.features &= ~ENCODE_REPEAT;
+
+    enableFocusReports();
+    if (mouseRadius > 0 && !tileMode)
+        enableMouseReports();
+    watchResize();
+    // Unbuffered, otherwise keys read ahead into stdio would not wake up poll
+    setvbuf(stdin, NULL, _IONBF, 0);
+
+    if (graphicsProtocol != GRAPHICS_NONE)
+    {
+        int cellWidth, cellHeight;
+        getCellPixels(&cellWidth, &cellHeight);
+        initGraphics(&graphics, graphicsProtocol, cellWidth, cellHeight, (int)sysconf(_SC_NPROCESSORS_ONLN));
+    }
+
+    sinkOpen(&sink, STDOUT_FILENO, maxBandwidth);
+    statsMillis = nowMillis();
+    lastInput = statsMillis;
+    if (tileMode)
+    {
+        runTile();
+        wallDetach(&wallTile);
+        return finishRun();
+    }
+
     initialize();
-        
+
+    long long nextFrame = 0;
     while (1)
     {
-        cycle++;
-        if(!handleKeypress())
+        TRACE_BEGIN("handleKeypress");
+        int running = handleKeypress();
+        TRACE_END("handleKeypress");
+        if(!running)
             break;
-        refreshScreen();        
-        usleep(millis * 1000); // Sleep for defined milliseconds
-    }
+        controlProcess(&control, handleControlCommand);
+        if (takeResize())
+            redrawPending = true;
 
-    cleanUp();
-    printGameOverScreen();
+        long long now = nowMillis();
+        bool background = !focused || (idleSeconds > 0 && now - lastInput >= idleSeconds * 1000LL);
+        // Nothing moves, so nothing is drawn until some input or resize
+        bool asleep = pausa || (background && backgroundFps == 0);
 
-    return 0;
+        if (redrawPending || (!asleep && now >= nextFrame))
+        {
+            redrawPending = false;
+            cycle++;
+            TRACE_BEGIN("frame");
+            int delay = refreshScreen();
+            if (background && backgroundFps > 0 && delay < 1000 / backgroundFps)
+                delay = 1000 / backgroundFps;
+            nextFrame = now + delay;
+            TRACE_END("frame");
+        }
+
+        sinkPump(&sink, nowMillis());
+        // Output failed for good (EIO, EPIPE), same as a terminal that hung up
+        if (sink.error != 0)
+            break;
+        if (asleep)
+            waitForEvents(-1); // Zero CPU until a key, command or resize
+        else
+            waitForEvents((int)(nextFrame - nowMillis())); // Sleep until next pane is due
+    }
+
+    return finishRun();
 }